@@ -0,0 +1,492 @@
+// -------------------------------------------------------------------------
+// Benchmark: Skim Accumulation Modes
+// File: bench_pdf_accumulate.cpp
+//
+// [Single Cell]
+// - Builds a synthetic skim cell in memory (-n events x -r weights,
+//   weights ~ 1 +- a few %), no file I/O involved.
+// - Times accumulateSkimCell() (pdf_skim.h) in each mode, best of 5:
+//     double      : every weight widened to double (floatBlock = 0)
+//     float-block : float lanes, flushed to double every kSkimFloatBlock events
+//     ratio16     : the same weights in the ratio16 codec (float nominal +
+//                   16-bit ratios, decoded inside the kernel, float-block)
+// - Reports throughput, bytes per event and the largest relative difference
+//   of the replica sums against the double mode.
+// - The default -n keeps the cell in cache (compute bound); a large -n
+//   (e.g. 2000000) shows the memory-bound regime of big skims.
+//
+// [Threaded Fine Binning] (--threads N, --cells C)
+// - N threads fill C cells (event -> pseudo-random cell, as for a fine
+//   mj12/MET binning) through ParallelAccumulator (pdf_accumulator.h),
+//   once with per-thread copies and once with the shared atomic counters.
+// - Reports fill + merge time, accumulator memory, the largest relative
+//   difference between the two results, and the automatic choice.
+//
+// [Envelope Percentiles] (--percentiles, --cells C)
+// - C cells of -r replica sums; the 16th / 84th percentile ranks of
+//   replicas 1..r-1 (as pdfw_envelopes) per cell, with a per-cell
+//   std::sort, a per-cell std::nth_element and PercentileNetwork
+//   (pdf_percentile.h). Reports the time per cell and checks that all
+//   three agree exactly.
+//
+// [BJ Value Collection] (--collect N)
+// - N values over 14 bins (pseudo-random bin, cluster-sized staging as in
+//   the BJ tools), once into per-bin vector<double> and once into arena
+//   chunks (pdf_value_arena.h), each in a forked child so the peak RSS
+//   (wait4 rusage) belongs to that variant alone; then the 16th / 84th
+//   ranks of every bin (sort vs nth_element over the chunks).
+// - Reports collect / select time and peak RSS next to the payload size.
+//
+// [Skim Reading] (--io FILE, --threads N)
+// - Sums all weights of every cell of FILE with N workers (default 1)
+//   through each reader of pdf_skim_io.h: mmap (events split over the
+//   workers as in pdfw_skim_accumulate_mt), pread, io_uring and io_uring
+//   with O_DIRECT. A missing FILE is first written as a synthetic skim of
+//   -n events (default kIoBenchEvents) x -r weights.
+// - cold: the file's pages are dropped first (fdatasync + fadvise
+//   DONTNEED, no root needed); warm: right after the cold pass.
+// - Reports time and MB/s over the file size, the reads issued and the
+//   largest relative difference of the sums against mmap.
+//
+// compile: g++ -O2 -o bench_pdf_accumulate.exe bench_pdf_accumulate.cpp
+// run: ./bench_pdf_accumulate.exe [-n 2048] [-r 101] [--threads 8 --cells 5000] [--percentiles] [--collect 200000000] [--io big.pdfskim]
+// -------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "pdf_skim.h"
+#include "pdf_skim_io.h"
+#include "pdf_accumulator.h"
+#include "pdf_percentile.h"
+#include "pdf_quantile_sketch.h"
+
+using namespace std;
+
+// Helper: Best-of-5 time [ms] of 'passes' calls of fn()
+template <typename Fn>
+double bestTime(int passes, Fn fn) {
+    double best = -1;
+    for (int rep = 0; rep < 5; ++rep) {
+        auto t0 = chrono::steady_clock::now();
+        for (int p = 0; p < passes; ++p) fn();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+// Helper: Fill C cells from nThreads threads, then merge; returns the time [ms]
+double timeParallelFill(const vector<float>& weights, uint64_t nEvents, int nRep, size_t nCells,
+                        int nThreads, AccumulatorMode mode, vector<double>& out, size_t& bytes) {
+    auto t0 = chrono::steady_clock::now();
+    ParallelAccumulator acc(nCells, nRep, nThreads, mode);
+    vector<std::thread> workers;
+    for (int t = 0; t < nThreads; ++t) {
+        workers.emplace_back([&, t]() {
+            uint64_t first = nEvents * t / nThreads, last = nEvents * (t + 1) / nThreads;
+            for (uint64_t e = first; e < last; ++e) {
+                size_t cell = (size_t)((e * 2654435761u) % nCells);
+                acc.Add(t, cell, weights.data() + e * nRep);
+            }
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    out.assign(nCells * nRep, 0.0);
+    acc.MergeInto(out.data());
+    bytes = acc.Bytes();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+// Helper: Collect nValues BJ-like values into 14 bins, then select the 16th / 84th
+// ranks; 'chunked' picks arena chunks over per-bin vectors. Times in ms.
+void collectValues(uint64_t nValues, bool chunked, double& tCollect, double& tSelect) {
+    const int nBinsBJ = 14;
+    const size_t clusterValues = 20000; // values staged per cluster
+    mt19937_64 gen(7);
+    normal_distribution<double> spread(1.0, 0.05);
+
+    auto t0 = chrono::steady_clock::now();
+    ValueArena arena;
+    vector<vector<double>> vec_bins(nBinsBJ), vec_stage(nBinsBJ);
+    vector<BinValues> chunk_bins(nBinsBJ);
+    vector<ChunkedValues> chunk_stage(nBinsBJ);
+    for (int b = 0; b < nBinsBJ; ++b) {
+        chunk_bins[b].SetStorage(&arena, 0);
+        chunk_stage[b].SetArena(&arena);
+    }
+    for (uint64_t i = 0; i < nValues; ++i) {
+        int b = (int)((i * 2654435761u >> 7) % nBinsBJ);
+        double v = spread(gen);
+        if (chunked) chunk_stage[b].push_back(v);
+        else vec_stage[b].push_back(v);
+        if ((i + 1) % clusterValues == 0 || i + 1 == nValues) {
+            for (int c = 0; c < nBinsBJ; ++c) {
+                if (chunked) {
+                    chunk_bins[c].Append(chunk_stage[c]);
+                } else {
+                    vec_bins[c].insert(vec_bins[c].end(), vec_stage[c].begin(), vec_stage[c].end());
+                    vec_stage[c].clear();
+                }
+            }
+        }
+    }
+    auto t1 = chrono::steady_clock::now();
+
+    double check = 0;
+    for (int b = 0; b < nBinsBJ; ++b) {
+        if (chunked) {
+            size_t n = chunk_bins[b].Count();
+            if (n == 0) continue;
+            chunk_bins[b].SelectExact({(size_t)(n * 0.16), (size_t)(n * 0.84)});
+            check += chunk_bins[b].ValueAtRank((double)(size_t)(n * 0.16)) + chunk_bins[b].ValueAtRank((double)(size_t)(n * 0.84));
+        } else {
+            size_t n = vec_bins[b].size();
+            if (n == 0) continue;
+            std::sort(vec_bins[b].begin(), vec_bins[b].end());
+            check += vec_bins[b][(size_t)(n * 0.16)] + vec_bins[b][(size_t)(n * 0.84)];
+        }
+    }
+    auto t2 = chrono::steady_clock::now();
+    tCollect = chrono::duration<double, milli>(t1 - t0).count();
+    tSelect = chrono::duration<double, milli>(t2 - t1).count();
+    printf("    (16th + 84th summed over bins: %.9f)\n", check);
+}
+
+// --- Skim Reading ---
+const uint64_t kIoBenchEvents = 500000; // synthetic skim for --io (~200 MB at 101 weights)
+const int kIoBenchCells = 56;           // 14 bins x 4 Mj classes
+
+// Helper: Write a synthetic skim, events spread over all cells
+bool writeSyntheticSkim(const string& path, uint64_t nEvents, int nRep, string& error) {
+    SkimWriter writer;
+    if (!writer.Open(path, kIoBenchCells, nRep, "", error)) return false;
+    mt19937 gen(4321);
+    normal_distribution<float> spread(0.f, 0.03f);
+    vector<float> w(nRep);
+    for (uint64_t e = 0; e < nEvents; ++e) {
+        int cell = (int)((e * 2654435761u >> 5) % kIoBenchCells);
+        for (auto& v : w) v = 1.f + spread(gen);
+        if (!writer.Add(cell, 500.f + 300.f * (cell % 4), 4 + cell % 5, (cell / 4) % 5, w.data(), nRep)) {
+            error = "cannot write " + path;
+            return false;
+        }
+    }
+    return writer.Close(error);
+}
+
+// Helper: Drop the cached pages of a file (only clean pages go, hence the fdatasync)
+bool dropFileCache(const string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    fdatasync(fd);
+    bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+}
+
+// Helper: Sum all weights of every cell with nWorkers through one reader;
+// returns the time [ms] including the open, -1 on error
+double timeSkimRead(const string& path, SkimIoBackend backend, bool direct, int nWorkers,
+                    vector<double>& sums, SkimIoStats& stats) {
+    auto t0 = chrono::steady_clock::now();
+    SkimReader skim;
+    string error;
+    if (!skim.Open(path, error)) { cout << "[Error] " << error << endl; return -1; }
+    const int nRep = skim.NReplicas();
+    const size_t nSum = (size_t)skim.NCells() * nRep;
+    vector<vector<double>> partial(nWorkers, vector<double>(nSum, 0.0));
+
+    if (backend == SkimIoBackend::Mmap) {
+        // Chunks of events over the workers, straight from the mapping
+        const uint64_t chunk = 16384;
+        vector<pair<int, uint64_t>> chunks;
+        for (int c = 0; c < skim.NCells(); ++c)
+            for (uint64_t first = 0; first < skim.CellEvents(c); first += chunk) chunks.push_back({c, first});
+        std::atomic<size_t> next(0);
+        vector<std::thread> workers;
+        for (int w = 0; w < nWorkers; ++w) {
+            workers.emplace_back([&, w]() {
+                for (size_t i; (i = next++) < chunks.size();) {
+                    int c = chunks[i].first;
+                    uint64_t first = chunks[i].second;
+                    SkimCell part = skim.Cell(c).Events(first, std::min(chunk, skim.CellEvents(c) - first));
+                    accumulateSkimCell(part, nullptr, nRep, partial[w].data() + (size_t)c * nRep);
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+        stats = SkimIoStats();
+    } else {
+        SkimIoOptions opts;
+        opts.backend = backend;
+        opts.direct = direct;
+        Selection all;
+        bool ok = streamSkimCells(skim, ~uint64_t(0), all, kSkimBlockSize, opts, nWorkers, error,
+            [&](int w, int c, const SkimCell& part, const unsigned char* mask) {
+                accumulateSkimCell(part, mask, nRep, partial[w].data() + (size_t)c * nRep);
+            }, &stats);
+        if (!ok) { cout << "[Error] " << error << endl; return -1; }
+    }
+
+    sums.assign(nSum, 0.0);
+    for (const auto& p : partial)
+        for (size_t i = 0; i < nSum; ++i) sums[i] += p[i];
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+int main(int argc, char* argv[]) {
+    // --- Options ---
+    uint64_t nEvents = 2048;
+    int nRep = 101;
+    int nThreads = 0;
+    size_t nCells = 5000;
+    bool percentiles = false;
+    uint64_t nCollect = 0;
+    string ioPath;
+    bool events_given = false;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) { nEvents = strtoull(argv[++i], nullptr, 10); events_given = true; }
+        else if (arg == "-r" && i + 1 < argc) nRep = atoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else if (arg == "--cells" && i + 1 < argc) nCells = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--percentiles") percentiles = true;
+        else if (arg == "--collect" && i + 1 < argc) nCollect = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--io" && i + 1 < argc) ioPath = argv[++i];
+    }
+    if (nEvents == 0 || nRep < 1 || nCells == 0) {
+        cout << "Usage: ./bench_pdf_accumulate.exe [-n events] [-r weights per event] [--threads N --cells C] [--percentiles] [--collect N] [--io FILE]" << endl;
+        return 1;
+    }
+
+    // --- Skim Reading (cold / warm per reader) ---
+    if (!ioPath.empty()) {
+        if (access(ioPath.c_str(), R_OK) != 0) {
+            if (!events_given) nEvents = kIoBenchEvents;
+            cout << "Writing synthetic skim " << ioPath << " (" << nEvents << " events x " << nRep << " weights)..." << endl;
+            string error;
+            if (!writeSyntheticSkim(ioPath, nEvents, nRep, error)) { cout << "[Error] " << error << endl; return 1; }
+        }
+        struct stat st;
+        if (stat(ioPath.c_str(), &st) != 0) { cout << "[Error] cannot stat " << ioPath << endl; return 1; }
+        double mb = st.st_size / 1e6;
+        int nWorkers = std::max(1, nThreads);
+        cout << "Reading " << ioPath << " (" << (long long)mb << " MB) with " << nWorkers
+             << (nWorkers > 1 ? " workers" : " worker") << ", " << kSkimIoDepth << " x "
+             << (kSkimIoChunk >> 20) << " MiB in flight" << endl;
+
+        struct Variant { SkimIoBackend backend; bool direct; };
+        vector<double> reference;
+        for (Variant v : {Variant{SkimIoBackend::Mmap, false}, Variant{SkimIoBackend::Pread, false},
+                          Variant{SkimIoBackend::Uring, false}, Variant{SkimIoBackend::Uring, true}}) {
+            vector<double> sums;
+            SkimIoStats stats;
+            if (!dropFileCache(ioPath)) cout << "[Warning] cannot drop the cached pages of " << ioPath << endl;
+            double tCold = timeSkimRead(ioPath, v.backend, v.direct, nWorkers, sums, stats);
+            double tWarm = timeSkimRead(ioPath, v.backend, v.direct, nWorkers, sums, stats);
+            if (tCold < 0 || tWarm < 0) return 1;
+            if (reference.empty()) reference = sums;
+
+            double maxRel = 0;
+            for (size_t i = 0; i < sums.size(); ++i)
+                if (reference[i] != 0) maxRel = std::max(maxRel, std::fabs(sums[i] - reference[i]) / std::fabs(reference[i]));
+            string name = v.backend == SkimIoBackend::Mmap ? "mmap" : skimIoBackendName(stats.backend);
+            if (stats.direct) name += "+direct";
+            else if (v.direct) name += " (no O_DIRECT)";
+            printf("  %-20s: cold %8.1f ms %7.0f MB/s   warm %8.1f ms %7.0f MB/s   %6llu reads   max rel diff %.1e\n",
+                   name.c_str(), tCold, mb / tCold * 1e3, tWarm, mb / tWarm * 1e3,
+                   (unsigned long long)stats.reads, maxRel);
+            if (!stats.note.empty()) cout << "  [Warning] " << stats.note << endl;
+        }
+        return 0;
+    }
+
+    // --- BJ Value Collection (one forked child per variant) ---
+    if (nCollect > 0) {
+        cout << "Collecting " << nCollect << " values into 14 bins (" << nCollect * sizeof(double) / 1048576
+             << " MiB payload)" << endl;
+        for (bool chunked : {false, true}) {
+            fflush(stdout);
+            pid_t pid = fork();
+            if (pid == 0) {
+                double tCollect = 0, tSelect = 0;
+                collectValues(nCollect, chunked, tCollect, tSelect);
+                printf("  %-18s: collect %8.1f ms, 16th/84th %8.1f ms (%s)\n", chunked ? "arena chunks" : "per-bin vectors",
+                       tCollect, tSelect, chunked ? "nth_element" : "sort");
+                fflush(stdout);
+                _exit(0);
+            }
+            int status = 0;
+            struct rusage ru;
+            wait4(pid, &status, 0, &ru);
+            printf("  %-18s: peak RSS %8.1f MiB\n", chunked ? "arena chunks" : "per-bin vectors", ru.ru_maxrss / 1024.0);
+        }
+        return 0;
+    }
+
+    // --- Envelope Percentiles ---
+    if (percentiles) {
+        if (nRep < 2) { cout << "--percentiles needs -r >= 2" << endl; return 1; }
+        vector<double> sums(nCells * nRep);
+        mt19937 gen(12345);
+        normal_distribution<double> spread(0.0, 0.03);
+        for (auto& s : sums) s = 1000.0 * (1.0 + spread(gen));
+
+        int n = nRep - 1;
+        int lo = 15 * n / 100, hi = 83 * n / 100;
+        PercentileNetwork network(n, {lo, hi});
+        cout << "Percentiles of " << nCells << " cells x " << n << " replicas (ranks " << lo << " / " << hi
+             << ", network " << network.Comparators() << " of " << network.FullComparators()
+             << " compare-exchanges)" << endl;
+
+        int passes = (int)std::max<size_t>(1, 2000000 / (nCells * n));
+        vector<double> out_sort(nCells * 2), out_nth(nCells * 2), out_net(nCells * 2);
+        vector<double> values(n);
+        double tSort = bestTime(passes, [&]() {
+            for (size_t c = 0; c < nCells; ++c) {
+                std::copy(sums.begin() + c * nRep + 1, sums.begin() + (c + 1) * nRep, values.begin());
+                std::sort(values.begin(), values.end());
+                out_sort[c * 2] = values[lo];
+                out_sort[c * 2 + 1] = values[hi];
+            }
+        });
+        double tNth = bestTime(passes, [&]() {
+            for (size_t c = 0; c < nCells; ++c) {
+                std::copy(sums.begin() + c * nRep + 1, sums.begin() + (c + 1) * nRep, values.begin());
+                std::nth_element(values.begin(), values.begin() + hi, values.end());
+                out_nth[c * 2 + 1] = values[hi];
+                std::nth_element(values.begin(), values.begin() + lo, values.begin() + hi);
+                out_nth[c * 2] = values[lo];
+            }
+        });
+        double tNet = bestTime(passes, [&]() { network.Select(sums.data() + 1, nCells, nRep, out_net.data()); });
+
+        double perCell = 1e6 / ((double)nCells * passes); // ms -> ns per cell
+        bool same = out_net == out_sort && out_nth == out_sort;
+        printf("  std::sort        : %8.1f ns/cell\n", tSort * perCell);
+        printf("  std::nth_element : %8.1f ns/cell  (speedup x%.2f)\n", tNth * perCell, tSort / tNth);
+        printf("  rank network     : %8.1f ns/cell  (speedup x%.2f, %d cells per tile)\n",
+               tNet * perCell, tSort / tNet, kPercentileLanes);
+        printf("  results %s\n", same ? "identical" : "DIFFER");
+        return same ? 0 : 1;
+    }
+
+    // --- Synthetic Cell ---
+    vector<float> weights(nEvents * nRep);
+    mt19937 gen(12345);
+    normal_distribution<float> spread(0.f, 0.03f);
+    for (auto& w : weights) w = 1.f + spread(gen);
+
+    // --- Threaded Fine Binning ---
+    if (nThreads > 0) {
+        cout << "Filling " << nCells << " cells x " << nRep << " replicas from " << nThreads << " threads ("
+             << nEvents << " events, " << std::thread::hardware_concurrency() << " hardware threads)" << endl;
+        vector<double> out_copies, out_shared;
+        size_t bytes_copies = 0, bytes_shared = 0;
+        double best_copies = -1, best_shared = -1;
+        for (int rep = 0; rep < 3; ++rep) {
+            double t = timeParallelFill(weights, nEvents, nRep, nCells, nThreads,
+                                        AccumulatorMode::PerThread, out_copies, bytes_copies);
+            if (best_copies < 0 || t < best_copies) best_copies = t;
+            t = timeParallelFill(weights, nEvents, nRep, nCells, nThreads,
+                                 AccumulatorMode::SharedAtomic, out_shared, bytes_shared);
+            if (best_shared < 0 || t < best_shared) best_shared = t;
+        }
+
+        double maxRel = 0;
+        for (size_t i = 0; i < out_copies.size(); ++i)
+            if (out_copies[i] != 0)
+                maxRel = std::max(maxRel, std::fabs(out_shared[i] - out_copies[i]) / std::fabs(out_copies[i]));
+
+        printf("  per-thread copies : %8.1f ms  %8.1f MiB\n", best_copies, bytes_copies / 1048576.0);
+        printf("  shared atomic     : %8.1f ms  %8.1f MiB\n", best_shared, bytes_shared / 1048576.0);
+        printf("  max relative difference: %.2e ; automatic choice: %s\n",
+               maxRel, accumulatorModeName(chooseAccumulatorMode(nCells, nRep, nThreads)));
+        return 0;
+    }
+
+    SkimCell cell;
+    cell.n = nEvents;
+    cell.nReplicas = nRep;
+    cell.weights = weights.data();
+
+    // Small cells are accumulated repeatedly (~2e8 weights per timing)
+    int passes = (int)std::max<uint64_t>(1, 200000000 / weights.size());
+    cout << "Accumulating " << nEvents << " events x " << nRep << " weights ("
+         << weights.size() * sizeof(float) / 1024 << " KiB) x " << passes << " passes" << endl;
+
+    // Same cell in the ratio16 codec (range and rounding as SkimWriter)
+    vector<float> nominal(nEvents);
+    vector<uint16_t> ratios(nEvents * (nRep - 1));
+    float rMin = 0.f, rStep = 0.f;
+    if (nRep > 1) {
+        double lo = 1e30, hi = -1e30;
+        for (uint64_t e = 0; e < nEvents; ++e)
+            for (int k = 1; k < nRep; ++k) {
+                double r = (double)weights[e * nRep + k] / weights[e * nRep];
+                lo = std::min(lo, r);
+                hi = std::max(hi, r);
+            }
+        rMin = std::nextafter((float)lo, -HUGE_VALF);
+        rStep = std::nextafter((float)((hi - rMin) / 65535.0), HUGE_VALF);
+        for (uint64_t e = 0; e < nEvents; ++e) {
+            const float* w = weights.data() + e * nRep;
+            nominal[e] = w[0];
+            for (int k = 1; k < nRep; ++k)
+                ratios[e * (nRep - 1) + k - 1] = (uint16_t)std::lround(((double)w[k] / w[0] - rMin) / rStep);
+        }
+    }
+    SkimCell cell16 = cell;
+    cell16.codec = kSkimCodecRatio16;
+    cell16.weights = nominal.data();
+    cell16.ratios = ratios.data();
+    cell16.ratioMin = rMin;
+    cell16.ratioStep = rStep;
+
+    // --- Modes ---
+    vector<double> sums_double(nRep), sums_float(nRep), sums_ratio(nRep);
+    double tDouble = bestTime(passes, [&]() {
+        std::fill(sums_double.begin(), sums_double.end(), 0.0);
+        accumulateSkimCell(cell, nullptr, nRep, sums_double.data(), 0);
+    });
+    double tFloat = bestTime(passes, [&]() {
+        std::fill(sums_float.begin(), sums_float.end(), 0.0);
+        accumulateSkimCell(cell, nullptr, nRep, sums_float.data(), kSkimFloatBlock);
+    });
+    double tRatio = nRep > 1 ? bestTime(passes, [&]() {
+        std::fill(sums_ratio.begin(), sums_ratio.end(), 0.0);
+        accumulateSkimCell(cell16, nullptr, nRep, sums_ratio.data(), kSkimFloatBlock);
+    }) : tFloat;
+
+    double maxRel = 0, maxRelRatio = 0;
+    for (int k = 0; k < nRep; ++k) {
+        maxRel = std::max(maxRel, std::fabs(sums_float[k] - sums_double[k]) / std::fabs(sums_double[k]));
+        maxRelRatio = std::max(maxRelRatio, std::fabs(sums_ratio[k] - sums_double[k]) / std::fabs(sums_double[k]));
+    }
+
+    double gw = (double)nEvents * nRep * passes * 1e-6; // million weights
+    printf("  double      : %8.1f ms  %8.0f Mweights/s  %4d bytes/event\n", tDouble, gw / tDouble * 1e3, 4 * nRep);
+    printf("  float-block : %8.1f ms  %8.0f Mweights/s  %4d bytes/event  (block %d, speedup x%.2f)\n",
+           tFloat, gw / tFloat * 1e3, 4 * nRep, kSkimFloatBlock, tDouble / tFloat);
+    printf("  ratio16     : %8.1f ms  %8.0f Mweights/s  %4d bytes/event  (size codec, x%.2f vs double)\n",
+           tRatio, gw / tRatio * 1e3, 4 + 2 * (nRep - 1), tDouble / tRatio);
+    printf("  max relative difference of the sums: float-block %.2e (bound %.2e), ratio16 %.2e (ratio step %.2e)\n",
+           maxRel, (kSkimFloatBlock - 1) * std::ldexp(1.0, -24), maxRelRatio, (double)rStep);
+    return 0;
+}
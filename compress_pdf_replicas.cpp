@@ -0,0 +1,229 @@
+// -------------------------------------------------------------------------
+// Compress PDF Replicas (Representative Replica Subset from a Skim)
+// File: compress_pdf_replicas.cpp
+//
+// [Logic Flow]
+// 1. Calibrate:
+//    - One accumulation pass over a skim (make_pdf_skim.cpp):
+//      sum[cell][k] for all stored weights (k = 0 nominal).
+// 2. Select:
+//    - Pick -n replicas whose per-cell mean, spread and 16th/84th
+//      percentile ratios reproduce the full set (pdf_compress.h).
+// 3. Validate:
+//    - Per cell: full vs compressed envelope (16th/84th ratio to nominal),
+//      differences relative to the envelope half-width.
+//    - Speedup: accumulation time with all weights vs the subset.
+// 4. Rewrite (optional, -o):
+//    - A skim with only [nominal, subset] weights; its replica id table
+//      keeps the original 'weight' indices.
+//    - Use the envelope ranks of the subset size with it
+//      (pdf_weight.py: envelope_ranks(n)).
+//    - --codec ratio16 also stores the subset as 16-bit ratios to the
+//      nominal (pdf_skim.h); input skims may use either codec.
+// - Sums use float blocks (pdf_skim.h, [Accumulation]); --exact-sum keeps
+//   every addition in double (needed for negative weights).
+//
+// compile: g++ -O2 -o compress_pdf_replicas.exe compress_pdf_replicas.cpp
+// run: ./compress_pdf_replicas.exe -n 30 [-o compressed.pdfskim] [--cut "njets >= 6"] [--codec ratio16] [--exact-sum] selected.pdfskim
+// -------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+
+#include "pdf_skim.h"
+#include "pdf_compress.h"
+
+using namespace std;
+
+// --- Binning Definition (Same as the plot tools) ---
+const int nBins = 14;
+const int binNumbers[nBins] = {
+    22, 23, 24, // Nb=0
+    25, 26, 27, // Nb=1
+    28, 29, 30, // Nb=2
+    31, 32, 33, // Nb=3
+    35, 36      // Nb>=4 (Bin 34 skipped)
+};
+
+// --- Mj Classes of the Cell Key (see pdf_region.h) ---
+const int nMjClasses = 4;
+const string mjLabels[nMjClasses] = {
+    "500-800",
+    "800-1100",
+    "1100+",
+    "other"
+};
+
+// Helper: Best-of-3 time [ms] of one accumulation pass over the skim
+double timeAccumulate(const SkimReader& skim, int nSum, int floatBlock, vector<double>& sums) {
+    double best = -1;
+    for (int rep = 0; rep < 3; ++rep) {
+        std::fill(sums.begin(), sums.end(), 0.0);
+        auto t0 = chrono::steady_clock::now();
+        for (int c = 0; c < skim.NCells(); ++c)
+            accumulateSkimCell(skim.Cell(c), nullptr, nSum, sums.data() + (size_t)c * nSum, floatBlock);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    // --- Options ---
+    int nKeep = 30;
+    string output;
+    string cut;
+    string codec_arg = "float";
+    int floatBlock = kSkimFloatBlock;
+    string input;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) nKeep = atoi(argv[++i]);
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--cut" && i + 1 < argc) cut = argv[++i];
+        else if (arg == "--codec" && i + 1 < argc) codec_arg = argv[++i];
+        else if (arg == "--exact-sum") floatBlock = 0;
+        else input = arg;
+    }
+
+    uint32_t codec = kSkimCodecFloat;
+    if (input.empty() || nKeep < 1 || !parseSkimCodec(codec_arg, codec)) {
+        cout << "Usage: ./compress_pdf_replicas.exe -n 30 [-o compressed.pdfskim] [--cut \"njets >= 6\"] [--codec float|ratio16] [--exact-sum] skim.pdfskim" << endl;
+        return 1;
+    }
+    if (!output.empty() && !isSkimFile(output)) {
+        cout << "[Error] Output name must end in .pdfskim: " << output << endl;
+        return 1;
+    }
+
+    SkimReader skim;
+    string error;
+    if (!skim.Open(input, error)) {
+        cout << "[Error] " << error << endl;
+        return 1;
+    }
+    const int nCells = skim.NCells();
+    const int nRep = skim.NReplicas();
+    if (nKeep >= nRep - 1) {
+        cout << "[Error] " << input << " stores " << nRep << " weights; nothing to compress to " << nKeep << endl;
+        return 1;
+    }
+
+    Selection sel;
+    if (!sel.Compile(cut, error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << error << endl;
+        return 1;
+    }
+
+    // --- Step 1: Calibration Pass ---
+    cout << "Step 1: Accumulating " << nRep << " weights of " << skim.NEvents() << " events from " << input
+         << (sel.IsTrivial() ? "" : " (cut: " + cut + ")") << "..." << endl;
+    vector<double> sums((size_t)nCells * nRep, 0.0);
+    vector<vector<unsigned char>> masks(nCells);
+    if (!forEachSkimCell(skim, ~uint64_t(0), sel, kSkimBlockSize, error,
+            [&](int c, const SkimCell& cell, const unsigned char* mask) {
+                accumulateSkimCell(cell, mask, nRep, sums.data() + (size_t)c * nRep, floatBlock);
+                if (mask) masks[c].assign(mask, mask + cell.n);
+            })) {
+        cout << "[Error] " << error << endl;
+        return 1;
+    }
+
+    ReplicaCompressor compressor;
+    compressor.Calibrate(sums, nCells, nRep);
+    if (compressor.NCalibrationCells() == 0) {
+        cout << "[Error] No cell with a positive nominal yield and replica spread" << endl;
+        return 1;
+    }
+
+    // --- Step 2: Selection ---
+    cout << "Step 2: Selecting " << nKeep << " of " << nRep - 1 << " replicas on "
+         << compressor.NCalibrationCells() << " cells..." << endl;
+    vector<int> kept = compressor.Select(nKeep);
+
+    cout << "Kept replicas (weight index):";
+    for (int k : kept) cout << " " << skim.ReplicaIds()[k];
+    cout << endl;
+    printf("ERF (sum of squared estimator shifts / std) : %.4g\n", compressor.Error(kept));
+
+    // --- Step 3: Validation Report ---
+    int lo, hi, loC, hiC;
+    envelopeRanks(nRep - 1, lo, hi);
+    envelopeRanks((int)kept.size(), loC, hiC);
+    cout << "Step 3: Envelope validation (ratio to nominal; ranks " << lo << "/" << hi << " -> "
+         << loC << "/" << hiC << ")" << endl;
+    cout << "  Cell                  Full [16%, 84%]        Compressed [16%, 84%]    max |d| / half-width" << endl;
+
+    double worst = 0;
+    for (int i = 0; i < compressor.NCalibrationCells(); ++i) {
+        int c = compressor.CalibrationCells()[i];
+        const EnvelopeStats& ref = compressor.Reference(i);
+        EnvelopeStats cmp = compressor.Stats(i, kept);
+        double half = 0.5 * (ref.hi - ref.lo);
+        double dev = std::max(std::fabs(cmp.lo - ref.lo), std::fabs(cmp.hi - ref.hi)) / (half > 0 ? half : 1.0);
+        worst = std::max(worst, dev);
+        printf("  Bin %d %-9s  [%.4f, %.4f]       [%.4f, %.4f]       %.3f\n",
+               binNumbers[c / nMjClasses], mjLabels[c % nMjClasses].c_str(),
+               ref.lo, ref.hi, cmp.lo, cmp.hi, dev);
+    }
+    printf("Worst envelope shift: %.3f of the half-width\n", worst);
+
+    // --- Step 4: Rewrite ---
+    if (!output.empty()) {
+        // An extra --cut is applied to the rewritten events and recorded with the skim's own
+        string out_cut = skim.Cut();
+        if (!sel.IsTrivial()) out_cut = out_cut.empty() ? cut : "(" + out_cut + ") && (" + cut + ")";
+
+        SkimWriter writer;
+        if (!writer.Open(output, nCells, (int)kept.size() + 1, out_cut, error)) {
+            cout << "[Error] " << error << endl;
+            return 1;
+        }
+        writer.SetCodec(codec);
+        vector<uint16_t> ids = {skim.ReplicaIds()[0]};
+        for (int k : kept) ids.push_back(skim.ReplicaIds()[k]);
+
+        vector<float> w(kept.size() + 1), src(nRep);
+        for (int c = 0; c < nCells; ++c) {
+            SkimCell cell = skim.Cell(c);
+            for (uint64_t e = 0; e < cell.n; ++e) {
+                if (!masks[c].empty() && !masks[c][e]) continue;
+                cell.Decode(e, src.data());
+                w[0] = src[0];
+                for (size_t m = 0; m < kept.size(); ++m) w[m + 1] = src[kept[m]];
+                writer.Add(c, cell.mj12[e], cell.njets[e], cell.nbm[e], w.data(), (int)w.size());
+            }
+        }
+        if (!writer.Close(error, ids)) {
+            cout << "[Error] " << error << endl;
+            return 1;
+        }
+        cout << "Compressed skim saved as " << output << " (" << writer.Events() << " events, "
+             << w.size() << " weights each, " << skimCodecName(writer.Codec()) << ")" << endl;
+        if (codec != writer.Codec())
+            cout << "[Warning] ratio16 not possible (" << writer.CodecNote() << "), weights stored as float" << endl;
+
+        // --- Speedup (measured on both files) ---
+        SkimReader compressed;
+        if (!compressed.Open(output, error)) {
+            cout << "[Error] " << error << endl;
+            return 1;
+        }
+        vector<double> timing_sums((size_t)nCells * nRep);
+        double tFull = timeAccumulate(skim, nRep, floatBlock, timing_sums);
+        double tComp = timeAccumulate(compressed, compressed.NReplicas(), floatBlock, timing_sums);
+        printf("Accumulation time: %.1f ms (%d weights) -> %.1f ms (%d weights), speedup x%.2f\n",
+               tFull, nRep, tComp, compressed.NReplicas(), tComp > 0 ? tFull / tComp : 0.0);
+    } else {
+        // Without a rewritten skim only the arithmetic reduction can be stated
+        printf("Weights per event: %d -> %d (x%.2f less accumulation work; write with -o to measure)\n",
+               nRep, (int)kept.size() + 1, (double)nRep / (kept.size() + 1));
+    }
+    return 0;
+}
@@ -0,0 +1,398 @@
+// -------------------------------------------------------------------------
+// Make PDF Skim (Bin-Partitioned Skim Writer)
+// File: make_pdf_skim.cpp
+//
+// [Logic]
+// 1. Event Loop:
+//    - Same reading as the plot tools: compiled --cut, block-wise lazy
+//      read of 'weight', optional --bins / --mj restriction, corrupted
+//      clusters skipped.
+//    - --autotune picks the read settings (threads, block size,
+//      TTreeCache, prefetch) from short timed probes and stores them per
+//      host and storage class for later runs (pdf_autotune.h).
+//    - --weights-file a_w.root,... reads 'weight' from separate files,
+//      one per input, aligned entry by entry (pdf_event_loop.h).
+//    - --open-ahead N opens the next N inputs in the background while
+//      one is read (pdf_input_opener.h).
+//    - Identify the cell (Physical Bin, Mj class) of each passing event.
+//    - Stage the cluster's events; hand them to the writer only once the
+//      cluster was read cleanly.
+// 2. Write:
+//    - Events are grouped by cell with an offset table (see pdf_skim.h),
+//      each cell's replica weights stored contiguously, so a later
+//      per-cell study reads exactly one cell with one sequential read.
+//    - --codec ratio16 stores the nominal as float and the replicas as
+//      16-bit ratios to it (see [Codec] in pdf_skim.h). A size codec: ~2x
+//      smaller skims, but summing them is slower than float skims with
+//      float blocks (decoding costs more than the bytes it saves while the
+//      cell is cached); use it when disk or page cache is the limit.
+// 3. Columnar Export (optional, same pass):
+//    - --arrow out.arrow|out.feather|out.parquet also writes the selected
+//      events (cell, mj12, njets, nbm, weights as a fixed-size list) for
+//      Arrow-based consumers, through a background writer thread
+//      (pdf_arrow_export.h). Needs a build with -DPDFW_WITH_ARROW.
+//    - With --arrow, -o may be omitted to skip the .pdfskim output; no
+//      skim is spooled then, the weight count comes from --replicas or the
+//      first stored event.
+//    - A failed write removes the partial Arrow / Parquet file.
+//
+// compile: g++ -O2 -o make_pdf_skim.exe make_pdf_skim.cpp $(root-config --cflags --glibs)
+// compile (Arrow): g++ -O2 -DPDFW_WITH_ARROW -o make_pdf_skim.exe make_pdf_skim.cpp $(root-config --cflags --glibs) $(pkg-config --cflags --libs arrow parquet)
+// run: ./make_pdf_skim.exe -o selected.pdfskim [--arrow selected.parquet] final_output.root [more_files.root ...]
+// -------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include "pdf_event_loop.h"
+#include "pdf_autotune.h"
+#include "pdf_input_opener.h"
+#include "pdf_skim.h"
+#include "pdf_arrow_export.h"
+
+using namespace std;
+
+// --- Binning Definition (Same as the plot tools) ---
+const int nBins = 14;
+const int binNumbers[nBins] = {
+    22, 23, 24, // Nb=0
+    25, 26, 27, // Nb=1
+    28, 29, 30, // Nb=2
+    31, 32, 33, // Nb=3
+    35, 36      // Nb>=4 (Bin 34 skipped)
+};
+
+// --- Mj12 Binning Definition ---
+const int nMjBins = 3;
+const string mjLabels[nMjBins] = {
+    "500-800",
+    "800-1100",
+    "1100+"
+};
+
+// Helper: Get Array Index (0~13) from Bin Number
+int getIdx(int binNum) {
+    for(int i=0; i<nBins; ++i) {
+        if(binNumbers[i] == binNum) return i;
+    }
+    return -1;
+}
+
+// Helper: Determine Bin Number
+int getBinNumber(int njets, int nbm) {
+    int j_cat = -1;
+    if (njets >= 4 && njets <= 5) j_cat = 0;
+    else if (njets >= 6 && njets <= 7) j_cat = 1;
+    else if (njets >= 8) j_cat = 2;
+
+    if (j_cat == -1) return -1;
+
+    if (nbm == 0) return (22 + j_cat);
+    if (nbm == 1) return (25 + j_cat);
+    if (nbm == 2) return (28 + j_cat);
+    if (nbm == 3) return (31 + j_cat);
+    if (nbm >= 4) {
+        if (j_cat == 0) return 31; // Merged
+        if (j_cat == 1) return 35;
+        if (j_cat == 2) return 36;
+    }
+    return -1;
+}
+
+// Staged event of the current cluster (weights kept in a flat buffer)
+struct StagedEvent {
+    int cell;
+    float mj12;
+    int njets, nbm;
+    size_t wOffset;
+    int nWeights;
+};
+
+int main(int argc, char* argv[]) {
+    // --- Options ---
+    string cut = "nleps == 1";
+    string output;
+    string arrow_output;
+    int blockSize = kDefaultBlockSize;
+    bool block_given = false, autotune = false;
+    int open_ahead = kDefaultOpenAhead;
+    int nReplicas = 0;
+    string codec_arg = "float";
+    string bins_arg, mj_arg;
+    string weights_arg;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--arrow" && i + 1 < argc) arrow_output = argv[++i];
+        else if (arg == "--cut" && i + 1 < argc) cut = argv[++i];
+        else if (arg == "--block" && i + 1 < argc) { blockSize = atoi(argv[++i]); block_given = true; }
+        else if (arg == "--autotune") autotune = true;
+        else if (arg == "--open-ahead" && i + 1 < argc) open_ahead = atoi(argv[++i]);
+        else if (arg == "--weights-file" && i + 1 < argc) weights_arg = argv[++i];
+        else if (arg == "--replicas" && i + 1 < argc) nReplicas = atoi(argv[++i]);
+        else if (arg == "--codec" && i + 1 < argc) codec_arg = argv[++i];
+        else if (arg == "--bins" && i + 1 < argc) bins_arg = argv[++i];
+        else if (arg == "--mj" && i + 1 < argc) mj_arg = argv[++i];
+        else inputs.push_back(arg);
+    }
+    if (blockSize < 1) blockSize = kDefaultBlockSize;
+
+    if (inputs.empty() || (output.empty() && arrow_output.empty())) {
+        cout << "Usage: ./make_pdf_skim.exe -o out.pdfskim [--arrow out.parquet] [--cut \"nleps == 1\"] [--block N] [--autotune] [--open-ahead N] [--weights-file w.root,...] [--replicas N]"
+             << " [--codec float|ratio16] [--bins 35,36] [--mj 1100+] [root_file ...]" << endl;
+        return 1;
+    }
+
+    // --- Weights Friend Files (--weights-file, one per ROOT input, in order) ---
+    vector<string> weight_files = splitList(weights_arg);
+    const size_t n_root_inputs = inputs.size();
+    if (!weight_files.empty() && weight_files.size() != n_root_inputs) {
+        cout << "[Error] --weights-file needs one file per ROOT input (" << n_root_inputs << "), got "
+             << weight_files.size() << endl;
+        return 1;
+    }
+    if (!output.empty() && !isSkimFile(output)) {
+        cout << "[Error] Output name must end in .pdfskim: " << output << endl;
+        return 1;
+    }
+    uint32_t codec = kSkimCodecFloat;
+    if (!parseSkimCodec(codec_arg, codec)) {
+        cout << "[Error] Unknown --codec " << codec_arg << " (float, ratio16)" << endl;
+        return 1;
+    }
+
+    // --- Selection ---
+    Selection sel;
+    string sel_error;
+    if (!sel.Compile(cut, sel_error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << sel_error << endl;
+        return 1;
+    }
+    cout << "Selection: " << (sel.IsTrivial() ? "(none)" : cut) << endl;
+
+    vector<string> columns = {"njets", "nbm", "mj12"};
+    const int cNjets = 0, cNbm = 1, cMj12 = 2;
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+    sel.Bind(columns, sel_error);
+
+    // --- Region Restriction (--bins / --mj) ---
+    RegionFilter region;
+    if (!bins_arg.empty() || !mj_arg.empty()) {
+        vector<int> wanted_bins;
+        for (const string& item : splitList(bins_arg)) {
+            int bIdx = getIdx(atoi(item.c_str()));
+            if (bIdx == -1) {
+                cout << "[Error] Unknown bin in --bins: " << item << endl;
+                return 1;
+            }
+            wanted_bins.push_back(bIdx);
+        }
+        if (wanted_bins.empty()) for (int b = 0; b < nBins; ++b) wanted_bins.push_back(b);
+
+        // Without --mj every Mj class is kept, including mj12 < 500
+        vector<int> wanted_mj;
+        for (const string& item : splitList(mj_arg)) {
+            int mIdx = -1;
+            for (int m = 0; m < nMjBins; ++m) if (item == mjLabels[m]) mIdx = m;
+            if (mIdx == -1 && item.size() == 1 && item[0] >= '0' && item[0] < '0' + nMjBins) mIdx = item[0] - '0';
+            if (mIdx == -1) {
+                cout << "[Error] Unknown Mj bin in --mj: " << item << " (use 500-800, 800-1100, 1100+ or 0~2)" << endl;
+                return 1;
+            }
+            wanted_mj.push_back(mIdx);
+        }
+        if (wanted_mj.empty()) for (int m = 0; m < kMjClasses; ++m) wanted_mj.push_back(m);
+
+        region.wanted = 0;
+        for (int b : wanted_bins)
+            for (int m : wanted_mj) region.wanted |= cellBit(b, m);
+    }
+
+    // --- Skim Writer (-o only) ---
+    SkimWriter writer;
+    string write_error;
+    if (!output.empty()) {
+        if (!writer.Open(output, nBins * kMjClasses, nReplicas, cut, write_error)) {
+            cout << "[Error] " << write_error << endl;
+            return 1;
+        }
+        writer.SetCodec(codec);
+    }
+
+    // Weights stored per event: --replicas, else the first stored event's count
+    // (events with fewer are not stored, as in SkimWriter::Add)
+    int n_weights = nReplicas;
+    vector<uint64_t> cell_events(nBins * kMjClasses, 0);
+    uint64_t n_stored = 0;
+
+    // --- Columnar Export (Arrow IPC / Parquet) ---
+#ifdef PDFW_WITH_ARROW
+    ArrowSkimExporter arrow_writer;
+    if (!arrow_output.empty() && !arrow_writer.Open(arrow_output, write_error)) {
+        cout << "[Error] " << write_error << endl;
+        return 1;
+    }
+#else
+    if (!arrow_output.empty()) {
+        cout << "[Error] --arrow needs a build with -DPDFW_WITH_ARROW (Arrow C++ and Parquet)" << endl;
+        return 1;
+    }
+#endif
+
+    // Per-cluster staging
+    vector<StagedEvent> staged;
+    vector<float> staged_weights;
+    auto resetCluster = [&]() { staged.clear(); staged_weights.clear(); };
+    Long64_t nShort = 0; // events with fewer weights than the skim stores
+
+    SkipLog skip_log;
+    vector<float> *weight_vec = nullptr;
+
+    // Read settings per storage class (--autotune / stored, see pdf_autotune.h)
+    ReadTuner tuner("make_pdf_skim", autotune, blockSize, block_given);
+
+    // Inputs opened ahead of the loop (--open-ahead, see pdf_input_opener.h)
+    InputOpener opener(inputs, open_ahead);
+
+    size_t root_index = 0;
+    for (const string& filename : inputs) {
+        string weights_name = weight_files.empty() ? "" : weight_files[root_index++];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+
+        // Cluster index: only needed to skip clusters in a restricted run
+        // (built before the branch addresses below are set)
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
+        }
+
+        // --- Read Settings ---
+        // (with a weights file, the payload is read from the friend tree)
+        string payload_name = weights_name.empty() ? "weight" : "";
+        ReadConfig read_cfg = tuner.Get(filename, tree, columns, sel, payload_name);
+        applyReadConfig(tree, read_cfg, columns, payload_name);
+
+        // --- Branch Setup ---
+        BlockReader reader;
+        string read_error;
+        TFile* weights_file = nullptr;
+        TTree* weights_tree = weights_name.empty() ? tree : openWeightsFriend(weights_name, tree, weights_file, read_error);
+        TBranch* payload = weights_tree ? weights_tree->GetBranch("weight") : nullptr;
+        if (!payload && read_error.empty()) read_error = "'weight' branch is required!";
+        if (!payload || !reader.Setup(tree, columns, read_cfg.blockSize, read_error)) {
+            cout << "[Error] " << read_error << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+            closeInput(weights_file);
+            file->Close();
+            delete file;
+            continue;
+        }
+        if (weights_file) applyReadConfig(weights_tree, read_cfg, {}, "weight");
+        weights_tree->SetBranchAddress("weight", &weight_vec);
+
+        // --- Event Loop ---
+        cout << "Skimming " << tree->GetEntries() << " events (" << filename << ")..." << endl;
+
+        resetCluster();
+        processSelectedBlocks(tree, filename, skip_log, reader, sel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(cNjets, row), (int)reader.Get(cNbm, row)));
+                return bIdx != -1 && region.WantCell(bIdx, cellMjClass(reader.Get(cMj12, row)));
+            },
+            [&](Long64_t, int row) {
+                if (!weight_vec || weight_vec->empty()) return;
+
+                int njets = (int)reader.Get(cNjets, row);
+                int nbm   = (int)reader.Get(cNbm, row);
+                int bIdx = getIdx(getBinNumber(njets, nbm));
+                if (bIdx == -1) return;
+                float mj12 = reader.Get(cMj12, row);
+
+                staged.push_back({cellKey(bIdx, cellMjClass(mj12)), mj12, njets, nbm,
+                                  staged_weights.size(), (int)weight_vec->size()});
+                staged_weights.insert(staged_weights.end(), weight_vec->begin(), weight_vec->end());
+            },
+            [&]() {
+                for (const StagedEvent& ev : staged) {
+                    const float* w = staged_weights.data() + ev.wOffset;
+                    if (n_weights == 0) n_weights = ev.nWeights;
+                    if (ev.nWeights < n_weights) {
+                        ++nShort;
+                        continue;
+                    }
+                    if (!output.empty()) writer.Add(ev.cell, ev.mj12, ev.njets, ev.nbm, w, ev.nWeights);
+#ifdef PDFW_WITH_ARROW
+                    if (!arrow_output.empty())
+                        arrow_writer.Add(ev.cell, ev.mj12, ev.njets, ev.nbm, w, n_weights);
+#endif
+                    ++cell_events[ev.cell];
+                    ++n_stored;
+                }
+                resetCluster();
+            },
+            resetCluster);
+
+        closeInput(weights_file);
+        file->Close();
+        delete file;
+    }
+
+    skip_log.Print();
+
+    // --- Write Final Layout ---
+    cout << "Writing " << n_stored << " events (" << n_weights << " weights each) to "
+         << (output.empty() ? arrow_output : output) << "..." << endl;
+    if (!output.empty()) {
+        if (!writer.Close(write_error)) {
+            cout << "[Error] " << write_error << endl;
+#ifdef PDFW_WITH_ARROW
+            // The export of a failed run must not look complete
+            if (!arrow_output.empty()) {
+                string ignored;
+                arrow_writer.Close(ignored);
+                std::remove(arrow_output.c_str());
+            }
+#endif
+            return 1;
+        }
+        if (codec != writer.Codec())
+            cout << "[Warning] ratio16 not possible (" << writer.CodecNote() << "), weights stored as float" << endl;
+        else if (codec == kSkimCodecRatio16)
+            cout << Form("Weight codec: ratio16 (ratio error <= %.2e)", writer.RatioError()) << endl;
+    }
+
+#ifdef PDFW_WITH_ARROW
+    if (!arrow_output.empty()) {
+        if (!arrow_writer.Close(write_error)) {
+            cout << "[Error] Arrow export: " << write_error << endl;
+            std::remove(arrow_output.c_str());
+            return 1;
+        }
+        cout << "Columnar export saved as " << arrow_output << " (" << arrow_writer.Rows() << " rows)" << endl;
+    }
+#endif
+    if (nShort > 0)
+        cout << "[Warning] " << nShort << " events had fewer than " << n_weights
+             << " weights and were not stored." << endl;
+
+    for (int b = 0; b < nBins; ++b) {
+        cout << Form("  Bin %d :", binNumbers[b]);
+        for (int m = 0; m < kMjClasses; ++m) cout << " " << cell_events[cellKey(b, m)];
+        cout << endl;
+    }
+    if (!output.empty()) cout << "Skim saved as " << output << endl;
+    return 0;
+}
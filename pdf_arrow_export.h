@@ -0,0 +1,225 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Arrow IPC / Parquet Export of Selected Events
+// File: pdf_arrow_export.h
+//
+// [Columns] (one row per selected event)
+//   cell    int32   cell key, bIdx * 4 + mjClass (see pdf_region.h)
+//   mj12    float32
+//   njets   int32
+//   nbm     int32
+//   weights fixed_size_list<float32, nReplicas>  (0 = nominal)
+//
+// [Format] chosen by the output extension
+//   .arrow / .feather : Arrow IPC file (memory-mappable, zero-copy readers)
+//   .parquet          : Parquet, row groups of kArrowRowGroupRows rows,
+//                       column encoding parallelized by Arrow
+//
+// [Parallel Writer]
+// - The event loop only appends to column builders. Every
+//   kArrowBatchRows rows a RecordBatch is finished and handed to a writer
+//   thread through a short bounded queue, so encoding/compression and
+//   disk writes overlap with reading the next clusters.
+//
+// Optional: only compiled with -DPDFW_WITH_ARROW (Arrow C++ >= 13), e.g.
+//   $(pkg-config --cflags --libs arrow parquet)
+// -------------------------------------------------------------------------
+
+#ifndef PDF_ARROW_EXPORT_H
+#define PDF_ARROW_EXPORT_H
+
+#ifdef PDFW_WITH_ARROW
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/ipc/writer.h>
+#include <parquet/arrow/writer.h>
+#include <parquet/properties.h>
+
+const int64_t kArrowBatchRows    = 1 << 17; // rows per RecordBatch handed to the writer
+const int64_t kArrowRowGroupRows = 1 << 20; // Parquet row group length
+const size_t  kArrowQueueDepth   = 2;       // batches in flight
+
+class ArrowSkimExporter {
+public:
+    ArrowSkimExporter() {}
+    ArrowSkimExporter(const ArrowSkimExporter&) = delete;
+    ArrowSkimExporter& operator=(const ArrowSkimExporter&) = delete;
+    ~ArrowSkimExporter() { std::string ignored; Close(ignored); }
+
+    // The output is created lazily on the first event (nReplicas known then)
+    bool Open(const std::string& path, std::string& error) {
+        path_ = path;
+        parquet_mode_ = path.size() >= 8 && path.compare(path.size() - 8, 8, ".parquet") == 0;
+        bool ipc_mode = (path.size() >= 6 && path.compare(path.size() - 6, 6, ".arrow") == 0) ||
+                        (path.size() >= 8 && path.compare(path.size() - 8, 8, ".feather") == 0);
+        if (!parquet_mode_ && !ipc_mode) {
+            error = "Arrow export needs a .arrow, .feather or .parquet file name: " + path;
+            return false;
+        }
+        return true;
+    }
+
+    bool Add(int cell, float mj12, int njets, int nbm, const float* weights, int nReplicas) {
+        if (!started_ && !start(nReplicas)) return false;
+
+        bool ok = cell_->Append(cell).ok() && mj12_->Append(mj12).ok() &&
+                  njets_->Append(njets).ok() && nbm_->Append(nbm).ok() &&
+                  weights_->Append().ok() && weight_values_->AppendValues(weights, nReplicas_).ok();
+        if (!ok) { setError("column append failed"); return false; }
+
+        if (++rows_ == kArrowBatchRows) return flushBatch();
+        return true;
+    }
+
+    int64_t Rows() const { return total_rows_ + rows_; }
+
+    bool Close(std::string& error) {
+        if (started_) {
+            if (rows_ > 0) flushBatch();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_ = true;
+            }
+            cv_.notify_all();
+            if (thread_.joinable()) thread_.join();
+
+            arrow::Status st = parquet_mode_ ? parquet_->Close() : ipc_->Close();
+            if (st.ok()) st = sink_->Close();
+            if (!st.ok()) setError(st.ToString());
+            started_ = false;
+        }
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        error = error_;
+        return error_.empty();
+    }
+
+private:
+    bool start(int nReplicas) {
+        nReplicas_ = nReplicas;
+        arrow::MemoryPool* pool = arrow::default_memory_pool();
+        schema_ = arrow::schema({
+            arrow::field("cell", arrow::int32()),
+            arrow::field("mj12", arrow::float32()),
+            arrow::field("njets", arrow::int32()),
+            arrow::field("nbm", arrow::int32()),
+            arrow::field("weights", arrow::fixed_size_list(arrow::float32(), nReplicas)),
+        });
+
+        cell_.reset(new arrow::Int32Builder(pool));
+        mj12_.reset(new arrow::FloatBuilder(pool));
+        njets_.reset(new arrow::Int32Builder(pool));
+        nbm_.reset(new arrow::Int32Builder(pool));
+        auto values = std::make_shared<arrow::FloatBuilder>(pool);
+        weights_.reset(new arrow::FixedSizeListBuilder(pool, values, nReplicas));
+        weight_values_ = values.get();
+
+        auto sink = arrow::io::FileOutputStream::Open(path_);
+        if (!sink.ok()) { setError(sink.status().ToString()); return false; }
+        sink_ = *sink;
+
+        if (parquet_mode_) {
+            auto props = parquet::WriterProperties::Builder()
+                             .max_row_group_length(kArrowRowGroupRows)
+                             ->compression(parquet::Compression::ZSTD)
+                             ->build();
+            auto arrow_props = parquet::ArrowWriterProperties::Builder().set_use_threads(true)->build();
+            auto writer = parquet::arrow::FileWriter::Open(*schema_, pool, sink_, props, arrow_props);
+            if (!writer.ok()) { setError(writer.status().ToString()); return false; }
+            parquet_ = std::move(*writer);
+        } else {
+            auto writer = arrow::ipc::MakeFileWriter(sink_, schema_);
+            if (!writer.ok()) { setError(writer.status().ToString()); return false; }
+            ipc_ = *writer;
+        }
+
+        done_ = false;
+        thread_ = std::thread([this]() { writerLoop(); });
+        started_ = true;
+        return true;
+    }
+
+    // Finish the builders into a RecordBatch and queue it for the writer thread
+    bool flushBatch() {
+        std::shared_ptr<arrow::Array> cell, mj12, njets, nbm, weights;
+        bool ok = cell_->Finish(&cell).ok() && mj12_->Finish(&mj12).ok() && njets_->Finish(&njets).ok() &&
+                  nbm_->Finish(&nbm).ok() && weights_->Finish(&weights).ok();
+        if (!ok) { setError("column finish failed"); return false; }
+
+        auto batch = arrow::RecordBatch::Make(schema_, rows_, {cell, mj12, njets, nbm, weights});
+        total_rows_ += rows_;
+        rows_ = 0;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return queue_.size() < kArrowQueueDepth; });
+        queue_.push_back(batch);
+        lock.unlock();
+        cv_.notify_all();
+        return !hasError();
+    }
+
+    void writerLoop() {
+        for (;;) {
+            std::shared_ptr<arrow::RecordBatch> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]() { return done_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                batch = queue_.front();
+                queue_.pop_front();
+            }
+            cv_.notify_all();
+
+            arrow::Status st = parquet_mode_ ? parquet_->WriteRecordBatch(*batch)
+                                             : ipc_->WriteRecordBatch(*batch);
+            if (!st.ok()) setError(st.ToString());
+        }
+    }
+
+    bool hasError() {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        return !error_.empty();
+    }
+
+    void setError(const std::string& msg) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (error_.empty()) error_ = msg;
+    }
+
+    std::string path_;
+    bool parquet_mode_ = false;
+    bool started_ = false;
+    int nReplicas_ = 0;
+    int64_t rows_ = 0;
+    int64_t total_rows_ = 0;
+
+    std::shared_ptr<arrow::Schema> schema_;
+    std::unique_ptr<arrow::Int32Builder> cell_;
+    std::unique_ptr<arrow::FloatBuilder> mj12_;
+    std::unique_ptr<arrow::Int32Builder> njets_;
+    std::unique_ptr<arrow::Int32Builder> nbm_;
+    std::unique_ptr<arrow::FixedSizeListBuilder> weights_;
+    arrow::FloatBuilder* weight_values_ = nullptr;
+
+    std::shared_ptr<arrow::io::FileOutputStream> sink_;
+    std::shared_ptr<arrow::ipc::RecordBatchWriter> ipc_;
+    std::unique_ptr<parquet::arrow::FileWriter> parquet_;
+
+    std::deque<std::shared_ptr<arrow::RecordBatch>> queue_;
+    std::mutex mutex_;
+    std::mutex error_mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool done_ = false;
+    std::string error_;
+};
+
+#endif // PDFW_WITH_ARROW
+
+#endif // PDF_ARROW_EXPORT_H
@@ -0,0 +1,284 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Read Settings Auto-Tuner
+// File: pdf_autotune.h
+//
+// [Settings] (ReadConfig)
+//   threads  : parallel basket decompression (implicit MT + TTreeCacheUnzip)
+//   block    : entries per selection block (BlockReader)
+//   cache    : TTreeCache size [MB] over the read branches, 0 = off
+//   prefetch : cluster prefetching of the TTreeCache (0 / 1); ROOT has no
+//              depth setting for it, so only on / off is tried
+//
+// [--autotune]
+// - Short timed probes over the first clusters of the first input: each
+//   probe opens the file fresh and reads ~kAutotuneProbeEntries entries
+//   exactly like the tools (selection branches block-wise, payload only
+//   for passing entries). Probes walk through consecutive cluster ranges,
+//   so no probe re-reads data an earlier one pulled into the OS cache.
+// - One setting at a time (coordinate descent): threads, block, cache,
+//   prefetch; a change is kept only if it is >3% faster.
+// - The result is printed and stored per (host, storage class, workload)
+//   in $PDFW_AUTOTUNE_FILE (default ~/.pdfw_autotune); later runs without
+//   --autotune reuse it. The file is re-read right before the write, so the
+//   entries of other keys are kept, and replaced through a temporary file
+//   and rename(), so a concurrent reader never sees it half written.
+//
+// [Storage Class] (storageClass, pdf_basket_cache.h)
+//   remote  : root://, xroot://, http(s)://, dcap:// URLs
+//   network : NFS, CIFS/SMB, FUSE (EOS, CVMFS), Lustre, Ceph, AFS, GPFS
+//   local   : everything else
+// -------------------------------------------------------------------------
+
+#ifndef PDF_AUTOTUNE_H
+#define PDF_AUTOTUNE_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "TROOT.h"
+#include "TSystem.h"
+#include "TTreeCacheUnzip.h"
+
+#include "pdf_event_loop.h"
+
+const Long64_t kAutotuneProbeEntries = 20000; // entries per timed probe
+
+struct ReadConfig {
+    int threads = 1;
+    int blockSize = kDefaultBlockSize;
+    int cacheMB = 0;   // 0: no TTreeCache
+    int prefetch = 0;
+
+    std::string Text() const {
+        return Form("threads %d, block %d, cache %d MB, prefetch %s",
+                    threads, blockSize, cacheMB, prefetch ? "on" : "off");
+    }
+};
+
+// Helper: Process-wide threading setting (before files are read)
+inline void applyReadThreads(int threads) {
+    if (ROOT::IsImplicitMTEnabled()) {
+        if (threads > 1 && (int)ROOT::GetThreadPoolSize() == threads) return;
+        ROOT::DisableImplicitMT(); // the pool size is fixed once enabled
+    }
+    if (threads > 1) {
+        ROOT::EnableImplicitMT(threads);
+        TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+    } else {
+        ROOT::DisableImplicitMT();
+        TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kDisable);
+    }
+}
+
+// Helper: Per-tree settings; call before the branch addresses are set
+inline void applyReadConfig(TTree* tree, const ReadConfig& cfg, const std::vector<std::string>& columns,
+                            const std::string& payloadName) {
+    if (cfg.cacheMB <= 0) {
+        tree->SetCacheSize(0);
+        return;
+    }
+    tree->SetCacheSize((Long64_t)cfg.cacheMB << 20);
+    for (const auto& name : columns) tree->AddBranchToCache(name.c_str(), kTRUE);
+    if (!payloadName.empty()) tree->AddBranchToCache(payloadName.c_str(), kTRUE);
+    tree->StopCacheLearningPhase();
+    tree->SetClusterPrefetch(cfg.prefetch != 0);
+}
+
+// Helper: Time one probe; microseconds per entry, -1 on a failure
+inline double probeRead(const std::string& filename, const std::vector<std::string>& columns,
+                        Selection& sel, const std::string& payloadName, const ReadConfig& cfg,
+                        Long64_t first, Long64_t last) {
+    applyReadThreads(cfg.threads);
+    auto t0 = std::chrono::steady_clock::now();
+
+    TFile* file = openInputFile(filename);
+    if (!file || file->IsZombie()) { delete file; return -1; }
+    TTree* tree = (TTree*)file->Get("tree");
+    bool ok = tree != nullptr;
+
+    if (ok) {
+        applyReadConfig(tree, cfg, columns, payloadName);
+        if (cfg.cacheMB > 0) tree->SetCacheEntryRange(first, last);
+
+        BlockReader reader;
+        std::string error;
+        std::vector<float>* payload_buf = nullptr;
+        TBranch* payload = payloadName.empty() ? nullptr : tree->GetBranch(payloadName.c_str());
+        ok = reader.Setup(tree, columns, cfg.blockSize, error);
+        if (payload) tree->SetBranchAddress(payloadName.c_str(), &payload_buf);
+
+        std::vector<unsigned char> mask;
+        for (Long64_t start = first; ok && start < last; start += cfg.blockSize) {
+            int n = (int)std::min<Long64_t>(cfg.blockSize, last - start);
+            for (int row = 0; row < n && ok; ++row) ok = reader.ReadRow(start + row, row, error);
+            if (!ok) break;
+            sel.Evaluate(reader.Columns(), n, mask);
+            for (int row = 0; row < n && ok; ++row) {
+                if (mask[row] && payload) ok = payload->GetEntry(start + row) >= 0;
+            }
+        }
+        tree->ResetBranchAddresses();
+        delete payload_buf;
+    }
+    file->Close();
+    delete file;
+    if (!ok) return -1;
+
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    return us / (double)(last - first);
+}
+
+// --- Stored Settings ---
+inline std::string autotuneFile() {
+    const char* env = std::getenv("PDFW_AUTOTUNE_FILE");
+    if (env && *env) return env;
+    return std::string(gSystem->HomeDirectory()) + "/.pdfw_autotune";
+}
+
+// Line format: host storage workload threads block cacheMB prefetch usPerEntry
+inline bool loadReadConfig(const std::string& key, ReadConfig& cfg) {
+    std::ifstream in(autotuneFile());
+    std::string line;
+    bool found = false;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string host, storage, workload;
+        ReadConfig c;
+        if (!(ss >> host >> storage >> workload >> c.threads >> c.blockSize >> c.cacheMB >> c.prefetch)) continue;
+        if (host + " " + storage + " " + workload != key || c.blockSize < 1) continue;
+        cfg = c;
+        found = true;
+    }
+    return found;
+}
+
+inline void saveReadConfig(const std::string& key, const ReadConfig& cfg, double usPerEntry) {
+    std::vector<std::string> lines;
+    {
+        std::ifstream in(autotuneFile());
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, key.size() + 1, key + " ") != 0) lines.push_back(line);
+        }
+    }
+    const std::string path = autotuneFile();
+    std::string tmp = path + Form(".tmp.%d", (int)getpid());
+    bool ok;
+    {
+        std::ofstream out(tmp);
+        for (const auto& l : lines) out << l << "\n";
+        out << key << " " << cfg.threads << " " << cfg.blockSize << " " << cfg.cacheMB << " "
+            << cfg.prefetch << " " << usPerEntry << "\n";
+        out.close();
+        ok = (bool)out;
+    }
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        std::cout << "[Warning] Cannot write " << path << ", tuned settings kept for this run only" << std::endl;
+    }
+}
+
+// --- Tuner ---
+// One per tool run. Get() returns the settings for an input file:
+// tuned on the first file of each storage class with --autotune, stored
+// settings otherwise, the defaults (with the --block value) if none.
+class ReadTuner {
+public:
+    ReadTuner(const std::string& workload, bool autotune, int blockSize, bool blockGiven)
+        : workload_(workload), autotune_(autotune), blockSize_(blockSize), blockGiven_(blockGiven) {}
+
+    ReadConfig Get(const std::string& filename, TTree* tree, const std::vector<std::string>& columns,
+                   Selection& sel, const std::string& payloadName) {
+        std::string key = std::string(gSystem->HostName()) + " " + storageClass(filename) + " " + workload_;
+        auto known = std::find(keys_.begin(), keys_.end(), key);
+        if (known != keys_.end()) return configs_[known - keys_.begin()];
+
+        ReadConfig cfg;
+        cfg.blockSize = blockSize_;
+        if (autotune_) {
+            double us = 0;
+            cfg = tune(filename, tree, columns, sel, payloadName, us);
+            saveReadConfig(key, cfg, us);
+            std::cout << "Autotune [" << key << "]: " << cfg.Text() << Form(" (%.2f us/entry)", us) << std::endl;
+        } else if (loadReadConfig(key, cfg)) {
+            std::cout << "Using tuned read settings [" << key << "]: " << cfg.Text() << std::endl;
+        }
+        if (blockGiven_) cfg.blockSize = blockSize_;
+
+        applyReadThreads(cfg.threads);
+        keys_.push_back(key);
+        configs_.push_back(cfg);
+        return cfg;
+    }
+
+private:
+    ReadConfig tune(const std::string& filename, TTree* tree, const std::vector<std::string>& columns,
+                    Selection& sel, const std::string& payloadName, double& bestUs) {
+        // Probe ranges: consecutive cluster-aligned chunks from the start of the file
+        std::vector<std::pair<Long64_t, Long64_t>> ranges;
+        Long64_t nentries = tree->GetEntries();
+        TTree::TClusterIterator it = tree->GetClusterIterator(0);
+        Long64_t start, rangeStart = 0;
+        while ((start = it.Next()) < nentries) {
+            Long64_t end = std::min(it.GetNextEntry(), nentries);
+            if (end - rangeStart >= kAutotuneProbeEntries || end == nentries) {
+                ranges.push_back({rangeStart, end});
+                rangeStart = end;
+            }
+        }
+        ReadConfig best;
+        best.blockSize = blockSize_;
+        if (ranges.empty()) { bestUs = 0; return best; }
+
+        std::cout << "Autotune: probing " << filename << " (" << ranges.size() << " ranges of ~"
+                  << kAutotuneProbeEntries << " entries)..." << std::endl;
+        size_t next = 0;
+        auto probe = [&](const ReadConfig& cfg) {
+            const auto& r = ranges[next++ % ranges.size()];
+            return probeRead(filename, columns, sel, payloadName, cfg, r.first, r.second);
+        };
+        probe(best); // warm-up: dictionaries, first open
+        bestUs = probe(best);
+        if (bestUs < 0) return best;
+
+        auto tryValues = [&](int ReadConfig::*field, const std::vector<int>& values) {
+            for (int v : values) {
+                if (best.*field == v) continue;
+                ReadConfig cfg = best;
+                cfg.*field = v;
+                double us = probe(cfg);
+                std::cout << "  " << cfg.Text() << Form(" : %.2f us/entry", us) << std::endl;
+                if (us >= 0 && us < 0.97 * bestUs) { best = cfg; bestUs = us; }
+            }
+        };
+
+        std::vector<int> threads;
+        int hw = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int t = 2; t <= std::min(hw, 16); t *= 2) threads.push_back(t);
+        tryValues(&ReadConfig::threads, threads);
+        if (!blockGiven_) tryValues(&ReadConfig::blockSize, {256, 1024, 4096});
+        tryValues(&ReadConfig::cacheMB, {10, 30, 100});
+        if (best.cacheMB > 0) tryValues(&ReadConfig::prefetch, {1});
+        return best;
+    }
+
+    std::string workload_;
+    bool autotune_;
+    int blockSize_;
+    bool blockGiven_;
+    std::vector<std::string> keys_;
+    std::vector<ReadConfig> configs_;
+};
+
+#endif // PDF_AUTOTUNE_H
@@ -0,0 +1,325 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Local Basket Cache for Network Inputs
+// File: pdf_basket_cache.h
+//
+// [Idea]
+// - Inputs on a network filesystem (storageClass() == "network") are
+//   opened as a CachedFile: a TFile whose reads go through a cache
+//   directory on a local disk first.
+// - Every read after the file header is keyed by (file UUID, offset,
+//   length): one compressed basket per key, for plain reads and for each
+//   chunk of a TTreeCache vector read. Later runs over the same inputs are
+//   served from the local disk; other read settings only miss on the
+//   reads that differ.
+// - The UUID is written into the file when it is created, so a rewritten
+//   input never hits the old entries.
+//
+// [Layout & LRU]
+// - <dir>/<uuid>/<offset>-<length>: one file per read, written under a
+//   temporary name and renamed, so concurrent tools never see half a
+//   basket.
+// - The index (size, last use) is built from the directory at the first
+//   use; a hit refreshes the file's mtime, so the order survives across
+//   runs and processes. When a new entry pushes the total over the size
+//   bound, the least recently used entries are deleted down to 90% of it.
+//
+// [Settings]
+//   PDFW_BASKET_CACHE=/scratch/pdfw_baskets  enables the cache (off if unset)
+//   PDFW_BASKET_CACHE_GB=20                  size bound (default 10)
+// - SkipLog::Print() reports hits / misses of the run.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_BASKET_CACHE_H
+#define PDF_BASKET_CACHE_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+
+#include "TFile.h"
+#include "TUUID.h"
+#include "TString.h"
+
+// Helper: "remote" (URL), "network" (network / FUSE filesystem) or "local"
+inline std::string storageClass(const std::string& filename) {
+    const char* remote[] = {"root://", "xroot://", "http://", "https://", "dcap://"};
+    for (const char* scheme : remote) {
+        if (filename.compare(0, strlen(scheme), scheme) == 0) return "remote";
+    }
+
+    struct statfs fs;
+    if (statfs(filename.c_str(), &fs) != 0) return "local";
+    switch ((unsigned long)fs.f_type) {
+    case 0x6969:     // NFS
+    case 0x517B:     // SMB
+    case 0xFF534D42: // CIFS
+    case 0x65735546: // FUSE (EOS, CVMFS, ...)
+    case 0x0BD00BD0: // Lustre
+    case 0x00C36400: // Ceph
+    case 0x5346414F: // AFS
+    case 0x47504653: // GPFS
+        return "network";
+    default:
+        return "local";
+    }
+}
+
+class BasketCache {
+public:
+    // Process-wide cache, configured from the environment at the first use
+    static BasketCache& Instance() {
+        static BasketCache cache;
+        return cache;
+    }
+
+    bool Enabled() const { return !dir_.empty(); }
+    const std::string& Dir() const { return dir_; }
+
+    // Copies the cached read into 'buf'; false on a miss
+    bool Get(const std::string& uuid, Long64_t pos, Int_t len, char* buf) {
+        std::string path = entryPath(uuid, pos, len);
+        int fd = open(path.c_str(), O_RDONLY);
+        bool ok = fd >= 0 && readAll(fd, buf, len);
+        if (fd >= 0) {
+            struct stat st;
+            ok = ok && fstat(fd, &st) == 0 && st.st_size == len;
+            if (ok) futimens(fd, nullptr); // LRU: last use = now
+            close(fd);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ok) { ++misses_; return false; }
+        ++hits_;
+        hitBytes_ += len;
+        auto it = entries_.find(path);
+        if (it != entries_.end()) it->second.stamp = ++clock_;
+        return true;
+    }
+
+    // Stores a read (skipped if it alone would take more than 1/8 of the bound)
+    void Put(const std::string& uuid, Long64_t pos, Int_t len, const char* buf) {
+        if ((Long64_t)len * 8 > limit_) return;
+        std::string subdir = dir_ + "/" + uuid;
+        mkdir(subdir.c_str(), 0755);
+        std::string path = entryPath(uuid, pos, len);
+        std::string tmp = path + Form(".tmp%d.%zu", (int)getpid(), std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+        int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return;
+        bool ok = writeAll(fd, buf, len);
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+            unlink(tmp.c_str());
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        storedBytes_ += len;
+        auto it = entries_.find(path);
+        if (it != entries_.end()) total_ -= it->second.size;
+        entries_[path] = {(Long64_t)len, ++clock_};
+        total_ += len;
+        if (total_ > limit_) evict();
+    }
+
+    // One line for the read summary
+    std::string Summary() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Form("Basket cache (%s): %lld hits (%.1f MiB from local disk), %lld misses (%.1f MiB stored), %.2f / %.2f GiB used",
+                    dir_.c_str(), hits_, hitBytes_ / 1048576.0, misses_, storedBytes_ / 1048576.0,
+                    total_ / 1073741824.0, limit_ / 1073741824.0);
+    }
+    bool Used() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return hits_ + misses_ > 0;
+    }
+
+private:
+    struct Entry {
+        Long64_t size;
+        Long64_t stamp; // larger = used more recently
+    };
+
+    BasketCache() {
+        const char* dir = std::getenv("PDFW_BASKET_CACHE");
+        if (!dir || !*dir) return;
+        const char* gb = std::getenv("PDFW_BASKET_CACHE_GB");
+        double limit_gb = gb ? atof(gb) : 10.0;
+        if (limit_gb <= 0) limit_gb = 10.0;
+        limit_ = (Long64_t)(limit_gb * 1073741824.0);
+
+        mkdir(dir, 0755);
+        struct stat st;
+        if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+            std::cout << "[Warning] PDFW_BASKET_CACHE=" << dir << " is not a directory, basket cache off" << std::endl;
+            return;
+        }
+        dir_ = dir;
+        scan();
+    }
+
+    std::string entryPath(const std::string& uuid, Long64_t pos, Int_t len) const {
+        return dir_ + "/" + uuid + "/" + Form("%lld-%d", pos, len);
+    }
+
+    // Index of the existing entries, ordered by mtime (oldest first)
+    void scan() {
+        std::vector<std::pair<struct timespec, std::pair<std::string, Long64_t>>> found;
+        DIR* top = opendir(dir_.c_str());
+        if (!top) return;
+        while (struct dirent* d = readdir(top)) {
+            if (d->d_name[0] == '.') continue;
+            std::string subdir = dir_ + "/" + d->d_name;
+            DIR* sub = opendir(subdir.c_str());
+            if (!sub) continue;
+            while (struct dirent* e = readdir(sub)) {
+                if (e->d_name[0] == '.') continue;
+                std::string path = subdir + "/" + e->d_name;
+                struct stat st;
+                if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+                if (strstr(e->d_name, ".tmp")) { // left by a killed run (or still being written)
+                    if (st.st_mtime + 3600 < time(nullptr)) unlink(path.c_str());
+                    continue;
+                }
+                found.push_back({st.st_mtim, {path, (Long64_t)st.st_size}});
+            }
+            closedir(sub);
+        }
+        closedir(top);
+
+        std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+            return a.first.tv_sec != b.first.tv_sec ? a.first.tv_sec < b.first.tv_sec : a.first.tv_nsec < b.first.tv_nsec;
+        });
+        for (const auto& f : found) {
+            entries_[f.second.first] = {f.second.second, ++clock_};
+            total_ += f.second.second;
+        }
+        if (total_ > limit_) evict();
+    }
+
+    // Drops the least recently used entries down to 90% of the bound (mutex held)
+    void evict() {
+        std::vector<std::pair<Long64_t, std::string>> order;
+        for (const auto& e : entries_) order.push_back({e.second.stamp, e.first});
+        std::sort(order.begin(), order.end());
+        for (const auto& o : order) {
+            if (total_ <= limit_ / 10 * 9) break;
+            unlink(o.second.c_str());
+            total_ -= entries_[o.second].size;
+            entries_.erase(o.second);
+        }
+    }
+
+    static bool readAll(int fd, char* buf, Long64_t len) {
+        while (len > 0) {
+            ssize_t n = read(fd, buf, len);
+            if (n <= 0) return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+    static bool writeAll(int fd, const char* buf, Long64_t len) {
+        while (len > 0) {
+            ssize_t n = write(fd, buf, len);
+            if (n <= 0) return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    std::string dir_;
+    Long64_t limit_ = 0;
+    mutable std::mutex mutex_;
+    std::map<std::string, Entry> entries_;
+    Long64_t total_ = 0, clock_ = 0;
+    Long64_t hits_ = 0, misses_ = 0, hitBytes_ = 0, storedBytes_ = 0;
+};
+
+// TFile whose reads are served from / stored into the BasketCache.
+// ROOT's convention: the Read* methods return kTRUE on an error.
+class CachedFile : public TFile {
+public:
+    explicit CachedFile(const char* name) : TFile(name, "READ") {
+        if (!IsZombie()) uuid_ = GetUUID().AsString();
+    }
+
+    Bool_t ReadBuffer(char* buf, Int_t len) override { return ReadBuffer(buf, fOffset, len); }
+
+    Bool_t ReadBuffer(char* buf, Long64_t pos, Int_t len) override {
+        BasketCache& cache = BasketCache::Instance();
+        if (uuid_.empty() || inner_) return TFile::ReadBuffer(buf, pos, len);
+        if (cache.Get(uuid_, pos, len, buf)) {
+            Seek(pos + len);
+            return kFALSE;
+        }
+        if (TFile::ReadBuffer(buf, pos, len)) return kTRUE;
+        cache.Put(uuid_, pos, len, buf);
+        return kFALSE;
+    }
+
+    // Vector read (TTreeCache): the chunks lie back to back in 'buf';
+    // only the misses go to the file, in one vector read
+    Bool_t ReadBuffers(char* buf, Long64_t* pos, Int_t* len, Int_t nbuf) override {
+        BasketCache& cache = BasketCache::Instance();
+        if (uuid_.empty() || inner_ || !buf) return TFile::ReadBuffers(buf, pos, len, nbuf);
+
+        std::vector<Long64_t> miss_pos, miss_at;
+        std::vector<Int_t> miss_len;
+        Long64_t at = 0, miss_bytes = 0;
+        for (Int_t i = 0; i < nbuf; ++i) {
+            if (!cache.Get(uuid_, pos[i], len[i], buf + at)) {
+                miss_pos.push_back(pos[i]);
+                miss_len.push_back(len[i]);
+                miss_at.push_back(at);
+                miss_bytes += len[i];
+            }
+            at += len[i];
+        }
+        if (miss_pos.empty()) return kFALSE;
+
+        // The base class may fall back to ReadBuffer per chunk: no caching there
+        std::vector<char> fetched(miss_bytes);
+        inner_ = true;
+        Bool_t failed = TFile::ReadBuffers(fetched.data(), miss_pos.data(), miss_len.data(), (Int_t)miss_pos.size());
+        inner_ = false;
+        if (failed) return kTRUE;
+
+        Long64_t from = 0;
+        for (size_t j = 0; j < miss_pos.size(); ++j) {
+            memcpy(buf + miss_at[j], fetched.data() + from, miss_len[j]);
+            cache.Put(uuid_, miss_pos[j], miss_len[j], fetched.data() + from);
+            from += miss_len[j];
+        }
+        return kFALSE;
+    }
+
+private:
+    std::string uuid_; // empty while the header is read
+    bool inner_ = false;
+};
+
+// Helper: Open an input for reading, through the basket cache when it is
+// enabled and the file lives on a network filesystem
+inline TFile* openInputFile(const std::string& filename) {
+    if (BasketCache::Instance().Enabled() && storageClass(filename) == "network") return new CachedFile(filename.c_str());
+    return TFile::Open(filename.c_str(), "READ");
+}
+
+#endif // PDF_BASKET_CACHE_H
@@ -0,0 +1,167 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Replica-Set Compression
+// File: pdf_compress.h
+//
+// [Logic]
+// - Calibration input: per-cell sums of every stored weight,
+//     sums[cell][k], k = 0 nominal, k = 1 ~ nRep-1 replicas
+//   (e.g. one accumulation pass over a skim).
+// - Per cell the replica ratios R_k = sums[k] / sums[0] are summarized by
+//   four estimators: mean, standard deviation, 16th and 84th percentile
+//   (the CG envelope). A subset S of the replicas is scored by
+//     ERF(S) = sum over cells, estimators of ((est_S - est_all) / std_all)^2
+// - Selection: greedy forward (add the replica that lowers ERF most), then
+//   swap passes (exchange a kept and a dropped replica while ERF drops).
+//   Deterministic, no random seed.
+// - The nominal (k = 0) is always kept in front of the subset.
+//
+// ROOT-free.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_COMPRESS_H
+#define PDF_COMPRESS_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Helper: 0-based 16th / 84th percentile ranks for n sorted values
+// (n = 100 -> 15 / 83, as in the plot tools)
+inline void envelopeRanks(int n, int& lo, int& hi) {
+    lo = std::max(0, 16 * n / 100 - 1);
+    hi = std::min(n - 1, std::max(0, (84 * n + 99) / 100 - 1));
+}
+
+struct EnvelopeStats {
+    double mean = 0, std = 0, lo = 0, hi = 0;
+};
+
+// Helper: Estimators of a set of ratios (values is reordered)
+inline EnvelopeStats envelopeStats(std::vector<double>& values) {
+    EnvelopeStats s;
+    const int n = (int)values.size();
+    if (n == 0) return s;
+    for (double v : values) s.mean += v;
+    s.mean /= n;
+    for (double v : values) s.std += (v - s.mean) * (v - s.mean);
+    s.std = std::sqrt(s.std / n);
+
+    int lo, hi;
+    envelopeRanks(n, lo, hi);
+    std::sort(values.begin(), values.end());
+    s.lo = values[lo];
+    s.hi = values[hi];
+    return s;
+}
+
+class ReplicaCompressor {
+public:
+    // sums[cell * nRep + k]; cells with a non-positive nominal or no spread are ignored
+    void Calibrate(const std::vector<double>& sums, int nCells, int nRep) {
+        nRep_ = nRep;
+        cells_.clear();
+        ratios_.clear();
+        reference_.clear();
+        for (int c = 0; c < nCells; ++c) {
+            const double* s = sums.data() + (size_t)c * nRep;
+            if (s[0] <= 0) continue;
+
+            std::vector<double> r(nRep);
+            for (int k = 0; k < nRep; ++k) r[k] = s[k] / s[0];
+            std::vector<double> all(r.begin() + 1, r.end());
+            EnvelopeStats ref = envelopeStats(all);
+            if (ref.std <= 0) continue;
+
+            cells_.push_back(c);
+            ratios_.insert(ratios_.end(), r.begin(), r.end());
+            reference_.push_back(ref);
+        }
+    }
+
+    int NCalibrationCells() const { return (int)cells_.size(); }
+    const std::vector<int>& CalibrationCells() const { return cells_; }
+
+    // Estimators of calibration cell i over the full replica set / a subset
+    const EnvelopeStats& Reference(int i) const { return reference_[i]; }
+    EnvelopeStats Stats(int i, const std::vector<int>& members) const {
+        std::vector<double> values;
+        gather(i, members, values);
+        return envelopeStats(values);
+    }
+
+    double Error(const std::vector<int>& members) const {
+        double erf = 0;
+        std::vector<double> values;
+        for (int i = 0; i < (int)cells_.size(); ++i) {
+            gather(i, members, values);
+            EnvelopeStats s = envelopeStats(values);
+            const EnvelopeStats& ref = reference_[i];
+            double d[4] = {s.mean - ref.mean, s.std - ref.std, s.lo - ref.lo, s.hi - ref.hi};
+            for (double x : d) erf += (x / ref.std) * (x / ref.std);
+        }
+        return erf;
+    }
+
+    // nKeep replicas out of 1 ~ nRep-1, sorted by index
+    std::vector<int> Select(int nKeep, int maxPasses = 20) const {
+        const int nCand = nRep_ - 1;
+        nKeep = std::max(1, std::min(nKeep, nCand));
+        std::vector<int> kept;
+        std::vector<char> used(nRep_, 0);
+
+        // 1. Greedy forward selection
+        while ((int)kept.size() < nKeep) {
+            int best = -1;
+            double bestErf = 0;
+            for (int k = 1; k < nRep_; ++k) {
+                if (used[k]) continue;
+                kept.push_back(k);
+                double erf = Error(kept);
+                kept.pop_back();
+                if (best == -1 || erf < bestErf) { best = k; bestErf = erf; }
+            }
+            kept.push_back(best);
+            used[best] = 1;
+        }
+
+        // 2. Swap refinement
+        double current = Error(kept);
+        for (int pass = 0; pass < maxPasses; ++pass) {
+            bool improved = false;
+            for (int i = 0; i < nKeep; ++i) {
+                for (int k = 1; k < nRep_; ++k) {
+                    if (used[k]) continue;
+                    int old = kept[i];
+                    kept[i] = k;
+                    double erf = Error(kept);
+                    if (erf < current) {
+                        used[old] = 0;
+                        used[k] = 1;
+                        current = erf;
+                        improved = true;
+                    } else {
+                        kept[i] = old;
+                    }
+                }
+            }
+            if (!improved) break;
+        }
+
+        std::sort(kept.begin(), kept.end());
+        return kept;
+    }
+
+private:
+    void gather(int i, const std::vector<int>& members, std::vector<double>& values) const {
+        const double* r = ratios_.data() + (size_t)i * nRep_;
+        values.resize(members.size());
+        for (size_t m = 0; m < members.size(); ++m) values[m] = r[members[m]];
+    }
+
+    int nRep_ = 0;
+    std::vector<int> cells_;               // calibration cell keys
+    std::vector<double> ratios_;           // [calibration cell][k] = sums[k] / sums[0]
+    std::vector<EnvelopeStats> reference_; // full-set estimators per calibration cell
+};
+
+#endif // PDF_COMPRESS_H
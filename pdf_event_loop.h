@@ -0,0 +1,494 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Shared Event Loop Helpers
+// File: pdf_event_loop.h
+//
+// [Fault Tolerance]
+// - Input files that cannot be opened (or have no 'tree') are skipped
+//   and recorded instead of aborting the run.
+// - Events are read cluster by cluster. A read/decompression error
+//   (GetEntry < 0, or an exception thrown by the read) discards the
+//   partially read cluster, records its entry range and continues with
+//   the next cluster.
+// - Callers stage their per-cluster results and only commit them once the
+//   whole cluster was read cleanly, so a bad basket never leaves half a
+//   cluster in the totals.
+//
+// [Region Restriction]
+// - With --bins / --mj, clusters without any requested cell (per the
+//   cluster index of pdf_region.h) are not read, and events outside the
+//   requested cells are dropped before their weights are read.
+//
+// [Lazy Two-Phase Read]
+// - The selection branches of a block of entries are read first and the
+//   compiled --cut (pdf_selection.h) is evaluated on the whole block.
+// - The large payload branch ('weight' / 'sys_pdf') is only read for
+//   entries that passed.
+//
+// [Weights Friend File]
+// - --weights-file keeps the payload in a separate file whose 'tree' is
+//   aligned entry by entry with the main tree (same entries, same order).
+//   The selection branches come from the main file, the payload from the
+//   friend, so the two-phase read spans both files: the friend is only
+//   read for passing entries, and a friend read error discards the
+//   cluster like any other.
+//
+// [Basket Cache]
+// - With $PDFW_BASKET_CACHE set, inputs and weights files on a network
+//   filesystem are read through a local on-disk basket cache
+//   (openInputFile, pdf_basket_cache.h).
+//
+// [Threads]
+// - clusterRanges() splits a tree into contiguous, cluster-aligned entry
+//   ranges; forEachCluster / processSelectedBlocks take an optional range,
+//   so each worker reads its own clusters through its own file handles.
+// - Per-worker SkipLogs are merged with SkipLog::Merge; parallelFor runs
+//   independent per-bin work (sorting, selection, filling) on N threads.
+//
+// Header-only: included by the plot_pdf_variations_*.cpp tools, the
+// compile lines of the tools stay unchanged.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_EVENT_LOOP_H
+#define PDF_EVENT_LOOP_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <atomic>
+
+#include "TFile.h"
+#include "TTree.h"
+#include "TBranch.h"
+#include "TLeaf.h"
+#include "TString.h"
+
+#include "pdf_selection.h"
+#include "pdf_region.h"
+#include "pdf_basket_cache.h"
+
+// --- Skip Bookkeeping ---
+struct SkippedRange {
+    std::string file;
+    Long64_t first; // first entry of the skipped cluster
+    Long64_t last;  // one past the last entry
+    std::string reason;
+};
+
+struct SkipLog {
+    std::vector<std::string> bad_files;    // files skipped entirely
+    std::vector<SkippedRange> bad_ranges;  // clusters skipped inside good files
+    Long64_t nSkippedEvents = 0;           // entries inside skipped clusters
+    Long64_t nReadEvents = 0;              // entries read cleanly
+    Long64_t nFilteredEvents = 0;          // entries in clusters outside the requested region
+
+    bool HasSkips() const { return !bad_files.empty() || !bad_ranges.empty(); }
+
+    // Adds the bookkeeping of a worker (per-range logs, in range order)
+    void Merge(const SkipLog& o) {
+        bad_files.insert(bad_files.end(), o.bad_files.begin(), o.bad_files.end());
+        bad_ranges.insert(bad_ranges.end(), o.bad_ranges.begin(), o.bad_ranges.end());
+        nSkippedEvents += o.nSkippedEvents;
+        nReadEvents += o.nReadEvents;
+        nFilteredEvents += o.nFilteredEvents;
+    }
+
+    // One line summary, also used as plot annotation
+    std::string Summary() const {
+        return Form("Skipped %lld events in %d clusters, %d unreadable files",
+                    nSkippedEvents, (int)bad_ranges.size(), (int)bad_files.size());
+    }
+
+    void Print() const {
+        std::cout << "--- Read Summary ---" << std::endl;
+        std::cout << "Events read cleanly: " << nReadEvents << std::endl;
+        if (nFilteredEvents > 0)
+            std::cout << "Events not read (clusters outside requested region): " << nFilteredEvents << std::endl;
+        if (BasketCache::Instance().Used()) std::cout << BasketCache::Instance().Summary() << std::endl;
+        if (!HasSkips()) {
+            std::cout << "No corrupted files or clusters found." << std::endl;
+            return;
+        }
+        std::cout << Summary() << std::endl;
+        for (const auto& f : bad_files) {
+            std::cout << "  [Skipped File] " << f << std::endl;
+        }
+        for (const auto& r : bad_ranges) {
+            std::cout << "  [Skipped Entries] " << r.file << " [" << r.first << ", " << r.last
+                      << ") : " << r.reason << std::endl;
+        }
+    }
+};
+
+// Helper: Open a file and get its 'tree' without printing.
+// Returns nullptr and the reason (as printed by openInputTree) on failure.
+inline TTree* tryOpenInputTree(const std::string& filename, TFile*& file, std::string& reason) {
+    file = nullptr;
+    try {
+        file = openInputFile(filename);
+    } catch (const std::exception&) {
+        file = nullptr;
+    }
+    if (!file || file->IsZombie()) {
+        reason = "Error opening file: " + filename;
+        delete file;
+        file = nullptr;
+        return nullptr;
+    }
+
+    TTree* tree = (TTree*)file->Get("tree");
+    if (!tree) {
+        reason = "Tree 'tree' not found in " + filename;
+        file->Close();
+        delete file;
+        file = nullptr;
+        return nullptr;
+    }
+    return tree;
+}
+
+// Helper: Open a file and get its 'tree'.
+// Returns nullptr (and records the file) instead of aborting.
+inline TTree* openInputTree(const std::string& filename, TFile*& file, SkipLog& log) {
+    std::string reason;
+    TTree* tree = tryOpenInputTree(filename, file, reason);
+    if (!tree) {
+        std::cout << reason << " (skipped)" << std::endl;
+        log.bad_files.push_back(filename);
+    }
+    return tree;
+}
+
+// Helper: Open the weights friend of 'tree' (see header).
+// Returns nullptr with a reason if it cannot be used for this input.
+inline TTree* openWeightsFriend(const std::string& filename, TTree* tree, TFile*& file, std::string& reason) {
+    file = nullptr;
+    try {
+        file = openInputFile(filename);
+    } catch (const std::exception&) {
+        file = nullptr;
+    }
+    if (!file || file->IsZombie()) {
+        reason = "cannot open weights file " + filename;
+        delete file;
+        file = nullptr;
+        return nullptr;
+    }
+
+    TTree* friendTree = (TTree*)file->Get("tree");
+    if (!friendTree) reason = "no 'tree' in weights file " + filename;
+    else if (friendTree->GetEntries() != tree->GetEntries())
+        reason = Form("weights file %s has %lld entries, main tree %lld (not aligned)",
+                      filename.c_str(), friendTree->GetEntries(), tree->GetEntries());
+    if (!reason.empty()) {
+        file->Close();
+        delete file;
+        file = nullptr;
+        return nullptr;
+    }
+    return friendTree;
+}
+
+// Helper: Close a file opened by openInputTree / openWeightsFriend (null is fine)
+inline void closeInput(TFile*& file) {
+    if (!file) return;
+    file->Close();
+    delete file;
+    file = nullptr;
+}
+
+// Helper: Run one read step, turning ROOT read errors and exceptions into
+// a false return plus a reason.
+template <typename ReadFn>
+bool safeRead(ReadFn read, Long64_t entry, std::string& reason) {
+    Int_t nbytes = -1;
+    try {
+        nbytes = read();
+    } catch (const std::exception& e) {
+        nbytes = -1;
+        reason = e.what();
+    }
+    if (nbytes < 0) {
+        if (reason.empty()) reason = Form("read error at entry %lld", entry);
+        return false;
+    }
+    return true;
+}
+
+// Helper: Fault-tolerant cluster loop.
+// - wantCluster(start) : false -> the cluster is not read at all
+// - readCluster(start, end, reason) : reads/processes [start, end),
+//                                     returns false on a read error
+// - onCommit()  : called once a whole cluster was read cleanly
+// - onDiscard() : called when a cluster hit a read error; drop staged data
+// - [rangeFirst, rangeLast) : only clusters starting in it (cluster-aligned,
+//                             see clusterRanges); rangeLast < 0 = to the end
+template <typename WantFn, typename ClusterFn, typename CommitFn, typename DiscardFn>
+void forEachCluster(TTree* tree, const std::string& filename, SkipLog& log, WantFn wantCluster,
+                    ClusterFn readCluster, CommitFn onCommit, DiscardFn onDiscard,
+                    Long64_t rangeFirst = 0, Long64_t rangeLast = -1) {
+    Long64_t nentries = tree->GetEntries();
+    if (rangeLast >= 0 && rangeLast < nentries) nentries = rangeLast;
+    TTree::TClusterIterator clusterIt = tree->GetClusterIterator(rangeFirst);
+
+    Long64_t start;
+    while ((start = clusterIt.Next()) < nentries) {
+        Long64_t end = clusterIt.GetNextEntry();
+        if (end > nentries) end = nentries;
+
+        if (!wantCluster(start)) {
+            log.nFilteredEvents += end - start;
+            continue;
+        }
+
+        std::string reason;
+        if (readCluster(start, end, reason)) {
+            onCommit();
+            log.nReadEvents += end - start;
+        } else {
+            onDiscard();
+            log.bad_ranges.push_back({filename, start, end, reason});
+            log.nSkippedEvents += end - start;
+            std::cout << "[Warning] Skipping entries [" << start << ", " << end << ") of "
+                      << filename << ": " << reason << std::endl;
+        }
+    }
+}
+
+// --- Lazy Two-Phase Block Reading ---
+// Phase 1 reads only the scalar selection branches for a block of entries
+// into float columns and evaluates the compiled selection on the block.
+// Phase 2 reads the large payload branch (e.g. the 100-float 'weight'
+// vector) only for the entries that passed.
+const int kDefaultBlockSize = 1024;
+
+// One scalar branch, read into a typed buffer and widened into a float column
+struct ScalarInput {
+    std::string name;
+    TBranch* branch = nullptr;
+    char type = 'F'; // I: Int_t, F: Float_t, D: Double_t, O: Bool_t
+    Int_t i = 0;
+    Float_t f = 0;
+    Double_t d = 0;
+    Bool_t o = false;
+
+    float value() const {
+        switch (type) {
+        case 'I': return (float)i;
+        case 'D': return (float)d;
+        case 'O': return o ? 1.f : 0.f;
+        default:  return f;
+        }
+    }
+};
+
+class BlockReader {
+public:
+    // Bind the named scalar branches of tree; column order == names order.
+    bool Setup(TTree* tree, const std::vector<std::string>& names, int blockSize, std::string& error) {
+        names_ = names;
+        inputs_.clear();
+        columns_.assign(names.size(), std::vector<float>(blockSize, 0.f));
+
+        for (const auto& name : names) {
+            std::unique_ptr<ScalarInput> in(new ScalarInput);
+            in->name = name;
+            TLeaf* leaf = tree->GetLeaf(name.c_str());
+            if (!leaf || !leaf->GetBranch()) {
+                error = "branch '" + name + "' not found";
+                return false;
+            }
+            in->branch = leaf->GetBranch();
+
+            std::string type = leaf->GetTypeName();
+            if      (type == "Int_t")    { in->type = 'I'; tree->SetBranchAddress(name.c_str(), &in->i); }
+            else if (type == "Float_t")  { in->type = 'F'; tree->SetBranchAddress(name.c_str(), &in->f); }
+            else if (type == "Double_t") { in->type = 'D'; tree->SetBranchAddress(name.c_str(), &in->d); }
+            else if (type == "Bool_t")   { in->type = 'O'; tree->SetBranchAddress(name.c_str(), &in->o); }
+            else {
+                error = "branch '" + name + "' has unsupported type " + type;
+                return false;
+            }
+            inputs_.push_back(std::move(in));
+        }
+        return true;
+    }
+
+    int Index(const std::string& name) const {
+        for (size_t c = 0; c < names_.size(); ++c) if (names_[c] == name) return (int)c;
+        return -1;
+    }
+
+    int BlockSize() const { return columns_.empty() ? kDefaultBlockSize : (int)columns_[0].size(); }
+    const std::vector<std::string>& Names() const { return names_; }
+    const std::vector<std::vector<float>>& Columns() const { return columns_; }
+    float Get(int col, int row) const { return columns_[col][row]; }
+
+    // Phase 1: read the scalar branches of one entry into a block row
+    bool ReadRow(Long64_t entry, int row, std::string& reason) {
+        for (size_t c = 0; c < inputs_.size(); ++c) {
+            TBranch* br = inputs_[c]->branch;
+            if (!safeRead([&]() { return br->GetEntry(entry); }, entry, reason)) return false;
+            columns_[c][row] = inputs_[c]->value();
+        }
+        return true;
+    }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<ScalarInput>> inputs_;
+    std::vector<std::vector<float>> columns_;
+};
+
+// Helper: Fault-tolerant block loop with the lazy two-phase read.
+// - sel                : evaluated in place (scratch masks), one per thread
+// - region             : clusters missing the requested cells are not read
+// - keepRow(row)       : region check per event (only called for an active
+//                        region), before the payload is read
+// - onPass(entry, row) : called for entries passing the selection, after the
+//                        payload branch was read; row indexes reader columns
+//                        (payload may be null when everything needed is
+//                        in the reader columns)
+// - onCommit / onDiscard and the entry range as in forEachCluster
+template <typename KeepFn, typename PassFn, typename CommitFn, typename DiscardFn>
+void processSelectedBlocks(TTree* tree, const std::string& filename, SkipLog& log,
+                           BlockReader& reader, Selection& sel, TBranch* payload,
+                           const RegionFilter& region, KeepFn keepRow,
+                           PassFn onPass, CommitFn onCommit, DiscardFn onDiscard,
+                           Long64_t rangeFirst = 0, Long64_t rangeLast = -1) {
+    const int blockSize = reader.BlockSize();
+    std::vector<unsigned char> mask(blockSize);
+
+    forEachCluster(tree, filename, log,
+        [&](Long64_t start) { return region.WantCluster(start); },
+        [&](Long64_t start, Long64_t end, std::string& reason) {
+            for (Long64_t first = start; first < end; first += blockSize) {
+                int n = (int)std::min<Long64_t>(blockSize, end - first);
+
+                // Phase 1: selection branches only
+                for (int row = 0; row < n; ++row) {
+                    if (!reader.ReadRow(first + row, row, reason)) return false;
+                }
+                sel.Evaluate(reader.Columns(), n, mask);
+                if (region.Active()) {
+                    for (int row = 0; row < n; ++row) {
+                        if (mask[row] && !keepRow(row)) mask[row] = 0;
+                    }
+                }
+
+                // Phase 2: payload only for passing entries
+                for (int row = 0; row < n; ++row) {
+                    if (!mask[row]) continue;
+                    Long64_t entry = first + row;
+                    if (payload && !safeRead([&]() { return payload->GetEntry(entry); }, entry, reason)) return false;
+                    onPass(entry, row);
+                }
+            }
+            return true;
+        },
+        onCommit, onDiscard, rangeFirst, rangeLast);
+}
+
+// --- Threads ---
+// Helper: Up to n contiguous cluster-aligned entry ranges of similar size
+inline std::vector<std::pair<Long64_t, Long64_t>> clusterRanges(TTree* tree, int n) {
+    std::vector<std::pair<Long64_t, Long64_t>> ranges;
+    Long64_t nentries = tree->GetEntries();
+    if (n < 1) n = 1;
+    TTree::TClusterIterator it = tree->GetClusterIterator(0);
+    Long64_t start, rangeStart = 0;
+    while ((start = it.Next()) < nentries) {
+        Long64_t end = std::min(it.GetNextEntry(), nentries);
+        Long64_t target = nentries * (Long64_t)(ranges.size() + 1) / n;
+        if (end >= target || end == nentries) {
+            ranges.push_back({rangeStart, end});
+            rangeStart = end;
+        }
+    }
+    return ranges;
+}
+
+// Helper: fn(i, thread) for i in [0, n) on up to nThreads threads
+// (indices handed out one at a time; thread in [0, nThreads) for per-thread outputs)
+template <typename Fn>
+void parallelFor(size_t n, int nThreads, Fn fn) {
+    if (nThreads <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i) fn(i, 0);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::min<int>(nThreads, (int)n); ++t) {
+        workers.emplace_back([&, t]() {
+            for (size_t i; (i = next.fetch_add(1)) < n;) fn(i, t);
+        });
+    }
+    for (auto& w : workers) w.join();
+}
+
+// --- Cluster Index (see pdf_region.h) ---
+// Helper: Build the index from the scalar branches of tree.
+// binIdxFn(njets, nbm) -> physical bin index (0~13) or -1.
+// A cluster that cannot be read gets an all-cells mask so the main
+// loop still visits (and reports) it.
+template <typename BinIdxFn>
+ClusterIndex buildClusterIndex(TTree* tree, BinIdxFn binIdxFn) {
+    ClusterIndex index;
+    std::vector<std::string> names = {"njets", "nbm"};
+    bool hasMj = tree->GetBranch("mj12") != nullptr;
+    if (hasMj) names.push_back("mj12");
+
+    BlockReader reader;
+    std::string error;
+    if (!reader.Setup(tree, names, 1, error)) {
+        std::cout << "[Warning] Cannot build cluster index: " << error << std::endl;
+        return index;
+    }
+
+    SkipLog quiet;
+    uint64_t mask = 0;
+    forEachCluster(tree, "index", quiet, [](Long64_t) { return true; },
+        [&](Long64_t start, Long64_t end, std::string& reason) {
+            index.starts.push_back(start);
+            mask = 0;
+            for (Long64_t i = start; i < end; ++i) {
+                if (!reader.ReadRow(i, 0, reason)) return false;
+                int bIdx = binIdxFn((int)reader.Get(0, 0), (int)reader.Get(1, 0));
+                if (bIdx < 0) continue;
+                int mjClass = hasMj ? cellMjClass(reader.Get(2, 0)) : kMjClasses - 1;
+                mask |= cellBit(bIdx, mjClass);
+            }
+            return true;
+        },
+        [&]() { index.masks.push_back(mask); },
+        [&]() { index.masks.push_back(~uint64_t(0)); });
+
+    // Addresses pointed into the local reader
+    tree->ResetBranchAddresses();
+    return index;
+}
+
+// Helper: Get (or build and store) the index of an open input file
+template <typename BinIdxFn>
+ClusterIndex getClusterIndex(TFile* file, TTree* tree, const std::string& filename, BinIdxFn binIdxFn) {
+    ClusterIndex index;
+    std::string uuid = file->GetUUID().AsString();
+    std::string path = clusterIndexPath(filename);
+    if (loadClusterIndex(path, uuid, tree->GetEntries(), index)) {
+        std::cout << "Using cluster index " << path << std::endl;
+        return index;
+    }
+
+    std::cout << "Building cluster index for " << filename << " (scalar branches only)..." << std::endl;
+    index = buildClusterIndex(tree, binIdxFn);
+    if (saveClusterIndex(path, uuid, tree->GetEntries(), index))
+        std::cout << "Saved cluster index " << path << std::endl;
+    else
+        std::cout << "[Warning] Cannot write " << path << ", index kept for this run only" << std::endl;
+    return index;
+}
+
+#endif // PDF_EVENT_LOOP_H
@@ -0,0 +1,135 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Parallel Input Opening
+// File: pdf_input_opener.h
+//
+// [Problem]
+//   The tools open their inputs one after the other inside the event loop.
+//   On a network filesystem or over xrootd every open (file header, keys,
+//   streamer info, the 'tree' header with its basket tables) is a chain of
+//   round trips, so a long input list spends minutes waiting on opens
+//   while the CPU is idle.
+//
+// [InputOpener] (--open-ahead N, default kDefaultOpenAhead)
+// - N background threads open the next N inputs of the list (file and
+//   'tree') while the loop works on the current one. Take() hands them
+//   over in list order and reports a failed open like openInputTree.
+// - --open-ahead 0 opens each file in Take(), on the loop's thread.
+// - Calls ROOT::EnableThreadSafety() for N > 0.
+// - Weights friends (--weights-file) are still opened by the loop.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_INPUT_OPENER_H
+#define PDF_INPUT_OPENER_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+
+#include "TROOT.h"
+
+#include "pdf_event_loop.h"
+
+const int kDefaultOpenAhead = 8; // inputs opened ahead of the loop
+
+// --- Input Opener ---
+class InputOpener {
+public:
+    // files: the ROOT inputs in the order the loop takes them
+    InputOpener(const std::vector<std::string>& files, int ahead)
+        : files_(files), slots_(files.size()), ahead_(std::max(0, ahead)) {
+        if (ahead_ > 0 && !slots_.empty()) {
+            ROOT::EnableThreadSafety();
+            for (int t = 0; t < std::min<int>(ahead_, (int)slots_.size()); ++t)
+                workers_.emplace_back([this]() { Work(); });
+        }
+    }
+
+    ~InputOpener() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto& w : workers_) w.join();
+        for (Slot& s : slots_) closeInput(s.file); // opened ahead, never taken
+    }
+
+    InputOpener(const InputOpener&) = delete;
+    InputOpener& operator=(const InputOpener&) = delete;
+
+    // Next input of the list: like openInputTree (nullptr + recorded on failure).
+    // A filename out of list order is opened directly.
+    TTree* Take(const std::string& filename, TFile*& file, SkipLog& log) {
+        if (cursor_ >= slots_.size() || files_[cursor_] != filename) return openInputTree(filename, file, log);
+        Slot& s = slots_[cursor_++];
+        if (workers_.empty()) {
+            Open(s, filename);
+        } else {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [&]() { return s.done; });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++taken_;
+        }
+        wake_.notify_all();
+
+        file = s.file;
+        s.file = nullptr;
+        if (!s.tree) {
+            std::cout << s.reason << " (skipped)" << std::endl;
+            log.bad_files.push_back(filename);
+            return nullptr;
+        }
+        return s.tree;
+    }
+
+private:
+    struct Slot {
+        bool done = false;   // opened (or failed) by a worker
+        TFile* file = nullptr;
+        TTree* tree = nullptr;
+        std::string reason;
+    };
+
+    void Open(Slot& s, const std::string& filename) {
+        s.tree = tryOpenInputTree(filename, s.file, s.reason);
+    }
+
+    // Worker: opens inputs in list order, at most ahead_ beyond the loop
+    void Work() {
+        for (;;) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&]() { return stop_ || next_ >= slots_.size() || next_ < taken_ + ahead_; });
+                if (stop_ || next_ >= slots_.size()) return;
+                i = next_++;
+            }
+            Open(slots_[i], files_[i]);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                slots_[i].done = true;
+            }
+            done_.notify_all();
+        }
+    }
+
+    std::vector<std::string> files_;
+    std::vector<Slot> slots_;
+    int ahead_;
+
+    size_t cursor_ = 0;  // next slot Take() hands out (loop thread only)
+    std::mutex mutex_;
+    std::condition_variable wake_, done_;
+    size_t next_ = 0;    // next slot to open
+    size_t taken_ = 0;   // slots handed out
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
+
+#endif // PDF_INPUT_OPENER_H
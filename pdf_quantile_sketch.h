@@ -0,0 +1,288 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Memory-Bounded Per-Bin Value Collection
+// File: pdf_quantile_sketch.h
+//
+// [BinValues] (--mem-budget of the BJ tools)
+// - Collects the values of one bin exactly (arena chunks, pdf_value_arena.h)
+//   as long as they fit into the bin's share of the memory budget. The first append that
+//   would exceed the share moves the bin into a QuantileSketch; the exact
+//   values are fed into it and their chunks released.
+// - Exact rank queries select in place over the chunks (SelectExact): one
+//   nth_element for the middle requested rank, then recursively for the
+//   ranks left and right of it (O(N log R) for R ranks).
+// - Budget 0 = unlimited (always exact).
+//
+// [QuantileSketch]
+// - Deterministic compactor sketch: level h holds up to k values of
+//   weight 2^h. A full level is sorted and every other value (alternating
+//   offset) is promoted to level h+1.
+// - Every compaction at level h shifts any rank by at most 2^h; the sum
+//   over all compactions is tracked, so RankError() is a hard bound on
+//   |estimated rank - true rank| in values (not a probabilistic one).
+//   Typical: ~levels / k relative (0.1% for k ~ 16k).
+// - Memory: at most k values per level; k is chosen from the byte share
+//   so that kSketchMaxLevels levels (2^24 k values) stay within it.
+//
+// [Queries]
+// - Items(): (value, weight) pairs sorted by value; exact bins give weight
+//   1 per value, so plotting code handles both cases alike.
+// - ValueAtRank(r) / RankBracket(r): value at 0-based rank r, and the
+//   value interval the exact answer is guaranteed to lie in.
+// - quantileRanks(N, K) / ValuesAtRanks(): K evenly spaced ranks including
+//   both extremes, for plots that draw a bounded number of lines per bin.
+//
+// ROOT-free.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_QUANTILE_SKETCH_H
+#define PDF_QUANTILE_SKETCH_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <utility>
+#include <memory>
+#include <algorithm>
+
+#include "pdf_value_arena.h"
+
+const int kSketchMaxLevels = 24;  // levels the per-bin share is sized for
+const size_t kSketchMinK = 64;    // smallest compactor, whatever the budget
+
+class QuantileSketch {
+public:
+    explicit QuantileSketch(size_t k = 4096) : k_(std::max(k, kSketchMinK)) {}
+
+    // k for a given memory share [bytes]
+    static size_t KForBytes(size_t bytes) { return bytes / (sizeof(double) * kSketchMaxLevels); }
+
+    void Add(double v) {
+        if (levels_.empty()) newLevel();
+        levels_[0].push_back(v);
+        if (n_ == 0 || v < min_) min_ = v;
+        if (n_ == 0 || v > max_) max_ = v;
+        ++n_;
+        if (levels_[0].size() >= k_) compact(0);
+    }
+
+    uint64_t Count() const { return n_; }
+    size_t K() const { return k_; }
+    int Levels() const { return (int)levels_.size(); }
+    double RankError() const { return error_; }
+    double Min() const { return min_; } // exact, compactions may drop it
+    double Max() const { return max_; }
+    size_t Bytes() const {
+        size_t bytes = 0;
+        for (const auto& l : levels_) bytes += l.capacity() * sizeof(double);
+        return bytes;
+    }
+
+    // (value, weight) pairs sorted by value; the weights sum to Count()
+    void Items(std::vector<std::pair<double, double>>& out) const {
+        out.clear();
+        for (size_t h = 0; h < levels_.size(); ++h) {
+            double w = std::ldexp(1.0, (int)h);
+            for (double v : levels_[h]) out.push_back({v, w});
+        }
+        std::sort(out.begin(), out.end());
+    }
+
+private:
+    void newLevel() {
+        levels_.emplace_back();
+        levels_.back().reserve(k_);
+        parity_.push_back(0);
+    }
+
+    void compact(size_t h) {
+        if (h + 1 == levels_.size()) newLevel();
+        std::vector<double>& buf = levels_[h];
+        std::sort(buf.begin(), buf.end());
+
+        // Odd count: the largest value stays behind, the rest pairs up
+        size_t pairs = buf.size() / 2;
+        for (size_t i = 0; i < pairs; ++i) levels_[h + 1].push_back(buf[2 * i + parity_[h]]);
+        double rest = buf.back();
+        bool odd = buf.size() % 2 != 0;
+        buf.clear();
+        if (odd) buf.push_back(rest);
+
+        parity_[h] ^= 1;
+        error_ += std::ldexp(1.0, (int)h);
+        if (levels_[h + 1].size() >= k_) compact(h + 1);
+    }
+
+    size_t k_;
+    uint64_t n_ = 0;
+    double min_ = 0, max_ = 0;
+    double error_ = 0;                       // rank error bound [values]
+    std::vector<std::vector<double>> levels_; // level h: weight 2^h
+    std::vector<unsigned char> parity_;       // alternating offset per level
+};
+
+class BinValues {
+public:
+    // Exact values are kept in chunks of 'arena' (pdf_value_arena.h)
+    void SetStorage(ValueArena* arena, size_t shareBytes) {
+        exact_.SetArena(arena);
+        share_ = shareBytes;
+    }
+
+    void Append(const double* v, size_t n) {
+        if (needsSketch(n)) toSketch();
+        if (sketch_) {
+            for (size_t i = 0; i < n; ++i) sketch_->Add(v[i]);
+        } else {
+            exact_.Append(v, n);
+        }
+    }
+
+    // Moves a staged list (same arena) in without copying; 'staged' is left empty
+    void Append(ChunkedValues& staged) {
+        if (needsSketch(staged.size())) toSketch();
+        if (sketch_) {
+            staged.ForEachChunk([&](const double* v, size_t n) {
+                for (size_t i = 0; i < n; ++i) sketch_->Add(v[i]);
+            });
+            staged.Clear();
+        } else {
+            exact_.Splice(staged);
+        }
+    }
+
+    bool Sketched() const { return sketch_ != nullptr; }
+    const QuantileSketch* Sketch() const { return sketch_.get(); }
+    uint64_t Count() const { return sketch_ ? sketch_->Count() : exact_.size(); }
+    double RankError() const { return sketch_ ? sketch_->RankError() : 0.0; }
+    size_t Bytes() const { return sketch_ ? sketch_->Bytes() : exact_.Bytes(); }
+
+    // Call before the queries: prepares the sketch items
+    void Finalize() {
+        if (sketch_) sketch_->Items(items_);
+    }
+
+    // Exact bins: places the values of the given ranks at their sorted
+    // positions, in place over the chunks (std::nth_element)
+    void SelectExact(std::vector<size_t> ranks) {
+        std::sort(ranks.begin(), ranks.end());
+        ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+        while (!ranks.empty() && ranks.back() >= exact_.size()) ranks.pop_back();
+        selectRanks(0, exact_.size(), ranks.data(), ranks.data() + ranks.size());
+    }
+    void SortExact() { std::sort(exact_.begin(), exact_.end()); }
+
+    // Exact values (order unspecified unless sorted / selected); empty for a sketched bin
+    const ChunkedValues& Exact() const { return exact_; }
+
+    // (value, weight) pairs sorted by value, weight 1 for exact bins
+    void Items(std::vector<std::pair<double, double>>& out) const {
+        if (sketch_) { out = items_; return; }
+        out.clear();
+        exact_.ForEachChunk([&](const double* v, size_t n) {
+            for (size_t i = 0; i < n; ++i) out.push_back({v[i], 1.0});
+        });
+        std::sort(out.begin(), out.end());
+    }
+
+    // Value at 0-based rank r (r < Count()); exact bins index directly
+    // (rank r must have been selected or the values sorted)
+    double ValueAtRank(double r) const {
+        if (!sketch_) return exact_[(size_t)std::min<double>(std::max(r, 0.0), (double)exact_.size() - 1)];
+        double cum = 0;
+        for (const auto& it : items_) {
+            cum += it.second;
+            if (cum > r) return it.first;
+        }
+        return items_.empty() ? 0.0 : items_.back().first;
+    }
+
+    // Values at the ascending ranks (exact bins: selected before), one pass
+    // over the sketch items
+    void ValuesAtRanks(const std::vector<size_t>& ranks, std::vector<double>& out) const {
+        out.clear();
+        if (!sketch_) {
+            for (size_t r : ranks) out.push_back(ValueAtRank((double)r));
+            return;
+        }
+        double cum = 0;
+        size_t i = 0;
+        for (size_t r : ranks) {
+            while (i + 1 < items_.size() && cum + items_[i].second <= (double)r) cum += items_[i++].second;
+            out.push_back(items_.empty() ? 0.0 : items_[i].first);
+        }
+    }
+
+    // Interval [lo, hi] guaranteed to contain the exact value at rank r
+    // (64-bit rank: a bin may hold more than 2^31 values)
+    std::pair<double, double> RankBracket(uint64_t r) const {
+        if (!sketch_) {
+            double v = ValueAtRank((double)r);
+            return {v, v};
+        }
+        double err = RankError();
+        double lo = (double)r - err < 0 ? sketch_->Min() : ValueAtRank((double)r - err);
+        double hi = (double)r + err >= (double)Count() - 1 ? sketch_->Max() : ValueAtRank((double)r + err);
+        return {lo, hi};
+    }
+
+private:
+    // Values [lo, hi); the ranks [r0, r1) are sorted, unique and inside it
+    void selectRanks(size_t lo, size_t hi, const size_t* r0, const size_t* r1) {
+        if (r0 == r1 || hi - lo < 2) return;
+        const size_t* mid = r0 + (r1 - r0) / 2;
+        std::nth_element(exact_.begin() + lo, exact_.begin() + *mid, exact_.begin() + hi);
+        selectRanks(lo, *mid, r0, mid);
+        selectRanks(*mid + 1, hi, mid + 1, r1);
+    }
+
+    bool needsSketch(size_t n) const {
+        return !sketch_ && share_ > 0 && (exact_.size() + n) * sizeof(double) > share_;
+    }
+
+    // The exact values so far go into the sketch; their chunks back to the arena
+    void toSketch() {
+        sketch_.reset(new QuantileSketch(QuantileSketch::KForBytes(share_)));
+        exact_.ForEachChunk([&](const double* v, size_t n) {
+            for (size_t i = 0; i < n; ++i) sketch_->Add(v[i]);
+        });
+        exact_.Clear();
+    }
+
+    size_t share_ = 0;
+    ChunkedValues exact_;
+    std::unique_ptr<QuantileSketch> sketch_;
+    std::vector<std::pair<double, double>> items_; // sketch items after Finalize
+};
+
+// Helper: k evenly spaced 0-based ranks of n values, first and last
+// included (all n ranks if n <= k)
+inline std::vector<size_t> quantileRanks(uint64_t n, size_t k) {
+    std::vector<size_t> ranks;
+    if (n == 0) return ranks;
+    if (n <= k) {
+        for (uint64_t r = 0; r < n; ++r) ranks.push_back((size_t)r);
+        return ranks;
+    }
+    if (k < 2) k = 2;
+    for (size_t i = 0; i < k; ++i) ranks.push_back((size_t)((double)(n - 1) * i / (k - 1) + 0.5));
+    return ranks;
+}
+
+// Helper: "512M", "2G", "1500000000" -> bytes; 0 on a parse error
+inline size_t parseByteSize(const std::string& text) {
+    char* end = nullptr;
+    double v = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || v <= 0) return 0;
+    std::string unit(end);
+    double mult = 1;
+    if (unit == "K" || unit == "k" || unit == "KB") mult = 1024.0;
+    else if (unit == "M" || unit == "MB") mult = 1024.0 * 1024.0;
+    else if (unit == "G" || unit == "GB") mult = 1024.0 * 1024.0 * 1024.0;
+    else if (!unit.empty()) return 0;
+    return (size_t)(v * mult);
+}
+
+#endif // PDF_QUANTILE_SKETCH_H
@@ -0,0 +1,147 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Region-Restricted Reading
+// File: pdf_region.h
+//
+// [Logic]
+// - A "cell" is a (physical bin index, Mj class) pair:
+//     cell = bIdx * 4 + mjClass
+//   mjClass 0~2 follow the Mj12 binning (500-800, 800-1100, 1100+),
+//   mjClass 3 collects everything else (mj12 < 500 or no mj12 branch).
+//   14 bins x 4 classes = 56 cells -> one 64-bit mask.
+// - Cluster Index:
+//   For every cluster of an input file, the mask of cells that occur in
+//   it. Built once from the scalar branches only (no weights) and stored
+//   in a sidecar "<input>.cellidx" keyed by the file UUID.
+//   (buildClusterIndex / getClusterIndex live in pdf_event_loop.h)
+// - Restricted Run (--bins / --mj):
+//   Clusters whose index mask misses the requested cells are not read at
+//   all; inside the remaining clusters, events outside the requested
+//   cells are dropped before their weights are read.
+//
+// The index ignores the --cut, so it is a superset and stays valid for
+// any selection.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_REGION_H
+#define PDF_REGION_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+
+#include "RtypesCore.h"
+
+// --- Cell Key ---
+const int kMjClasses = 4;
+
+// Helper: Mj class of the cell key (same edges as getMjBinIndex)
+inline int cellMjClass(float mj12) {
+    if (mj12 >= 500 && mj12 < 800) return 0;
+    if (mj12 >= 800 && mj12 < 1100) return 1;
+    if (mj12 >= 1100) return 2;
+    return kMjClasses - 1;
+}
+
+inline int cellKey(int bIdx, int mjClass) {
+    return bIdx * kMjClasses + mjClass;
+}
+
+inline uint64_t cellBit(int bIdx, int mjClass) {
+    return uint64_t(1) << cellKey(bIdx, mjClass);
+}
+
+// --- Cluster Index ---
+struct ClusterIndex {
+    std::vector<Long64_t> starts;  // first entry of each cluster
+    std::vector<uint64_t> masks;   // cells occurring in the cluster
+
+    // Mask of the cluster starting at entry 'start' (all cells if unknown)
+    uint64_t Lookup(Long64_t start) const {
+        auto it = std::lower_bound(starts.begin(), starts.end(), start);
+        if (it == starts.end() || *it != start) return ~uint64_t(0);
+        return masks[it - starts.begin()];
+    }
+};
+
+inline std::string clusterIndexPath(const std::string& filename) {
+    return filename + ".cellidx";
+}
+
+// Helper: Load a sidecar index; false if missing, stale or unreadable
+// (the caller then rebuilds it)
+inline bool loadClusterIndex(const std::string& path, const std::string& uuid,
+                             Long64_t nentries, ClusterIndex& index) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::string magic, key_uuid, key_entries, file_uuid;
+    int version = 0;
+    Long64_t file_entries = -1;
+    in >> magic >> version >> key_uuid >> file_uuid >> key_entries >> file_entries;
+    if (magic != "pdfw-cellidx" || version != 1 || file_uuid != uuid || file_entries != nentries)
+        return false;
+
+    index = ClusterIndex();
+    Long64_t start, end;
+    std::string hex;
+    while (in >> start >> end >> hex) {
+        char* hex_end = nullptr;
+        errno = 0;
+        unsigned long long mask = std::strtoull(hex.c_str(), &hex_end, 16);
+        if (errno || hex_end == hex.c_str() || *hex_end) return false;
+        index.starts.push_back(start);
+        index.masks.push_back(mask);
+    }
+    if (!in.eof()) return false; // a line that is not "start end mask"
+    return !index.starts.empty() || nentries == 0;
+}
+
+inline bool saveClusterIndex(const std::string& path, const std::string& uuid,
+                             Long64_t nentries, const ClusterIndex& index) {
+    std::ofstream out(path);
+    if (!out) return false;
+    out << "pdfw-cellidx 1\n" << "uuid " << uuid << " entries " << nentries << "\n";
+    for (size_t c = 0; c < index.starts.size(); ++c) {
+        Long64_t end = (c + 1 < index.starts.size()) ? index.starts[c + 1] : nentries;
+        out << index.starts[c] << " " << end << " " << std::hex << index.masks[c] << std::dec << "\n";
+    }
+    return (bool)out;
+}
+
+// Helper: Split a comma separated list ("35,36" or "1100+,800-1100")
+inline std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// --- Region Filter ---
+struct RegionFilter {
+    uint64_t wanted = ~uint64_t(0);  // requested cells
+    const ClusterIndex* index = nullptr;
+
+    bool Active() const { return wanted != ~uint64_t(0); }
+    bool WantCluster(Long64_t start) const {
+        return !Active() || !index || (index->Lookup(start) & wanted) != 0;
+    }
+    bool WantCell(int bIdx, int mjClass) const {
+        return (wanted & cellBit(bIdx, mjClass)) != 0;
+    }
+    bool WantBin(int bIdx) const {
+        uint64_t all = 0;
+        for (int m = 0; m < kMjClasses; ++m) all |= cellBit(bIdx, m);
+        return (wanted & all) != 0;
+    }
+};
+
+#endif // PDF_REGION_H
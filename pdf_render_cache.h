@@ -0,0 +1,85 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Render Skipping for Unchanged Plots
+// File: pdf_render_cache.h
+//
+// [Idea]
+// - The render stage hashes everything the picture depends on (envelope
+//   and replica arrays, style settings, notes, ROOT version) into a
+//   64-bit FNV-1a RenderHash.
+// - The hash of the last render is kept in <base>.renderhash next to the
+//   outputs. If it matches and all outputs still exist, drawing and
+//   SaveAs are skipped.
+// - The stamp is written only after every output was saved, so an
+//   interrupted render is redone.
+// - Arrays are hashed bit for bit: any change of a sum re-renders.
+//
+// ROOT-free.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_RENDER_CACHE_H
+#define PDF_RENDER_CACHE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+class RenderHash {
+public:
+    void Add(const void* data, size_t bytes) {
+        const unsigned char* p = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; ++i) {
+            h_ ^= p[i];
+            h_ *= 1099511628211ULL; // FNV-1a prime
+        }
+    }
+    void Add(const std::vector<double>& v) {
+        Add((uint64_t)v.size());
+        Add(v.data(), v.size() * sizeof(double));
+    }
+    void Add(const std::string& s) {
+        Add((uint64_t)s.size());
+        Add(s.data(), s.size());
+    }
+    void Add(uint64_t v) { Add(&v, sizeof(v)); }
+    void Add(int v) { Add((uint64_t)(int64_t)v); }
+    void Add(double v) { Add(&v, sizeof(v)); }
+
+    std::string Hex() const {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h_);
+        return buf;
+    }
+
+private:
+    uint64_t h_ = 14695981039346656037ULL; // FNV-1a offset basis
+};
+
+inline std::string renderStampFile(const std::string& base) { return base + ".renderhash"; }
+
+// True if the stamp of 'base' holds 'hash' and every output exists
+inline bool renderUpToDate(const std::string& base, const std::vector<std::string>& outputs,
+                           const std::string& hash) {
+    std::ifstream in(renderStampFile(base));
+    std::string stored;
+    if (!(in >> stored) || stored != hash) return false;
+    for (const auto& out : outputs) {
+        if (!std::ifstream(out)) return false;
+    }
+    return true;
+}
+
+// Call after all outputs were saved; false if an output is missing
+inline bool saveRenderStamp(const std::string& base, const std::vector<std::string>& outputs,
+                            const std::string& hash) {
+    for (const auto& out : outputs) {
+        if (!std::ifstream(out)) return false;
+    }
+    std::ofstream stamp(renderStampFile(base));
+    stamp << hash << "\n";
+    return (bool)stamp;
+}
+
+#endif // PDF_RENDER_CACHE_H
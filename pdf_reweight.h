@@ -0,0 +1,207 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - On-the-fly PDF Reweighting from Parton Kinematics
+// File: pdf_reweight.h
+//
+// [Purpose]
+// - For ntuples without a 'weight' vector for the wanted PDF set: the
+//   replica weights are computed per event from the stored parton
+//   kinematics (x1, x2, Q, flavours) with a locally installed LHAPDF set.
+//     w[k] = base * f_k(id1, x1, Q) * f_k(id2, x2, Q)
+//                 / (f_0(id1, x1, Q) * f_0(id2, x2, Q))
+//   k = member index (0 = central member, so w[0] = base), i.e. the same
+//   layout as the stored 'weight' vector, feeding the same accumulators.
+//
+// [Grid Cache]
+// - The member ratios r_k = f_k / f_0 of ALL members are evaluated once per
+//   cache node, a point of a regular (ln x, ln Q^2) grid
+//   (kPdfCacheStepLnX, kPdfCacheStepLnQ2), and kept per flavour. Events
+//   are interpolated bilinearly between the 4 surrounding nodes, so LHAPDF
+//   is only called when a new node is hit. The ratios are much smoother
+//   than xf itself, and w[k] = base * r_k(x1) * r_k(x2) needs nothing else.
+// - The member values of a node are contiguous, so the interpolation of
+//   all members is one flat loop the compiler vectorizes.
+// - Points outside the set's Q range, x > kPdfCacheMaxX (valence tail,
+//   where f_0 -> 0) and unusual flavours go straight to LHAPDF (no cache).
+//
+// Optional: only compiled with -DPDFW_WITH_LHAPDF, e.g.
+//   $(lhapdf-config --cflags --ldflags)
+// Without it PdfReweighter::Setup() fails with a message.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_REWEIGHT_H
+#define PDF_REWEIGHT_H
+
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+
+#ifdef PDFW_WITH_LHAPDF
+#include "LHAPDF/LHAPDF.h"
+#endif
+
+// Default kinematics branches: x1, x2, Q [GeV], id1, id2 (PDG, 21 = gluon)
+const char* const kPdfKinematicsDefault = "pdf_x1,pdf_x2,pdf_q,pdf_id1,pdf_id2";
+
+const double kPdfCacheStepLnX  = 1.0 / 64; // cache node spacing in ln(x)
+const double kPdfCacheStepLnQ2 = 1.0 / 16; // cache node spacing in ln(Q^2)
+const double kPdfCacheMaxX     = 0.5;      // above: direct evaluation
+
+#ifdef PDFW_WITH_LHAPDF
+
+class PdfReweighter {
+public:
+    PdfReweighter() {}
+    PdfReweighter(const PdfReweighter&) = delete;
+    PdfReweighter& operator=(const PdfReweighter&) = delete;
+    ~PdfReweighter() { for (auto* pdf : pdfs_) delete pdf; }
+
+    // Load members 0 .. nMembers-1 of the set
+    bool Setup(const std::string& setName, int nMembers, std::string& error) {
+        LHAPDF::setVerbosity(0);
+        try {
+            LHAPDF::PDFSet set(setName);
+            if ((int)set.size() < nMembers) {
+                error = setName + " has " + std::to_string(set.size()) + " members, " +
+                        std::to_string(nMembers) + " needed";
+                return false;
+            }
+            for (int k = 0; k < nMembers; ++k) pdfs_.push_back(set.mkPDF(k));
+        } catch (const std::exception& e) {
+            error = std::string("cannot load PDF set ") + setName + ": " + e.what();
+            return false;
+        }
+        nMembers_ = nMembers;
+        lnXMin_  = std::log(pdfs_[0]->xMin());
+        lnXMax_  = std::log(std::min(pdfs_[0]->xMax(), kPdfCacheMaxX));
+        lnQ2Min_ = std::log(pdfs_[0]->q2Min());
+        lnQ2Max_ = std::log(pdfs_[0]->q2Max());
+        r1_.assign(nMembers, 0.0);
+        r2_.assign(nMembers, 0.0);
+        return true;
+    }
+
+    int NMembers() const { return nMembers_; }
+
+    // w[k] = base * ratio of member k to the central member, k < NMembers()
+    template <typename T>
+    void Weights(double x1, double x2, double q, int id1, int id2, double base, T* w) {
+        double q2 = q * q;
+        ratios(id1, x1, q2, r1_.data());
+        ratios(id2, x2, q2, r2_.data());
+        for (int k = 0; k < nMembers_; ++k) w[k] = (T)(base * r1_[k] * r2_[k]);
+    }
+
+    // --- Statistics ---
+    size_t CacheNodes() const { return nodes_.size(); }
+    long long Lookups() const { return nLookups_; }
+    long long Misses() const { return nMisses_; }
+    long long Direct() const { return nDirect_; }
+    long long Invalid() const { return nInvalid_; }
+
+private:
+    // Cache slot of a flavour: -6..6 -> 0..12 (0 = gluon), photon -> 13
+    static int flavourSlot(int id) {
+        if (id == 21) id = 0;
+        if (id >= -6 && id <= 6) return id + 6;
+        if (id == 22) return 13;
+        return -1;
+    }
+
+    // f_k / f_0 at (id, x, Q^2) for all members into r[nMembers]
+    void ratios(int id, double x, double q2, double* r) {
+        int slot = flavourSlot(id);
+        double lnx = std::log(x), lnq2 = std::log(q2);
+        if (slot < 0 || !(lnx >= lnXMin_ && lnx <= lnXMax_ && lnq2 >= lnQ2Min_ && lnq2 <= lnQ2Max_)) {
+            ++nDirect_;
+            exactRatios(id, x, q2, r);
+            return;
+        }
+
+        double ux = (lnx - lnXMin_) / kPdfCacheStepLnX;
+        double uq = (lnq2 - lnQ2Min_) / kPdfCacheStepLnQ2;
+        uint32_t ix = (uint32_t)ux, iq = (uint32_t)uq;
+        double tx = ux - ix, tq = uq - iq;
+
+        // Node offsets first: adding a node may reallocate values_
+        size_t o00 = node(slot, ix, iq),     o10 = node(slot, ix + 1, iq);
+        size_t o01 = node(slot, ix, iq + 1), o11 = node(slot, ix + 1, iq + 1);
+        const double* a = &values_[o00];
+        const double* b = &values_[o10];
+        const double* c = &values_[o01];
+        const double* d = &values_[o11];
+
+        double w00 = (1 - tx) * (1 - tq), w10 = tx * (1 - tq);
+        double w01 = (1 - tx) * tq,       w11 = tx * tq;
+        for (int k = 0; k < nMembers_; ++k)
+            r[k] = w00 * a[k] + w10 * b[k] + w01 * c[k] + w11 * d[k];
+    }
+
+    // Ratios straight from LHAPDF; 1 where the central member vanishes
+    void exactRatios(int id, double x, double q2, double* r) {
+        double central = pdfs_[0]->xfxQ2(id, x, q2);
+        if (central == 0 || !std::isfinite(central)) {
+            ++nInvalid_;
+            for (int k = 0; k < nMembers_; ++k) r[k] = 1.0;
+            return;
+        }
+        r[0] = 1.0;
+        for (int k = 1; k < nMembers_; ++k) r[k] = pdfs_[k]->xfxQ2(id, x, q2) / central;
+    }
+
+    // Offset of the member ratios of a cache node, evaluated on first use
+    size_t node(int slot, uint32_t ix, uint32_t iq) {
+        ++nLookups_;
+        uint64_t key = ((uint64_t)slot << 56) | ((uint64_t)ix << 28) | iq;
+        auto it = nodes_.find(key);
+        if (it != nodes_.end()) return it->second;
+
+        ++nMisses_;
+        // Nodes past the upper edge are evaluated at the edge
+        double x  = std::exp(std::min(lnXMin_ + ix * kPdfCacheStepLnX, lnXMax_));
+        double q2 = std::exp(std::min(lnQ2Min_ + iq * kPdfCacheStepLnQ2, lnQ2Max_));
+        int id = (slot == 13) ? 22 : (slot == 6 ? 21 : slot - 6);
+
+        size_t offset = values_.size();
+        values_.resize(offset + nMembers_);
+        exactRatios(id, x, q2, &values_[offset]);
+        nodes_.emplace(key, offset);
+        return offset;
+    }
+
+    std::vector<LHAPDF::PDF*> pdfs_;
+    int nMembers_ = 0;
+    double lnXMin_ = 0, lnXMax_ = 0, lnQ2Min_ = 0, lnQ2Max_ = 0;
+
+    std::unordered_map<uint64_t, size_t> nodes_; // node key -> offset in values_
+    std::vector<double> values_;                 // [node][member] ratios
+    std::vector<double> r1_, r2_;
+
+    long long nLookups_ = 0, nMisses_ = 0, nDirect_ = 0, nInvalid_ = 0;
+};
+
+#else // !PDFW_WITH_LHAPDF
+
+// Placeholder so the tools build without LHAPDF; --pdf-set reports the missing support
+class PdfReweighter {
+public:
+    bool Setup(const std::string&, int, std::string& error) {
+        error = "built without LHAPDF support (compile with -DPDFW_WITH_LHAPDF $(lhapdf-config --cflags --ldflags))";
+        return false;
+    }
+    int NMembers() const { return 0; }
+    template <typename T>
+    void Weights(double, double, double, int, int, double, T*) {}
+    size_t CacheNodes() const { return 0; }
+    long long Lookups() const { return 0; }
+    long long Misses() const { return 0; }
+    long long Direct() const { return 0; }
+    long long Invalid() const { return 0; }
+};
+
+#endif // PDFW_WITH_LHAPDF
+
+#endif // PDF_REWEIGHT_H
@@ -0,0 +1,284 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Compiled Selection Expressions
+// File: pdf_selection.h
+//
+// [Logic]
+// 1. Compile:
+//    - Parse a cut string over scalar branches, e.g.
+//      "nleps == 1 && (njets >= 4 || mj12 > 500) && !(nbm < 0)"
+//    - Supported: == != < <= > >=, && || !, parentheses, numeric
+//      literals and bare branch names (meaning "!= 0").
+//    - The expression is turned into a small postfix program.
+// 2. Evaluate (Block-wise):
+//    - Input: one float column per variable, holding a block of events.
+//    - Each instruction is a tight loop over the whole block producing a
+//      0/1 byte mask, so the compiler can vectorize it.
+//    - Result: pass mask for the block (mask[row] == 1 -> event passes).
+//
+// Integer branches are held as float in the columns; this is exact for
+// |value| < 2^24, far beyond any multiplicity used in the cuts.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_SELECTION_H
+#define PDF_SELECTION_H
+
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cctype>
+
+class Selection {
+public:
+    // Compile an expression. An empty (or blank) expression passes everything.
+    bool Compile(const std::string& expr, std::string& error) {
+        text_ = expr;
+        pos_ = 0;
+        ops_.clear();
+        vars_.clear();
+        error_.clear();
+        depth_ = 0;
+        maxDepth_ = 0;
+
+        skipSpace();
+        if (pos_ < text_.size()) {
+            parseOr();
+            skipSpace();
+            if (error_.empty() && pos_ < text_.size())
+                fail("unexpected '" + text_.substr(pos_) + "'");
+        }
+        error = error_;
+        if (!error_.empty()) ops_.clear();
+        return error_.empty();
+    }
+
+    // Variables referenced by the expression (in order of appearance)
+    const std::vector<std::string>& Variables() const { return vars_; }
+
+    // Map the variables onto column indices of the block passed to Evaluate().
+    bool Bind(const std::vector<std::string>& columnNames, std::string& error) {
+        bound_.assign(vars_.size(), -1);
+        for (size_t v = 0; v < vars_.size(); ++v) {
+            for (size_t c = 0; c < columnNames.size(); ++c) {
+                if (columnNames[c] == vars_[v]) { bound_[v] = (int)c; break; }
+            }
+            if (bound_[v] < 0) {
+                error = "no column for variable '" + vars_[v] + "'";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool IsTrivial() const { return ops_.empty(); }
+    const std::string& Text() const { return text_; }
+
+    // Evaluate the program on rows [0, n) of the bound columns.
+    // Not const: it writes the scratch masks, so a Selection must not be
+    // shared between threads (each worker evaluates its own copy).
+    void Evaluate(const std::vector<std::vector<float>>& columns, int n,
+                  std::vector<unsigned char>& mask) {
+        mask.resize(n);
+        if (ops_.empty()) {
+            for (int i = 0; i < n; ++i) mask[i] = 1;
+            return;
+        }
+
+        if ((int)stack_.size() < maxDepth_) stack_.resize(maxDepth_);
+        for (auto& s : stack_) if ((int)s.size() < n) s.resize(n);
+
+        int top = 0;
+        for (const Op& op : ops_) {
+            switch (op.kind) {
+            case kCmpConst: {
+                unsigned char* m = stack_[top++].data();
+                compareConst(columns[bound_[op.a]].data(), op.cmp, op.c, m, n);
+                break;
+            }
+            case kCmpVar: {
+                unsigned char* m = stack_[top++].data();
+                compareVar(columns[bound_[op.a]].data(), op.cmp, columns[bound_[op.b]].data(), m, n);
+                break;
+            }
+            case kAnd: {
+                --top;
+                unsigned char* a = stack_[top - 1].data();
+                const unsigned char* b = stack_[top].data();
+                for (int i = 0; i < n; ++i) a[i] &= b[i];
+                break;
+            }
+            case kOr: {
+                --top;
+                unsigned char* a = stack_[top - 1].data();
+                const unsigned char* b = stack_[top].data();
+                for (int i = 0; i < n; ++i) a[i] |= b[i];
+                break;
+            }
+            case kNot: {
+                unsigned char* a = stack_[top - 1].data();
+                for (int i = 0; i < n; ++i) a[i] ^= 1;
+                break;
+            }
+            }
+        }
+        const unsigned char* r = stack_[0].data();
+        for (int i = 0; i < n; ++i) mask[i] = r[i];
+    }
+
+private:
+    enum Cmp { kEq, kNe, kLt, kLe, kGt, kGe };
+    enum Kind { kCmpConst, kCmpVar, kAnd, kOr, kNot };
+    struct Op { Kind kind; Cmp cmp; int a; int b; float c; };
+
+    // One operand of a comparison: a variable or a literal
+    struct Operand { bool isVar; int var; float value; };
+
+    // --- Block Kernels ---
+    static void compareConst(const float* x, Cmp cmp, float c, unsigned char* m, int n) {
+        switch (cmp) {
+        case kEq: for (int i = 0; i < n; ++i) m[i] = x[i] == c; break;
+        case kNe: for (int i = 0; i < n; ++i) m[i] = x[i] != c; break;
+        case kLt: for (int i = 0; i < n; ++i) m[i] = x[i] <  c; break;
+        case kLe: for (int i = 0; i < n; ++i) m[i] = x[i] <= c; break;
+        case kGt: for (int i = 0; i < n; ++i) m[i] = x[i] >  c; break;
+        case kGe: for (int i = 0; i < n; ++i) m[i] = x[i] >= c; break;
+        }
+    }
+
+    static void compareVar(const float* x, Cmp cmp, const float* y, unsigned char* m, int n) {
+        switch (cmp) {
+        case kEq: for (int i = 0; i < n; ++i) m[i] = x[i] == y[i]; break;
+        case kNe: for (int i = 0; i < n; ++i) m[i] = x[i] != y[i]; break;
+        case kLt: for (int i = 0; i < n; ++i) m[i] = x[i] <  y[i]; break;
+        case kLe: for (int i = 0; i < n; ++i) m[i] = x[i] <= y[i]; break;
+        case kGt: for (int i = 0; i < n; ++i) m[i] = x[i] >  y[i]; break;
+        case kGe: for (int i = 0; i < n; ++i) m[i] = x[i] >= y[i]; break;
+        }
+    }
+
+    // --- Parser (recursive descent, emits postfix) ---
+    void fail(const std::string& msg) {
+        if (error_.empty()) error_ = msg + " (at position " + std::to_string(pos_) + ")";
+    }
+
+    void skipSpace() {
+        while (pos_ < text_.size() && std::isspace((unsigned char)text_[pos_])) ++pos_;
+    }
+
+    bool accept(const char* tok) {
+        skipSpace();
+        size_t len = std::char_traits<char>::length(tok);
+        if (text_.compare(pos_, len, tok) == 0) { pos_ += len; return true; }
+        return false;
+    }
+
+    void emit(Kind kind, Cmp cmp = kEq, int a = -1, int b = -1, float c = 0.f) {
+        ops_.push_back({kind, cmp, a, b, c});
+        if (kind == kCmpConst || kind == kCmpVar) ++depth_;
+        if (kind == kAnd || kind == kOr) --depth_;
+        if (depth_ > maxDepth_) maxDepth_ = depth_;
+    }
+
+    int varIndex(const std::string& name) {
+        for (size_t v = 0; v < vars_.size(); ++v) if (vars_[v] == name) return (int)v;
+        vars_.push_back(name);
+        return (int)vars_.size() - 1;
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (error_.empty() && accept("||")) { parseAnd(); emit(kOr); }
+    }
+
+    void parseAnd() {
+        parseUnary();
+        while (error_.empty() && accept("&&")) { parseUnary(); emit(kAnd); }
+    }
+
+    void parseUnary() {
+        if (!error_.empty()) return;
+        skipSpace();
+        if (pos_ < text_.size() && text_[pos_] == '!' && text_.compare(pos_, 2, "!=") != 0) {
+            ++pos_;
+            parseUnary();
+            emit(kNot);
+            return;
+        }
+        if (accept("(")) {
+            parseOr();
+            if (!accept(")")) fail("missing ')'");
+            return;
+        }
+        parseComparison();
+    }
+
+    void parseComparison() {
+        Operand lhs = parseOperand();
+        if (!error_.empty()) return;
+
+        Cmp cmp;
+        if      (accept("==")) cmp = kEq;
+        else if (accept("!=")) cmp = kNe;
+        else if (accept("<=")) cmp = kLe;
+        else if (accept(">=")) cmp = kGe;
+        else if (accept("<"))  cmp = kLt;
+        else if (accept(">"))  cmp = kGt;
+        else {
+            // Bare branch name: true if non-zero
+            if (!lhs.isVar) { fail("literal used as a condition"); return; }
+            emit(kCmpConst, kNe, lhs.var, -1, 0.f);
+            return;
+        }
+
+        Operand rhs = parseOperand();
+        if (!error_.empty()) return;
+
+        if (lhs.isVar && rhs.isVar) {
+            emit(kCmpVar, cmp, lhs.var, rhs.var);
+        } else if (lhs.isVar) {
+            emit(kCmpConst, cmp, lhs.var, -1, rhs.value);
+        } else if (rhs.isVar) {
+            // Literal on the left: mirror the comparison
+            Cmp mirrored = cmp;
+            if (cmp == kLt) mirrored = kGt; else if (cmp == kGt) mirrored = kLt;
+            else if (cmp == kLe) mirrored = kGe; else if (cmp == kGe) mirrored = kLe;
+            emit(kCmpConst, mirrored, rhs.var, -1, lhs.value);
+        } else {
+            fail("comparison needs at least one branch");
+        }
+    }
+
+    Operand parseOperand() {
+        skipSpace();
+        Operand op{false, -1, 0.f};
+        if (pos_ >= text_.size()) { fail("unexpected end of expression"); return op; }
+
+        char ch = text_[pos_];
+        if (std::isalpha((unsigned char)ch) || ch == '_') {
+            size_t start = pos_;
+            while (pos_ < text_.size() && (std::isalnum((unsigned char)text_[pos_]) || text_[pos_] == '_')) ++pos_;
+            op.isVar = true;
+            op.var = varIndex(text_.substr(start, pos_ - start));
+            return op;
+        }
+
+        const char* begin = text_.c_str() + pos_;
+        char* end = nullptr;
+        double value = std::strtod(begin, &end);
+        if (end == begin) { fail("expected a branch name or number"); return op; }
+        pos_ += end - begin;
+        op.value = (float)value;
+        return op;
+    }
+
+    std::string text_;
+    size_t pos_ = 0;
+    std::string error_;
+    std::vector<Op> ops_;
+    std::vector<std::string> vars_;
+    std::vector<int> bound_;
+    int depth_ = 0;
+    int maxDepth_ = 0;
+    std::vector<std::vector<unsigned char>> stack_; // scratch masks (see Evaluate)
+};
+
+#endif // PDF_SELECTION_H
@@ -0,0 +1,791 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Bin-Partitioned Skim Format
+// File: pdf_skim.h
+//
+// [Layout] (native little-endian, one file)
+//   Header (64 bytes)
+//     magic "PDFWSKIM", version, nCells, nReplicas, flags, nEvents,
+//     offsets of the cell table, the replica id table and the cut string
+//   Cell Table : nCells x { offset, nEvents, bytes }
+//   Replica Ids: nReplicas x uint16 (index in the original 'weight' vector)
+//   Cut String : uint32 length + characters (selection used for the skim)
+//   Cell Groups: one per cell, 4096-byte aligned, in cell order
+//     float   mj12[n]
+//     int32   njets[n]
+//     int32   nbm[n]
+//     (pad to 64 bytes)
+//     float   weights[n][nReplicas]   <- contiguous for the whole cell
+//
+// [Codec] (header flags)
+//   float   : weights stored as above (default)
+//   ratio16 : replica weights are nearly proportional to the nominal, so
+//             the weights block is replaced by
+//               float    nominal[n]                 <- weight 0
+//               (pad to 64 bytes)
+//               uint16   ratios[n][nReplicas - 1]   <- weights 1 ~ nReplicas-1
+//             weight_k = nominal * (ratioMin + q_k * ratioStep), with
+//             ratioMin / ratioStep from the header (range of all ratios in
+//             the file). 4 + 2 (nReplicas - 1) instead of 4 nReplicas bytes
+//             per event (~2x smaller for 101 weights); the ratio error is
+//             at most ratioStep / 2. One range covers the whole file, so a
+//             single outlier ratio coarsens every weight: files where
+//             ratioStep / 2 would exceed kSkimRatioMaxError, or with events
+//             that cannot be encoded (nominal 0 next to non-zero replicas,
+//             non-finite weights), are written as float instead.
+//             ratio16 saves space, not time: its decoding kernel is slower
+//             than the float-block sum of a float cell (bench_pdf_accumulate.cpp).
+//
+// [Cells]
+//   Same key as pdf_region.h: cell = bIdx * 4 + mjClass
+//   (14 physical bins x {500-800, 800-1100, 1100+, other}).
+//
+// [Access]
+//   - SkimReader maps the file read-only; Cell(c) is a zero-copy view.
+//   - ReadCell(c, buffer) fetches one cell with a single sequential pread,
+//     for per-cell recomputation (exact percentiles, bootstrap, ...).
+//   - SkimCell::Decode(e, out) gives the weights of one event in either
+//     codec; accumulateSkimCell() decodes ratio16 cells on the fly.
+//   - streamSkimCells() (pdf_skim_io.h) reads the cells with deep queues of
+//     large aligned reads (io_uring / pread) instead of page faults.
+//
+// [Writing]
+//   SkimWriter spools each cell to two side files (scalars, weights) while
+//   the event loop runs, then concatenates them into the final layout, so
+//   memory stays bounded by one cell's scalars.
+//
+// ROOT-free: usable from the tools, the C API and small utilities.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_SKIM_H
+#define PDF_SKIM_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pdf_selection.h"
+
+// --- Format Definition ---
+const char     kSkimMagic[8]   = {'P', 'D', 'F', 'W', 'S', 'K', 'I', 'M'};
+const uint32_t kSkimVersion    = 1;
+const uint64_t kSkimAlign      = 4096; // cell group alignment
+const uint64_t kSkimColAlign   = 64;   // weights block alignment inside a group
+const int      kSkimBlockSize  = 1024; // rows per selection block on replay
+
+// Weight codec, stored in the header flags
+const uint32_t kSkimCodecFloat   = 0;
+const uint32_t kSkimCodecRatio16 = 1;
+const uint32_t kSkimCodecMask    = 1;
+
+// ratio16: largest ratio error (ratioStep / 2) accepted before falling back
+// to float; a ratio range of ~2.6 (e.g. 0.4 ~ 3.0) still fits
+const double kSkimRatioMaxError = 2.0e-5;
+
+inline const char* skimCodecName(uint32_t codec) {
+    return codec == kSkimCodecRatio16 ? "ratio16" : "float";
+}
+
+inline bool parseSkimCodec(const std::string& name, uint32_t& codec) {
+    if (name == "float") codec = kSkimCodecFloat;
+    else if (name == "ratio16") codec = kSkimCodecRatio16;
+    else return false;
+    return true;
+}
+
+struct SkimHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t nCells;
+    uint32_t nReplicas;
+    uint32_t flags;
+    uint64_t nEvents;
+    uint64_t cellTableOffset;
+    uint64_t replicaIdOffset;
+    uint64_t cutOffset;
+    float    ratioMin;  // ratio16 codec only
+    float    ratioStep;
+};
+static_assert(sizeof(SkimHeader) == 64, "SkimHeader must stay 64 bytes");
+
+struct SkimCellEntry {
+    uint64_t offset;  // start of the cell group in the file
+    uint64_t nEvents;
+    uint64_t bytes;   // size of the group (without alignment padding)
+};
+
+inline uint64_t skimAlignUp(uint64_t v, uint64_t a) { return (v + a - 1) / a * a; }
+
+// Helper: Offsets of the columns inside a cell group of n events
+// (ratio16: 'weights' is the nominal column, 'ratios' the uint16 block)
+struct SkimCellLayout {
+    uint64_t mj12, njets, nbm, weights, ratios, bytes;
+};
+
+inline SkimCellLayout skimCellLayout(uint64_t n, uint32_t nReplicas, uint32_t codec = kSkimCodecFloat) {
+    SkimCellLayout l;
+    l.mj12    = 0;
+    l.njets   = l.mj12 + 4 * n;
+    l.nbm     = l.njets + 4 * n;
+    l.weights = skimAlignUp(l.nbm + 4 * n, kSkimColAlign);
+    if (codec == kSkimCodecRatio16) {
+        l.ratios = skimAlignUp(l.weights + 4 * n, kSkimColAlign);
+        l.bytes  = l.ratios + 2 * n * (uint64_t)(nReplicas - 1);
+    } else {
+        l.ratios = l.weights;
+        l.bytes  = l.weights + 4 * n * (uint64_t)nReplicas;
+    }
+    return l;
+}
+
+inline bool isSkimFile(const std::string& filename) {
+    const std::string ext = ".pdfskim";
+    return filename.size() >= ext.size() &&
+           filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// --- Cell View ---
+struct SkimCell {
+    uint64_t n = 0;
+    uint32_t nReplicas = 0;
+    uint32_t codec = kSkimCodecFloat;
+    const float*   mj12 = nullptr;
+    const int32_t* njets = nullptr;
+    const int32_t* nbm = nullptr;
+    const float*   weights = nullptr; // float: weights[e * nReplicas + k]; ratio16: nominal[e]
+    const uint16_t* ratios = nullptr; // ratio16: ratios[e * (nReplicas - 1) + k - 1]
+    float ratioMin = 0.f, ratioStep = 0.f;
+
+    // float codec only
+    const float* Weights(uint64_t e) const { return weights + e * nReplicas; }
+
+    // Weights of event e in either codec -> out[0..nReplicas)
+    void Decode(uint64_t e, float* out) const {
+        if (codec != kSkimCodecRatio16) {
+            std::memcpy(out, Weights(e), nReplicas * sizeof(float));
+            return;
+        }
+        const float nom = weights[e];
+        const uint16_t* q = ratios + e * (nReplicas - 1);
+        out[0] = nom;
+        for (uint32_t k = 1; k < nReplicas; ++k) out[k] = nom * (ratioMin + q[k - 1] * ratioStep);
+    }
+
+    // Sub-view of events [first, first + count)
+    SkimCell Events(uint64_t first, uint64_t count) const {
+        SkimCell sub = *this;
+        sub.n = count;
+        sub.mj12 += first;
+        sub.njets += first;
+        sub.nbm += first;
+        if (codec == kSkimCodecRatio16) {
+            sub.weights += first;
+            sub.ratios += first * (nReplicas - 1);
+        } else {
+            sub.weights += first * nReplicas;
+        }
+        return sub;
+    }
+};
+
+// Helper: Build a view over a cell group that starts at 'base'
+inline SkimCell skimCellView(const char* base, uint64_t n, const SkimHeader& h) {
+    const uint32_t codec = h.flags & kSkimCodecMask;
+    SkimCellLayout l = skimCellLayout(n, h.nReplicas, codec);
+    SkimCell cell;
+    cell.n = n;
+    cell.nReplicas = h.nReplicas;
+    cell.codec = codec;
+    cell.mj12    = reinterpret_cast<const float*>(base + l.mj12);
+    cell.njets   = reinterpret_cast<const int32_t*>(base + l.njets);
+    cell.nbm     = reinterpret_cast<const int32_t*>(base + l.nbm);
+    cell.weights = reinterpret_cast<const float*>(base + l.weights);
+    if (codec == kSkimCodecRatio16) {
+        cell.ratios    = reinterpret_cast<const uint16_t*>(base + l.ratios);
+        cell.ratioMin  = h.ratioMin;
+        cell.ratioStep = h.ratioStep;
+    }
+    return cell;
+}
+
+// --- Reader ---
+class SkimReader {
+public:
+    SkimReader() {}
+    SkimReader(const SkimReader&) = delete;
+    SkimReader& operator=(const SkimReader&) = delete;
+    ~SkimReader() { Close(); }
+
+    bool Open(const std::string& path, std::string& error) {
+        Close();
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) { error = "cannot open " + path; return false; }
+
+        struct stat st;
+        if (fstat(fd_, &st) != 0 || (uint64_t)st.st_size < sizeof(SkimHeader)) {
+            error = path + " is too small to be a skim";
+            Close();
+            return false;
+        }
+        size_ = (uint64_t)st.st_size;
+
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        if (p == MAP_FAILED) { error = "cannot map " + path; Close(); return false; }
+        base_ = static_cast<const char*>(p);
+
+        std::memcpy(&header_, base_, sizeof(header_));
+        if (std::memcmp(header_.magic, kSkimMagic, 8) != 0 || header_.version != kSkimVersion) {
+            error = path + " is not a version " + std::to_string(kSkimVersion) + " skim";
+            Close();
+            return false;
+        }
+        if ((header_.flags & ~kSkimCodecMask) != 0 ||
+            (Codec() == kSkimCodecRatio16 && header_.nReplicas < 2)) {
+            error = path + " uses an unknown weight codec";
+            Close();
+            return false;
+        }
+
+        uint64_t tableEnd = header_.cellTableOffset + header_.nCells * sizeof(SkimCellEntry);
+        uint64_t idsEnd = header_.replicaIdOffset + header_.nReplicas * sizeof(uint16_t);
+        if (tableEnd > size_ || idsEnd > size_ || header_.cutOffset + 4 > size_) {
+            error = path + " has a truncated header";
+            Close();
+            return false;
+        }
+
+        cells_.resize(header_.nCells);
+        std::memcpy(cells_.data(), base_ + header_.cellTableOffset, header_.nCells * sizeof(SkimCellEntry));
+        for (const auto& c : cells_) {
+            if (c.offset + c.bytes > size_ ||
+                c.bytes != skimCellLayout(c.nEvents, header_.nReplicas, Codec()).bytes) {
+                error = path + " is truncated or corrupted (cell table out of range)";
+                Close();
+                return false;
+            }
+        }
+
+        replicaIds_.resize(header_.nReplicas);
+        std::memcpy(replicaIds_.data(), base_ + header_.replicaIdOffset, header_.nReplicas * sizeof(uint16_t));
+
+        uint32_t cutLen = 0;
+        std::memcpy(&cutLen, base_ + header_.cutOffset, 4);
+        if (header_.cutOffset + 4 + cutLen <= size_) cut_.assign(base_ + header_.cutOffset + 4, cutLen);
+        return true;
+    }
+
+    void Close() {
+        if (base_) munmap(const_cast<char*>(base_), size_);
+        if (fd_ >= 0) ::close(fd_);
+        base_ = nullptr;
+        fd_ = -1;
+        size_ = 0;
+        cells_.clear();
+    }
+
+    bool IsOpen() const { return base_ != nullptr; }
+    int NCells() const { return (int)header_.nCells; }
+    int NReplicas() const { return (int)header_.nReplicas; }
+    uint64_t NEvents() const { return header_.nEvents; }
+    uint32_t Codec() const { return header_.flags & kSkimCodecMask; }
+    const SkimHeader& Header() const { return header_; }
+    double RatioError() const { return Codec() == kSkimCodecRatio16 ? 0.5 * header_.ratioStep : 0.0; }
+    uint64_t CellEvents(int c) const { return cells_[c].nEvents; }
+    // Events in the cells of a wanted mask (the ones forEachSkimCell visits)
+    uint64_t WantedEvents(uint64_t wantedCells) const {
+        uint64_t n = 0;
+        for (int c = 0; c < NCells() && c < 64; ++c)
+            if (wantedCells & (uint64_t(1) << c)) n += cells_[c].nEvents;
+        return n;
+    }
+    const SkimCellEntry& CellEntry(int c) const { return cells_[c]; }
+    const std::vector<uint16_t>& ReplicaIds() const { return replicaIds_; }
+    const std::string& Cut() const { return cut_; }
+    int Fd() const { return fd_; }
+    const char* Data() const { return base_; }
+    uint64_t Size() const { return size_; }
+
+    // Zero-copy view into the mapped file
+    SkimCell Cell(int c) const {
+        return skimCellView(base_ + cells_[c].offset, cells_[c].nEvents, header_);
+    }
+
+    // One sequential read of a cell group into 'buffer'; the view points into it
+    bool ReadCell(int c, std::vector<char>& buffer, SkimCell& cell) const {
+        const SkimCellEntry& e = cells_[c];
+        buffer.resize(e.bytes);
+        uint64_t done = 0;
+        while (done < e.bytes) {
+            ssize_t r = pread(fd_, buffer.data() + done, e.bytes - done, e.offset + done);
+            if (r <= 0) return false;
+            done += (uint64_t)r;
+        }
+        cell = skimCellView(buffer.data(), e.nEvents, header_);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    const char* base_ = nullptr;
+    uint64_t size_ = 0;
+    SkimHeader header_ = {};
+    std::vector<SkimCellEntry> cells_;
+    std::vector<uint16_t> replicaIds_;
+    std::string cut_;
+};
+
+// --- Writer ---
+class SkimWriter {
+public:
+    SkimWriter() {}
+    SkimWriter(const SkimWriter&) = delete;
+    SkimWriter& operator=(const SkimWriter&) = delete;
+    ~SkimWriter() { removeSpools(); }
+
+    // nReplicas == 0: taken from the first event's weight count
+    bool Open(const std::string& path, int nCells, int nReplicas, const std::string& cut, std::string& error) {
+        path_ = path;
+        cut_ = cut;
+        nReplicas_ = nReplicas;
+        spoolError_ = false;
+        counts_.assign(nCells, 0);
+        scalars_.assign(nCells, nullptr);
+        weights_.assign(nCells, nullptr);
+        for (int c = 0; c < nCells; ++c) {
+            scalars_[c] = std::fopen(spoolName(c, 's').c_str(), "w+b");
+            weights_[c] = std::fopen(spoolName(c, 'w').c_str(), "w+b");
+            if (!scalars_[c] || !weights_[c]) {
+                error = "cannot create spool files next to " + path;
+                removeSpools();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int NReplicas() const { return nReplicas_; }
+    uint64_t Events() const { return nEvents_; }
+    uint64_t CellEvents(int c) const { return counts_[c]; }
+
+    // Weight codec of the file; after Close(), Codec() is the one written
+    // (ratio16 falls back to float with the reason in CodecNote())
+    void SetCodec(uint32_t codec) { codec_ = codec; }
+    uint32_t Codec() const { return codec_; }
+    const std::string& CodecNote() const { return codecNote_; }
+    double RatioError() const { return codec_ == kSkimCodecRatio16 ? 0.5 * ratioStep_ : 0.0; }
+
+    // Returns false (event not stored) if it has fewer weights than the skim
+    bool Add(int cell, float mj12, int njets, int nbm, const float* weights, int nWeights) {
+        if (nReplicas_ == 0) nReplicas_ = nWeights;
+        if (nWeights < nReplicas_) return false;
+
+        // A failed spool write (disk full, ...) is latched and fails Close()
+        SpoolScalars rec = {mj12, njets, nbm};
+        if (std::fwrite(&rec, sizeof(rec), 1, scalars_[cell]) != 1 ||
+            std::fwrite(weights, sizeof(float), nReplicas_, weights_[cell]) != (size_t)nReplicas_) {
+            spoolError_ = true;
+        }
+        ++counts_[cell];
+        ++nEvents_;
+        return true;
+    }
+
+    // Concatenate the spools into the final layout; replicaIds may be empty (identity).
+    // On any error no output file is left behind.
+    bool Close(std::string& error, const std::vector<uint16_t>& replicaIds = {}) {
+        const int nCells = (int)counts_.size();
+        // Buffered spool data fails at the latest here (rewind() would clear the error)
+        for (int c = 0; c < nCells && !spoolError_; ++c) {
+            if (std::fflush(scalars_[c]) != 0 || std::fflush(weights_[c]) != 0) spoolError_ = true;
+        }
+        if (spoolError_) {
+            error = "write error on the spool files of " + path_;
+            removeSpools();
+            return false;
+        }
+        FILE* out = std::fopen(path_.c_str(), "wb");
+        if (!out) { error = "cannot create " + path_; removeSpools(); return false; }
+        if (codec_ == kSkimCodecRatio16 && !ratioRange()) codec_ = kSkimCodecFloat;
+
+        SkimHeader h = {};
+        std::memcpy(h.magic, kSkimMagic, 8);
+        h.version = kSkimVersion;
+        h.nCells = nCells;
+        h.nReplicas = nReplicas_;
+        h.flags = codec_;
+        h.nEvents = nEvents_;
+        h.ratioMin = ratioMin_;
+        h.ratioStep = ratioStep_;
+        h.cellTableOffset = sizeof(SkimHeader);
+        h.replicaIdOffset = h.cellTableOffset + nCells * sizeof(SkimCellEntry);
+        h.cutOffset = h.replicaIdOffset + nReplicas_ * sizeof(uint16_t);
+
+        std::vector<uint16_t> ids = replicaIds;
+        if (ids.empty()) for (int k = 0; k < nReplicas_; ++k) ids.push_back((uint16_t)k);
+
+        std::vector<SkimCellEntry> table(nCells);
+        uint64_t offset = skimAlignUp(h.cutOffset + 4 + cut_.size(), kSkimAlign);
+        for (int c = 0; c < nCells; ++c) {
+            table[c].offset = offset;
+            table[c].nEvents = counts_[c];
+            table[c].bytes = skimCellLayout(counts_[c], nReplicas_, codec_).bytes;
+            offset = skimAlignUp(offset + table[c].bytes, kSkimAlign);
+        }
+
+        bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1;
+        ok = ok && std::fwrite(table.data(), sizeof(SkimCellEntry), nCells, out) == (size_t)nCells;
+        ok = ok && std::fwrite(ids.data(), sizeof(uint16_t), ids.size(), out) == ids.size();
+        uint32_t cutLen = (uint32_t)cut_.size();
+        ok = ok && std::fwrite(&cutLen, 4, 1, out) == 1;
+        ok = ok && std::fwrite(cut_.data(), 1, cutLen, out) == cutLen;
+
+        for (int c = 0; c < nCells && ok; ++c) {
+            ok = padTo(out, table[c].offset) && writeCell(out, c, table[c].offset);
+        }
+        ok = ok && padTo(out, offset);
+        ok = (std::fclose(out) == 0) && ok;
+        removeSpools();
+        if (!ok) {
+            error = "write error on " + path_;
+            std::remove(path_.c_str());
+        }
+        return ok;
+    }
+
+private:
+    struct SpoolScalars { float mj12; int32_t njets; int32_t nbm; };
+
+    std::string spoolName(int c, char kind) const {
+        return path_ + ".spool." + std::to_string(c) + kind;
+    }
+
+    void removeSpools() {
+        for (size_t c = 0; c < scalars_.size(); ++c) {
+            if (scalars_[c]) { std::fclose(scalars_[c]); std::remove(spoolName(c, 's').c_str()); }
+            if (weights_[c]) { std::fclose(weights_[c]); std::remove(spoolName(c, 'w').c_str()); }
+        }
+        scalars_.clear();
+        weights_.clear();
+    }
+
+    static bool padTo(FILE* out, uint64_t offset) {
+        long pos = std::ftell(out);
+        if (pos < 0 || (uint64_t)pos > offset) return false;
+        static const char zeros[4096] = {};
+        uint64_t gap = offset - (uint64_t)pos;
+        while (gap > 0) {
+            size_t chunk = gap < sizeof(zeros) ? (size_t)gap : sizeof(zeros);
+            if (std::fwrite(zeros, 1, chunk, out) != chunk) return false;
+            gap -= chunk;
+        }
+        return true;
+    }
+
+    // Helper: Events per chunk when streaming a weight spool (~4 MB)
+    uint64_t spoolChunk() const { return std::max<uint64_t>(1, (1 << 20) / nReplicas_); }
+
+    // ratio16: range of all replica / nominal ratios in the spools; false if
+    // an event cannot be encoded or the range is too wide (kSkimRatioMaxError)
+    bool ratioRange() {
+        if (nReplicas_ < 2) { codecNote_ = "ratio16 needs at least 2 weights per event"; return false; }
+        double lo = 0, hi = 0;
+        bool any = false;
+        std::vector<float> buf(spoolChunk() * nReplicas_);
+        for (size_t c = 0; c < weights_.size(); ++c) {
+            std::rewind(weights_[c]);
+            size_t got;
+            while ((got = std::fread(buf.data(), sizeof(float) * nReplicas_, spoolChunk(), weights_[c])) > 0) {
+                for (size_t e = 0; e < got; ++e) {
+                    const float* w = buf.data() + e * nReplicas_;
+                    for (int k = 0; k < nReplicas_; ++k) {
+                        if (!std::isfinite(w[k])) { codecNote_ = "non-finite weight"; return false; }
+                        if (w[0] == 0.f && w[k] != 0.f) { codecNote_ = "zero nominal with non-zero replicas"; return false; }
+                    }
+                    if (w[0] == 0.f) continue;
+                    for (int k = 1; k < nReplicas_; ++k) {
+                        double r = (double)w[k] / w[0];
+                        if (!any) { lo = hi = r; any = true; }
+                        lo = std::min(lo, r);
+                        hi = std::max(hi, r);
+                    }
+                }
+            }
+        }
+        // Float header values: ratioMin rounded down, the top of the range still covered
+        ratioMin_ = (float)lo;
+        if (ratioMin_ > lo) ratioMin_ = std::nextafter(ratioMin_, -HUGE_VALF);
+        ratioStep_ = (float)((hi - ratioMin_) / 65535.0);
+        while (ratioMin_ + 65535.0 * ratioStep_ < hi) ratioStep_ = std::nextafter(ratioStep_, HUGE_VALF);
+        if (0.5 * ratioStep_ > kSkimRatioMaxError) {
+            char note[128];
+            std::snprintf(note, sizeof(note), "ratio range %.3g ~ %.3g too wide (error %.1e > %.1e)",
+                          lo, hi, 0.5 * ratioStep_, kSkimRatioMaxError);
+            codecNote_ = note;
+            ratioMin_ = ratioStep_ = 0.f;
+            return false;
+        }
+        return true;
+    }
+
+    bool writeRatioWeights(FILE* out, int c, uint64_t ratioOffset) {
+        const uint64_t chunk = spoolChunk();
+        std::vector<float> buf(chunk * nReplicas_);
+        std::vector<float> nominal(chunk);
+        std::vector<uint16_t> q(chunk * (nReplicas_ - 1));
+        const double inv = ratioStep_ > 0 ? 1.0 / ratioStep_ : 0.0;
+
+        // Pass 1: nominal column, pass 2: quantized ratios
+        bool ok = true;
+        for (int pass = 0; pass < 2 && ok; ++pass) {
+            if (pass == 1) ok = padTo(out, ratioOffset);
+            std::rewind(weights_[c]);
+            size_t got;
+            while (ok && (got = std::fread(buf.data(), sizeof(float) * nReplicas_, chunk, weights_[c])) > 0) {
+                for (size_t e = 0; e < got; ++e) {
+                    const float* w = buf.data() + e * nReplicas_;
+                    if (pass == 0) { nominal[e] = w[0]; continue; }
+                    uint16_t* qe = q.data() + e * (nReplicas_ - 1);
+                    for (int k = 1; k < nReplicas_; ++k) {
+                        double u = w[0] == 0.f ? 0.0 : ((double)w[k] / w[0] - ratioMin_) * inv;
+                        qe[k - 1] = (uint16_t)std::min(65535.0, std::max(0.0, std::round(u)));
+                    }
+                }
+                ok = pass == 0 ? std::fwrite(nominal.data(), sizeof(float), got, out) == got
+                               : std::fwrite(q.data(), sizeof(uint16_t) * (nReplicas_ - 1), got, out) == got;
+            }
+        }
+        return ok;
+    }
+
+    bool writeCell(FILE* out, int c, uint64_t base) {
+        const uint64_t n = counts_[c];
+        SkimCellLayout l = skimCellLayout(n, nReplicas_, codec_);
+
+        // Scalars: transpose the spooled records into three columns
+        std::vector<SpoolScalars> recs(n);
+        std::rewind(scalars_[c]);
+        if (n && std::fread(recs.data(), sizeof(SpoolScalars), n, scalars_[c]) != n) return false;
+
+        std::vector<float> mj12(n);
+        std::vector<int32_t> njets(n), nbm(n);
+        for (uint64_t e = 0; e < n; ++e) {
+            mj12[e] = recs[e].mj12; njets[e] = recs[e].njets; nbm[e] = recs[e].nbm;
+        }
+        bool ok = std::fwrite(mj12.data(), 4, n, out) == n;
+        ok = ok && std::fwrite(njets.data(), 4, n, out) == n;
+        ok = ok && std::fwrite(nbm.data(), 4, n, out) == n;
+        ok = ok && padTo(out, base + l.weights);
+        if (codec_ == kSkimCodecRatio16) return ok && writeRatioWeights(out, c, base + l.ratios);
+
+        // Weights: already contiguous, copy the spool in large chunks
+        std::rewind(weights_[c]);
+        std::vector<char> buf(1 << 22);
+        size_t got;
+        while (ok && (got = std::fread(buf.data(), 1, buf.size(), weights_[c])) > 0) {
+            ok = std::fwrite(buf.data(), 1, got, out) == got;
+        }
+        return ok;
+    }
+
+    std::string path_;
+    std::string cut_;
+    int nReplicas_ = 0;
+    uint64_t nEvents_ = 0;
+    uint32_t codec_ = kSkimCodecFloat;
+    std::string codecNote_;
+    float ratioMin_ = 0.f, ratioStep_ = 0.f;
+    bool spoolError_ = false;
+    std::vector<uint64_t> counts_;
+    std::vector<FILE*> scalars_;
+    std::vector<FILE*> weights_;
+};
+
+// --- Skim Replay ---
+// Helper: Original 'weight' indices a tool built for nFull weights per event
+// reads from a skim: the first nFull of a full skim (indices 0 ~ nFull-1),
+// every stored one of a subset skim (compress_pdf_replicas: nominal + the
+// kept replicas). Tools compare them across inputs before summing.
+inline std::vector<uint16_t> skimToolWeightIds(const SkimReader& skim, int nFull) {
+    const std::vector<uint16_t>& ids = skim.ReplicaIds();
+    bool full = (int)ids.size() >= nFull;
+    for (int k = 0; full && k < nFull; ++k) full = ids[k] == k;
+    return full ? std::vector<uint16_t>(ids.begin(), ids.begin() + nFull) : ids;
+}
+
+// Helper: Pass mask of a cell's events for a selection bound to
+// {njets, nbm, mj12}, evaluated block-wise (block = columns[0].size())
+inline void skimPassMask(Selection& bound, const SkimCell& cell, std::vector<std::vector<float>>& columns,
+                         std::vector<unsigned char>& blockMask, std::vector<unsigned char>& mask) {
+    const uint64_t blockSize = columns[0].size();
+    mask.resize(cell.n);
+    for (uint64_t first = 0; first < cell.n; first += blockSize) {
+        int n = (int)std::min<uint64_t>(blockSize, cell.n - first);
+        for (int i = 0; i < n; ++i) {
+            columns[0][i] = (float)cell.njets[first + i];
+            columns[1][i] = (float)cell.nbm[first + i];
+            columns[2][i] = cell.mj12[first + i];
+        }
+        bound.Evaluate(columns, n, blockMask);
+        std::memcpy(mask.data() + first, blockMask.data(), n);
+    }
+}
+
+// Helper: Visit the cells of a skim selected by 'wantedCells' (bit per
+// cell key). With a non-trivial selection, a pass mask over the cell's
+// events is evaluated block-wise on the njets/nbm/mj12 columns.
+// fn(cellKey, cell, mask) ; mask == nullptr -> every event passes.
+template <typename CellFn>
+bool forEachSkimCell(const SkimReader& skim, uint64_t wantedCells, const Selection& sel,
+                     int blockSize, std::string& error, CellFn fn) {
+    std::vector<std::string> names = {"njets", "nbm", "mj12"};
+    Selection bound = sel;
+    if (!bound.IsTrivial() && !bound.Bind(names, error)) {
+        error += " (a skim only stores njets, nbm and mj12)";
+        return false;
+    }
+
+    std::vector<std::vector<float>> columns(3, std::vector<float>(blockSize));
+    std::vector<unsigned char> blockMask, mask;
+    for (int c = 0; c < skim.NCells() && c < 64; ++c) {
+        if (!(wantedCells & (uint64_t(1) << c))) continue;
+        SkimCell cell = skim.Cell(c);
+        if (cell.n == 0) continue;
+
+        if (bound.IsTrivial()) {
+            fn(c, cell, (const unsigned char*)nullptr);
+            continue;
+        }
+
+        skimPassMask(bound, cell, columns, blockMask, mask);
+        fn(c, cell, (const unsigned char*)mask.data());
+    }
+    return true;
+}
+
+// --- Accumulation ---
+// Float-block mode: up to kSkimFloatBlock events are summed in float lanes
+// (no float->double widening in the inner loop, twice the SIMD width),
+// then the partial sums are flushed into the double totals.
+// Error bound per flush (recursive float summation of B <= kSkimFloatBlock
+// terms, u = 2^-24):
+//   |partial - exact| <= (B - 1) * u * sum|w|  ~ 1.5e-5 * sum|w|  (B = 256)
+// so the relative error of a replica sum stays below ~1.5e-5 only for
+// weights of one sign, far below the per-mille envelope differences; the
+// double totals add no further growth across blocks. With negative weights
+// sum|w| can exceed |sum w| by any factor and the bound is void, so the
+// default (floatBlock = 0) is the exact double accumulation and callers opt
+// in: the CG tools and compress_pdf_replicas.cpp pass kSkimFloatBlock unless
+// --exact-sum is given, the C API when $PDFW_SKIM_SUM=float-block.
+// Timings: bench_pdf_accumulate.cpp.
+//
+// ratio16 cells are decoded inside the sum: per replica
+//   sum_e nom_e * (ratioMin + q_ek * step)
+//     = ratioMin * sum_e nom_e + step * sum_e nom_e * q_ek
+// so the kernel only widens q (uint16 -> float) and multiplies by the
+// nominal; the float-block bound above applies to the second term only.
+// The extra multiply keeps it behind the float-block float kernel whenever
+// the cell is in cache; it only wins where reading the bytes dominates.
+const int kSkimFloatBlock = 256;
+
+// Helper: floatBlock from $PDFW_SKIM_SUM ("float-block" or "double", default double)
+inline int skimFloatBlockFromEnv() {
+    const char* env = std::getenv("PDFW_SKIM_SUM");
+    return env && std::string(env) == "float-block" ? kSkimFloatBlock : 0;
+}
+
+// Helper: ratio16 part of accumulateSkimCell()
+inline void accumulateRatioCell(const SkimCell& cell, const unsigned char* mask, int nSum, double* sums,
+                                int floatBlock) {
+    if (nSum <= 0) return;
+    const int nQ = nSum - 1;
+    const uint32_t stride = cell.nReplicas - 1;
+    double nomSum = 0;
+    std::vector<double> scaled(nQ, 0.0); // sum_e nom_e * q_ek
+
+    if (floatBlock <= 0) {
+        for (uint64_t e = 0; e < cell.n; ++e) {
+            if (mask && !mask[e]) continue;
+            const double nom = cell.weights[e];
+            const uint16_t* q = cell.ratios + e * stride;
+            nomSum += nom;
+            for (int k = 0; k < nQ; ++k) scaled[k] += nom * q[k];
+        }
+    } else {
+        std::vector<float> partial(nQ, 0.f);
+        float* __restrict p = partial.data();
+        int inBlock = 0;
+        for (uint64_t e = 0; e < cell.n; ++e) {
+            if (mask && !mask[e]) continue;
+            const float nom = cell.weights[e];
+            const uint16_t* __restrict q = cell.ratios + e * stride;
+            nomSum += nom;
+            int k = 0;
+            for (; k + 8 <= nQ; k += 8) {
+#pragma GCC unroll 8
+                for (int j = 0; j < 8; ++j) p[k + j] += nom * (float)q[k + j];
+            }
+            for (; k < nQ; ++k) p[k] += nom * (float)q[k];
+            if (++inBlock == floatBlock) {
+                for (int k = 0; k < nQ; ++k) { scaled[k] += p[k]; p[k] = 0.f; }
+                inBlock = 0;
+            }
+        }
+        if (inBlock > 0)
+            for (int k = 0; k < nQ; ++k) scaled[k] += p[k];
+    }
+
+    sums[0] += nomSum;
+    for (int k = 0; k < nQ; ++k) sums[k + 1] += cell.ratioMin * nomSum + cell.ratioStep * scaled[k];
+}
+
+// Helper: float part of accumulateSkimCell()
+inline void accumulateFloatCell(const SkimCell& cell, const unsigned char* mask, int nSum, double* sums,
+                                int floatBlock) {
+    if (floatBlock <= 0) {
+        for (uint64_t e = 0; e < cell.n; ++e) {
+            if (mask && !mask[e]) continue;
+            const float* w = cell.Weights(e);
+            for (int k = 0; k < nSum; ++k) sums[k] += w[k];
+        }
+        return;
+    }
+
+    std::vector<float> partial(nSum, 0.f);
+    float* __restrict p = partial.data();
+    int inBlock = 0;
+    for (uint64_t e = 0; e < cell.n; ++e) {
+        if (mask && !mask[e]) continue;
+        const float* __restrict w = cell.Weights(e);
+        // Fixed 8-wide chunks, unrolled: SLP-vectorized at -O2 in any inlining context
+        int k = 0;
+        for (; k + 8 <= nSum; k += 8) {
+#pragma GCC unroll 8
+            for (int j = 0; j < 8; ++j) p[k + j] += w[k + j];
+        }
+        for (; k < nSum; ++k) p[k] += w[k];
+        if (++inBlock == floatBlock) {
+            for (int k = 0; k < nSum; ++k) { sums[k] += p[k]; p[k] = 0.f; }
+            inBlock = 0;
+        }
+    }
+    if (inBlock > 0)
+        for (int k = 0; k < nSum; ++k) sums[k] += p[k];
+}
+
+// Helper: Add the first nSum weights of the passing events of a cell to sums[0..nSum)
+inline void accumulateSkimCell(const SkimCell& cell, const unsigned char* mask, int nSum, double* sums,
+                               int floatBlock = 0) {
+    if (cell.codec == kSkimCodecRatio16) accumulateRatioCell(cell, mask, nSum, sums, floatBlock);
+    else accumulateFloatCell(cell, mask, nSum, sums, floatBlock);
+}
+
+#endif // PDF_SKIM_H
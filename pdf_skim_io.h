@@ -0,0 +1,545 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Queued Skim Reader (io_uring / pread)
+// File: pdf_skim_io.h
+//
+// [Problem]
+//   SkimReader maps the file; a cold pass is driven by page faults and the
+//   kernel's readahead window (a few hundred KiB in flight), and ReadCell
+//   is one synchronous pread at a time. Either way an NVMe drive sees a
+//   queue depth of ~1 and runs far below its bandwidth.
+//
+// [streamSkimCells]
+// - The wanted cells are cut into units: a whole cell group when it fits
+//   in chunkBytes (one read, cell groups are 4096-byte aligned), else
+//   event ranges of ~chunkBytes with one read per column slice
+//   (mj12, njets, nbm, weights; ratio16: nominal and ratios).
+// - Every read is 4096-byte aligned (offset, length, buffer), into a ring
+//   of 'depth' slot buffers; up to depth units are in flight at once.
+// - The calling thread drives the I/O; nWorkers threads take completed
+//   units, evaluate the selection on them and call
+//     fn(worker, cellKey, part, mask)   (part: SkimCell view of the unit)
+//   then hand the slot back for the next read. A cell may arrive in
+//   several parts, in any order; fn must only accumulate.
+//
+// [Backends] (SkimIoOptions::backend, $PDFW_SKIM_IO for the tools)
+//   mmap  : forEachSkimCell over the mapped file (default, no copies)
+//   uring : io_uring (raw syscalls, kernel >= 5.6, no liburing needed);
+//           falls back to pread when the ring cannot be set up
+//           (old kernel, seccomp, io_uring_disabled); the reason is in
+//           SkimIoStats::note (forEachSkimPart prints it once)
+//   pread : the same pipeline with synchronous preads on the I/O thread
+// - Reads go through the SkimReader's descriptor; direct = true reopens
+//   the file with O_DIRECT (no page cache), the buffered descriptor is
+//   kept if the filesystem refuses it.
+//
+// Cold / warm timings against mmap: bench_pdf_accumulate.cpp --io FILE
+// ROOT-free.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_SKIM_IO_H
+#define PDF_SKIM_IO_H
+
+#include <vector>
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "pdf_skim.h"
+
+const uint64_t kSkimIoAlign = 4096;         // offset / length / buffer alignment
+const uint64_t kSkimIoChunk = 4u << 20;     // bytes per unit (4 MiB)
+const int      kSkimIoDepth = 16;           // units in flight
+
+enum class SkimIoBackend { Mmap, Uring, Pread };
+
+inline const char* skimIoBackendName(SkimIoBackend b) {
+    return b == SkimIoBackend::Uring ? "uring" : b == SkimIoBackend::Pread ? "pread" : "mmap";
+}
+
+inline bool parseSkimIoBackend(const std::string& name, SkimIoBackend& b) {
+    if (name == "mmap") b = SkimIoBackend::Mmap;
+    else if (name == "uring") b = SkimIoBackend::Uring;
+    else if (name == "pread") b = SkimIoBackend::Pread;
+    else return false;
+    return true;
+}
+
+// Helper: Backend for the tools ($PDFW_SKIM_IO=mmap|uring|pread, default mmap)
+inline SkimIoBackend skimIoBackendFromEnv() {
+    SkimIoBackend b = SkimIoBackend::Mmap;
+    const char* env = std::getenv("PDFW_SKIM_IO");
+    if (env && *env) parseSkimIoBackend(env, b);
+    return b;
+}
+
+struct SkimIoOptions {
+    SkimIoBackend backend = SkimIoBackend::Uring;
+    int depth = kSkimIoDepth;
+    uint64_t chunkBytes = kSkimIoChunk;
+    bool direct = false;
+};
+
+struct SkimIoStats {
+    SkimIoBackend backend = SkimIoBackend::Mmap; // backend actually used
+    bool direct = false;                         // O_DIRECT actually used
+    uint64_t reads = 0;
+    uint64_t bytes = 0;                          // read from the file (aligned)
+    std::string note;                            // why the asked-for backend was not used
+};
+
+// --- io_uring (raw syscalls) ---
+// Single-issuer ring: only the I/O thread pushes, submits and reaps.
+class SkimUring {
+public:
+    SkimUring() {}
+    SkimUring(const SkimUring&) = delete;
+    SkimUring& operator=(const SkimUring&) = delete;
+    ~SkimUring() { Close(); }
+
+    bool Setup(unsigned entries, std::string& error) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        fd_ = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (fd_ < 0) { error = std::string("io_uring_setup: ") + std::strerror(errno); return false; }
+
+        sqBytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        single_ = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_) sqBytes_ = cqBytes_ = std::max(sqBytes_, cqBytes_);
+        sqesBytes_ = p.sq_entries * sizeof(io_uring_sqe);
+
+        sq_ = (char*)mmap(nullptr, sqBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+        cq_ = single_ ? sq_ : (char*)mmap(nullptr, cqBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        sqes_ = (io_uring_sqe*)mmap(nullptr, sqesBytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+        if (sq_ == MAP_FAILED || cq_ == MAP_FAILED || (void*)sqes_ == MAP_FAILED) {
+            error = "cannot map the io_uring rings";
+            Close();
+            return false;
+        }
+
+        sqHead_ = (unsigned*)(sq_ + p.sq_off.head);
+        sqTail_ = (unsigned*)(sq_ + p.sq_off.tail);
+        sqMask_ = *(unsigned*)(sq_ + p.sq_off.ring_mask);
+        sqArray_ = (unsigned*)(sq_ + p.sq_off.array);
+        sqEntries_ = p.sq_entries;
+        cqHead_ = (unsigned*)(cq_ + p.cq_off.head);
+        cqTail_ = (unsigned*)(cq_ + p.cq_off.tail);
+        cqMask_ = *(unsigned*)(cq_ + p.cq_off.ring_mask);
+        cqes_ = (io_uring_cqe*)(cq_ + p.cq_off.cqes);
+        return true;
+    }
+
+    void Close() {
+        if (sqes_ && (void*)sqes_ != MAP_FAILED) munmap(sqes_, sqesBytes_);
+        if (cq_ && cq_ != MAP_FAILED && !single_) munmap(cq_, cqBytes_);
+        if (sq_ && sq_ != MAP_FAILED) munmap(sq_, sqBytes_);
+        if (fd_ >= 0) ::close(fd_);
+        sq_ = cq_ = nullptr;
+        sqes_ = nullptr;
+        fd_ = -1;
+    }
+
+    // Queue one read (false if the submission ring is full)
+    bool PushRead(int fd, void* buf, unsigned len, uint64_t offset, uint64_t tag) {
+        unsigned tail = *sqTail_;
+        if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) return false;
+        unsigned idx = tail & sqMask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)buf;
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = tag;
+        sqArray_[idx] = idx;
+        __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+        ++unsubmitted_;
+        return true;
+    }
+
+    // Submits the queued reads; waits for at least waitFor completions
+    bool Enter(unsigned waitFor, std::string& error) {
+        for (;;) {
+            int r = (int)syscall(__NR_io_uring_enter, fd_, unsubmitted_, waitFor,
+                                 waitFor ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (r >= 0) { unsubmitted_ -= std::min<unsigned>(unsubmitted_, (unsigned)r); return true; }
+            if (errno == EINTR) continue;
+            error = std::string("io_uring_enter: ") + std::strerror(errno);
+            return false;
+        }
+    }
+
+    // Next completion (false if none is ready)
+    bool Reap(uint64_t& tag, int& res) {
+        unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) return false;
+        const io_uring_cqe& cqe = cqes_[head & cqMask_];
+        tag = cqe.user_data;
+        res = cqe.res;
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    bool single_ = false;
+    size_t sqBytes_ = 0, cqBytes_ = 0, sqesBytes_ = 0;
+    char* sq_ = nullptr;
+    char* cq_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned *sqHead_ = nullptr, *sqTail_ = nullptr, *sqArray_ = nullptr;
+    unsigned *cqHead_ = nullptr, *cqTail_ = nullptr;
+    unsigned sqMask_ = 0, sqEntries_ = 0, cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned unsubmitted_ = 0;
+};
+
+// --- Units ---
+// One aligned read of a unit: [offset, offset + len) of the file into
+// slot + pos; at least 'need' bytes must arrive (the rest may be past EOF).
+// The column slice it covers starts at slot + slice.
+struct SkimIoRead {
+    uint64_t offset = 0, len = 0, need = 0, pos = 0, slice = 0;
+    uint64_t done = 0;
+};
+
+struct SkimIoUnit {
+    int cell = 0;
+    uint64_t first = 0, count = 0;
+    bool whole = false;      // one read of the whole cell group
+    SkimIoRead reads[5];
+    int nReads = 0;
+    uint64_t slotBytes = 0;
+
+    // Adds the aligned read covering [offset, offset + bytes)
+    void Add(uint64_t offset, uint64_t bytes) {
+        SkimIoRead& r = reads[nReads++];
+        r.offset = offset / kSkimIoAlign * kSkimIoAlign;
+        r.need = offset + bytes - r.offset;
+        r.len = skimAlignUp(r.need, kSkimIoAlign);
+        r.pos = slotBytes;
+        r.slice = r.pos + (offset - r.offset);
+        slotBytes += r.len;
+    }
+};
+
+// Helper: Units of the wanted cells and the slot size they need
+inline std::vector<SkimIoUnit> skimIoUnits(const SkimReader& skim, uint64_t wantedCells, uint64_t chunkBytes,
+                                           uint64_t& slotBytes) {
+    std::vector<SkimIoUnit> units;
+    slotBytes = kSkimIoAlign;
+    const SkimHeader& h = skim.Header();
+    const uint32_t codec = skim.Codec();
+    const uint64_t perEvent = 12 + (codec == kSkimCodecRatio16 ? 4 + 2 * (uint64_t)(h.nReplicas - 1)
+                                                               : 4 * (uint64_t)h.nReplicas);
+    for (int c = 0; c < skim.NCells() && c < 64; ++c) {
+        if (!(wantedCells & (uint64_t(1) << c))) continue;
+        const SkimCellEntry& e = skim.CellEntry(c);
+        if (e.nEvents == 0) continue;
+
+        if (e.bytes <= chunkBytes) {
+            SkimIoUnit u;
+            u.cell = c;
+            u.count = e.nEvents;
+            u.whole = true;
+            u.Add(e.offset, e.bytes);
+            slotBytes = std::max(slotBytes, u.slotBytes);
+            units.push_back(u);
+            continue;
+        }
+
+        SkimCellLayout l = skimCellLayout(e.nEvents, h.nReplicas, codec);
+        uint64_t step = std::max<uint64_t>(1, chunkBytes / perEvent);
+        for (uint64_t first = 0; first < e.nEvents; first += step) {
+            SkimIoUnit u;
+            u.cell = c;
+            u.first = first;
+            u.count = std::min(step, e.nEvents - first);
+            u.Add(e.offset + l.mj12 + 4 * first, 4 * u.count);
+            u.Add(e.offset + l.njets + 4 * first, 4 * u.count);
+            u.Add(e.offset + l.nbm + 4 * first, 4 * u.count);
+            if (codec == kSkimCodecRatio16) {
+                u.Add(e.offset + l.weights + 4 * first, 4 * u.count);
+                u.Add(e.offset + l.ratios + 2 * first * (h.nReplicas - 1), 2 * u.count * (h.nReplicas - 1));
+            } else {
+                u.Add(e.offset + l.weights + 4 * first * h.nReplicas, 4 * u.count * h.nReplicas);
+            }
+            slotBytes = std::max(slotBytes, u.slotBytes);
+            units.push_back(u);
+        }
+    }
+    return units;
+}
+
+// Helper: SkimCell view of a unit read into 'slot'
+inline SkimCell skimIoView(const SkimReader& skim, const SkimIoUnit& u, const char* slot) {
+    const SkimHeader& h = skim.Header();
+    if (u.whole) return skimCellView(slot + u.reads[0].slice, u.count, h);
+    auto at = [&](int r) { return slot + u.reads[r].slice; };
+    const uint32_t codec = skim.Codec();
+    SkimCell cell;
+    cell.n = u.count;
+    cell.nReplicas = h.nReplicas;
+    cell.codec = codec;
+    cell.mj12  = reinterpret_cast<const float*>(at(0));
+    cell.njets = reinterpret_cast<const int32_t*>(at(1));
+    cell.nbm   = reinterpret_cast<const int32_t*>(at(2));
+    if (codec == kSkimCodecRatio16) {
+        cell.weights   = reinterpret_cast<const float*>(at(3));
+        cell.ratios    = reinterpret_cast<const uint16_t*>(at(4));
+        cell.ratioMin  = h.ratioMin;
+        cell.ratioStep = h.ratioStep;
+    } else {
+        cell.weights = reinterpret_cast<const float*>(at(3));
+    }
+    return cell;
+}
+
+// --- Streaming ---
+// Helper: Run fn(worker, cellKey, part, mask) over the wanted cells of an
+// open skim through the queued reader (see header); mask == nullptr ->
+// every event of the part passes. False (error set) on a setup or read
+// error; parts handed out before the error have been processed.
+template <typename PartFn>
+bool streamSkimCells(const SkimReader& skim, uint64_t wantedCells, const Selection& sel,
+                     int blockSize, const SkimIoOptions& opts, int nWorkers, std::string& error, PartFn fn,
+                     SkimIoStats* stats = nullptr) {
+    std::vector<std::string> names = {"njets", "nbm", "mj12"};
+    Selection bound = sel;
+    if (!bound.IsTrivial() && !bound.Bind(names, error)) {
+        error += " (a skim only stores njets, nbm and mj12)";
+        return false;
+    }
+    SkimIoStats local;
+    SkimIoStats& st = stats ? *stats : local;
+    st = SkimIoStats();
+    st.backend = opts.backend;
+
+    if (opts.backend == SkimIoBackend::Mmap) {
+        return forEachSkimCell(skim, wantedCells, bound, blockSize, error,
+            [&](int c, const SkimCell& cell, const unsigned char* mask) { fn(0, c, cell, mask); });
+    }
+
+    uint64_t slotBytes = 0;
+    std::vector<SkimIoUnit> units = skimIoUnits(skim, wantedCells, std::max<uint64_t>(kSkimIoAlign, opts.chunkBytes),
+                                                slotBytes);
+    if (units.empty()) return true;
+    nWorkers = std::max(1, nWorkers);
+    const int nSlots = std::max(opts.depth, nWorkers + 1);
+
+    // The reader's descriptor, or the same file reopened with O_DIRECT if asked for and accepted
+    int fd = skim.Fd();
+    if (opts.direct) {
+        int direct = ::open(("/proc/self/fd/" + std::to_string(fd)).c_str(), O_RDONLY | O_DIRECT);
+        if (direct >= 0) fd = direct;
+        st.direct = direct >= 0;
+    }
+    auto closeFd = [&]() { if (fd != skim.Fd()) ::close(fd); };
+
+    SkimUring ring;
+    if (st.backend == SkimIoBackend::Uring) {
+        std::string ring_error;
+        unsigned entries = 1;
+        while (entries < (unsigned)nSlots * 5) entries <<= 1;
+        if (!ring.Setup(entries, ring_error)) {
+            st.backend = SkimIoBackend::Pread; // fallback
+            st.note = ring_error + ", pread used";
+        }
+    }
+
+    // Slot ring (aligned buffers), free list and the queue of completed units
+    char* slots = nullptr;
+    if (posix_memalign((void**)&slots, kSkimIoAlign, slotBytes * nSlots) != 0) {
+        closeFd();
+        error = "cannot allocate the read buffers";
+        return false;
+    }
+    std::vector<int> slotOf(units.size(), -1);
+    std::vector<int> freeSlots;
+    for (int s = nSlots; s-- > 0;) freeSlots.push_back(s);
+    std::deque<size_t> ready;
+    bool finished = false;
+    std::mutex mutex;
+    std::condition_variable slotFreed, unitReady;
+
+    // Workers: selection + fn on completed units, then the slot goes back
+    std::vector<std::thread> workers;
+    for (int w = 0; w < nWorkers; ++w) {
+        workers.emplace_back([&, w]() {
+            Selection wsel = bound; // scratch masks are per copy
+            std::vector<std::vector<float>> columns(3, std::vector<float>(std::max(1, blockSize)));
+            std::vector<unsigned char> blockMask, mask;
+            for (;;) {
+                size_t i;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    unitReady.wait(lock, [&]() { return finished || !ready.empty(); });
+                    if (ready.empty()) return;
+                    i = ready.front();
+                    ready.pop_front();
+                }
+                const SkimIoUnit& u = units[i];
+                SkimCell part = skimIoView(skim, u, slots + (size_t)slotOf[i] * slotBytes);
+                if (wsel.IsTrivial()) {
+                    fn(w, u.cell, part, (const unsigned char*)nullptr);
+                } else {
+                    skimPassMask(wsel, part, columns, blockMask, mask);
+                    fn(w, u.cell, part, (const unsigned char*)mask.data());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    freeSlots.push_back(slotOf[i]);
+                }
+                slotFreed.notify_one();
+            }
+        });
+    }
+
+    // I/O thread (this one): keep up to nSlots units in flight
+    std::vector<int> pending(units.size(), 0); // reads left per unit
+    size_t nextUnit = 0, nDone = 0;
+    int inFlight = 0; // reads submitted, not completed
+    bool ok = true;
+    auto complete = [&](size_t i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(i);
+        }
+        unitReady.notify_one();
+        ++nDone;
+    };
+    // A read result: true when the read is complete, false + resubmit when short
+    // Queue one read; a full submission ring is flushed once before giving up
+    auto push = [&](void* buf, uint64_t len, uint64_t offset, uint64_t tag) {
+        if (!ring.PushRead(fd, buf, (unsigned)len, offset, tag) &&
+            (!ring.Enter(0, error) || !ring.PushRead(fd, buf, (unsigned)len, offset, tag))) {
+            if (error.empty()) error = "io_uring submission queue full";
+            ok = false;
+            return false;
+        }
+        ++inFlight;
+        return true;
+    };
+    auto account = [&](size_t i, int r, int res) {
+        SkimIoRead& rd = units[i].reads[r];
+        if (res < 0) { error = std::string("read error: ") + std::strerror(-res); ok = false; return true; }
+        if (res == 0 && rd.done < rd.need) { error = "skim is truncated (short read)"; ok = false; return true; }
+        rd.done += (uint64_t)res;
+        st.bytes += (uint64_t)res;
+        return rd.done >= rd.need;
+    };
+
+    while (ok && nDone < units.size()) {
+        // Start units while slots are free
+        for (;;) {
+            if (nextUnit >= units.size()) break;
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (freeSlots.empty()) {
+                    if (inFlight > 0) break; // reap completions first
+                    slotFreed.wait(lock, [&]() { return !freeSlots.empty(); });
+                }
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            size_t i = nextUnit++;
+            SkimIoUnit& u = units[i];
+            slotOf[i] = slot;
+            char* base = slots + (size_t)slot * slotBytes;
+            pending[i] = u.nReads;
+            for (int r = 0; r < u.nReads; ++r) {
+                SkimIoRead& rd = u.reads[r];
+                ++st.reads;
+                if (st.backend == SkimIoBackend::Uring) {
+                    if (!push(base + rd.pos, rd.len, rd.offset, (uint64_t)i << 3 | r)) break;
+                    continue;
+                }
+                // pread: synchronous, short reads continued
+                bool complete_read = false;
+                while (ok && !complete_read) {
+                    ssize_t res = pread(fd, base + rd.pos + rd.done, rd.len - rd.done, rd.offset + rd.done);
+                    if (res < 0 && errno == EINTR) continue;
+                    complete_read = account(i, r, res < 0 ? -errno : (int)res);
+                }
+                --pending[i];
+            }
+            if (!ok) break;
+            if (pending[i] == 0) complete(i);
+        }
+        if (!ok || st.backend != SkimIoBackend::Uring) continue;
+
+        // Submit and wait for at least one completion
+        if (inFlight > 0 && !ring.Enter(1, error)) { ok = false; break; }
+        uint64_t tag;
+        int res;
+        while (ring.Reap(tag, res)) {
+            size_t i = (size_t)(tag >> 3);
+            int r = (int)(tag & 7);
+            --inFlight;
+            if (!account(i, r, res)) {
+                // Short read: continue where it stopped
+                SkimIoRead& rd = units[i].reads[r];
+                if (!push(slots + (size_t)slotOf[i] * slotBytes + rd.pos + rd.done,
+                          rd.len - rd.done, rd.offset + rd.done, tag)) break;
+                continue;
+            }
+            if (ok && --pending[i] == 0) complete(i);
+        }
+    }
+
+    // Drain: the kernel may still write into the slots
+    while (st.backend == SkimIoBackend::Uring && inFlight > 0) {
+        std::string drain_error;
+        if (!ring.Enter(1, drain_error)) break;
+        uint64_t tag;
+        int res;
+        while (ring.Reap(tag, res)) --inFlight;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    unitReady.notify_all();
+    for (auto& w : workers) w.join();
+    // Ring teardown cancels what is left, but finishes asynchronously:
+    // the slots of reads that never completed are leaked, not freed
+    ring.Close();
+    closeFd();
+    if (inFlight == 0) free(slots);
+    return ok;
+}
+
+// Helper: forEachSkimCell through the backend of $PDFW_SKIM_IO
+// (streamed cells arrive in parts, on one worker thread)
+template <typename CellFn>
+bool forEachSkimPart(const SkimReader& skim, uint64_t wantedCells, const Selection& sel,
+                     int blockSize, std::string& error, CellFn fn) {
+    SkimIoOptions opts;
+    opts.backend = skimIoBackendFromEnv();
+    SkimIoStats stats;
+    bool ok = streamSkimCells(skim, wantedCells, sel, blockSize, opts, 1, error,
+        [&](int, int c, const SkimCell& part, const unsigned char* mask) { fn(c, part, mask); }, &stats);
+    static bool warned = false;
+    if (!stats.note.empty() && !warned) {
+        std::cout << "[Warning] PDFW_SKIM_IO=" << skimIoBackendName(opts.backend) << ": " << stats.note << std::endl;
+        warned = true;
+    }
+    return ok;
+}
+
+#endif // PDF_SKIM_IO_H
@@ -0,0 +1,567 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - Direct PDF / SVG / HTML Output for Replica Grids
+// File: pdf_vector_plot.h
+//
+// [Problem]
+//   SaveAs(".pdf") of the grid writes every one of the 100 x 14 HIST SAME
+//   histograms as its own object with its own axis set-up; the files are
+//   large and slow to open.
+//
+// [Layout]
+// - A VectorFigure is a cols x rows grid of pads; each VectorPanel holds
+//   the replica ratios [k][x], the 16th / 84th envelope [x] and a title.
+// - Everything inside a pad is written in pad-local integer units of
+//   0.1 pt: one transform per pad (PDF 'cm' / SVG translate) places it.
+// - The frame (box, y ticks and labels, x category labels) is the same in
+//   every pad: it is written once (PDF Form XObject / SVG <defs>) and
+//   only referenced per pad.
+// - The 100 replicas of a pad are one path of 100 step sub-paths with a
+//   single stroke; the envelope and the nominal line one path each.
+//
+// [Output]
+// - writeGridSvg(): plain SVG 1.1, styles in one <style> block.
+// - writeGridPdf(): PDF 1.4, one page, uncompressed content stream,
+//   built-in Helvetica (no embedded fonts).
+// - writeGridHtml(): one self-contained page for reviewers: the ratio
+//   and envelope arrays of every pad as base64 Float32 (4 bytes per
+//   value) plus a small inline canvas renderer. Hover shows the replica
+//   under the cursor, the wheel zooms y, a click enlarges a pad.
+// - All return false with a reason on an I/O error.
+//
+// ROOT-free.
+// -------------------------------------------------------------------------
+
+#ifndef PDF_VECTOR_PLOT_H
+#define PDF_VECTOR_PLOT_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+struct VectorRgb {
+    double r = 0, g = 0, b = 0;
+};
+
+struct VectorPanel {
+    int pad = -1;                 // 0-based grid slot, row-major from the top left
+    std::string title;
+    std::vector<double> replicas; // ratios [k * nX + x]
+    std::vector<double> lo, hi;   // envelope ratios [x]
+};
+
+struct VectorFigure {
+    int cols = 3, rows = 5;
+    double padW = 240, padH = 192;  // pad size [pt]
+    double yMin = 0.85, yMax = 1.15;
+    double nominal = 1.0;           // dashed reference line
+    std::vector<std::string> xLabels;
+    std::vector<VectorPanel> panels;
+    int notePad = -1;               // grid slot of the red note (-1: none)
+    std::string note;
+
+    VectorRgb replicaColor{0, 1, 1}, envelopeColor{0, 0, 1}, nominalColor{0, 0, 0};
+    double replicaWidth = 0.5, envelopeWidth = 1.0, nominalWidth = 1.0; // [pt]
+    double labelSize = 7, titleSize = 10, noteSize = 6;                // [pt]
+};
+
+// --- Geometry (shared by both writers, integer units of 0.1 pt) ---
+struct VectorPoint {
+    long x, y;
+};
+
+class VectorGeometry {
+public:
+    explicit VectorGeometry(const VectorFigure& fig) : fig_(fig) {
+        padW = lround(fig.padW * 10);
+        padH = lround(fig.padH * 10);
+        ax = lround(padW * 0.15);
+        aw = lround(padW * 0.80);
+        ay = lround(padH * 0.15);
+        ah = lround(padH * 0.80);
+        nX = std::max<int>(1, (int)fig.xLabels.size());
+    }
+
+    long X(double i) const { return ax + lround(aw * i / nX); }
+    long Y(double v) const { return ay + lround(ah * (v - fig_.yMin) / (fig_.yMax - fig_.yMin)); }
+
+    // Pad origin (bottom left, y up) on the page
+    long PadX(int pad) const { return (pad % fig_.cols) * padW; }
+    long PadY(int pad) const { return (fig_.rows - 1 - pad / fig_.cols) * padH; }
+
+    // Step line over the nX categories: horizontal per category, vertical in between
+    std::vector<VectorPoint> Steps(const double* v) const {
+        std::vector<VectorPoint> pts;
+        for (int i = 0; i < nX; ++i) {
+            long y = Y(v[i]);
+            if (!pts.empty() && pts.back().y == y) { pts.back().x = X(i + 1); continue; }
+            pts.push_back({X(i), y});
+            pts.push_back({X(i + 1), y});
+        }
+        return pts;
+    }
+
+    // Helper: y tick values (about 5 divisions, 1 / 2 / 5 x 10^n steps)
+    std::vector<double> Ticks() const {
+        std::vector<double> ticks;
+        double range = fig_.yMax - fig_.yMin;
+        if (!(range > 0)) return ticks;
+        double raw = range / 5, mag = std::pow(10.0, std::floor(std::log10(raw)));
+        double step = raw / mag < 1.5 ? mag : raw / mag < 3.5 ? 2 * mag : raw / mag < 7.5 ? 5 * mag : 10 * mag;
+        for (double t = std::ceil(fig_.yMin / step - 1e-9) * step; t <= fig_.yMax + 1e-9 * step; t += step)
+            ticks.push_back(std::fabs(t) < 1e-12 * step ? 0.0 : t);
+        return ticks;
+    }
+
+    long padW, padH; // pad
+    long ax, aw, ay, ah; // plot area inside the pad
+    int nX;
+
+private:
+    const VectorFigure& fig_;
+};
+
+// Helper: Writes 'text' to 'path'
+inline bool writeVectorFile(const std::string& path, const std::string& text, std::string& error) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) { error = "cannot write " + path; return false; }
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) error = "write error on " + path;
+    return ok;
+}
+
+// Helper: Integer in 0.1 pt units as a decimal point value ("123" -> "12.3")
+inline std::string vectorPt(long deci) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), deci % 10 ? "%.1f" : "%.0f", deci / 10.0);
+    return buf;
+}
+
+inline std::string vectorLabel(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", v);
+    return buf;
+}
+
+// --- SVG ---
+inline std::string vectorXml(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '&') out += "&amp;";
+        else if (c == '<') out += "&lt;";
+        else if (c == '>') out += "&gt;";
+        else out += c;
+    }
+    return out;
+}
+
+inline std::string vectorSvgColor(const VectorRgb& c) {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "#%02x%02x%02x", (int)lround(c.r * 255), (int)lround(c.g * 255), (int)lround(c.b * 255));
+    return buf;
+}
+
+inline bool writeGridSvg(const VectorFigure& fig, const std::string& path, std::string& error) {
+    const VectorGeometry g(fig);
+    const long W = g.padW * fig.cols, H = g.padH * fig.rows;
+    std::string o;
+    o.reserve(1 << 20);
+    char buf[256];
+
+    // viewBox in 0.1 pt; SVG y points down, so pad-local y becomes padH - y
+    snprintf(buf, sizeof(buf),
+             "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+             " width=\"%gpt\" height=\"%gpt\" viewBox=\"0 0 %ld %ld\">\n", W / 10.0, H / 10.0, W, H);
+    o += buf;
+    o += "<style>path{fill:none}text{font-family:Helvetica,Arial,sans-serif}";
+    snprintf(buf, sizeof(buf), ".r{stroke:%s;stroke-width:%ld}", vectorSvgColor(fig.replicaColor).c_str(), lround(fig.replicaWidth * 10));
+    o += buf;
+    snprintf(buf, sizeof(buf), ".e{stroke:%s;stroke-width:%ld}", vectorSvgColor(fig.envelopeColor).c_str(), lround(fig.envelopeWidth * 10));
+    o += buf;
+    snprintf(buf, sizeof(buf), ".n{stroke:%s;stroke-width:%ld;stroke-dasharray:60 40}", vectorSvgColor(fig.nominalColor).c_str(), lround(fig.nominalWidth * 10));
+    o += buf;
+    o += ".f{stroke:#000;stroke-width:5}</style>\n<rect width=\"100%\" height=\"100%\" fill=\"#fff\"/>\n<defs>\n";
+
+    // Shared clip and frame (pad-local)
+    snprintf(buf, sizeof(buf), "<clipPath id=\"c\"><rect x=\"%ld\" y=\"%ld\" width=\"%ld\" height=\"%ld\"/></clipPath>\n",
+             g.ax, g.padH - g.ay - g.ah, g.aw, g.ah);
+    o += buf;
+    o += "<g id=\"f\">";
+    snprintf(buf, sizeof(buf), "<rect class=\"f\" fill=\"none\" x=\"%ld\" y=\"%ld\" width=\"%ld\" height=\"%ld\"/>",
+             g.ax, g.padH - g.ay - g.ah, g.aw, g.ah);
+    o += buf;
+    const long label = lround(fig.labelSize * 10);
+    o += "<path class=\"f\" d=\"";
+    for (double t : g.Ticks()) {
+        snprintf(buf, sizeof(buf), "M%ld %ldh%ld", g.ax, g.padH - g.Y(t), g.aw / 40);
+        o += buf;
+    }
+    o += "\"/>";
+    for (double t : g.Ticks()) {
+        snprintf(buf, sizeof(buf), "<text x=\"%ld\" y=\"%ld\" font-size=\"%ld\" text-anchor=\"end\">%s</text>",
+                 g.ax - label / 2, g.padH - g.Y(t) + label / 3, label, vectorLabel(t).c_str());
+        o += buf;
+    }
+    for (int i = 0; i < (int)fig.xLabels.size(); ++i) {
+        snprintf(buf, sizeof(buf), "<text x=\"%ld\" y=\"%ld\" font-size=\"%ld\" text-anchor=\"middle\">",
+                 (g.X(i) + g.X(i + 1)) / 2, g.padH - g.ay + label + label / 3, label);
+        o += buf;
+        o += vectorXml(fig.xLabels[i]) + "</text>";
+    }
+    o += "</g>\n</defs>\n";
+
+    auto path_data = [&](const std::vector<VectorPoint>& pts) {
+        std::string d;
+        for (size_t i = 0; i < pts.size(); ++i) {
+            if (i == 0) snprintf(buf, sizeof(buf), "M%ld %ld", pts[i].x, g.padH - pts[i].y);
+            else if (pts[i].y == pts[i - 1].y) snprintf(buf, sizeof(buf), "H%ld", pts[i].x);
+            else snprintf(buf, sizeof(buf), "V%ld", g.padH - pts[i].y);
+            d += buf;
+        }
+        return d;
+    };
+
+    for (const VectorPanel& p : fig.panels) {
+        if (p.pad < 0 || p.pad >= fig.cols * fig.rows) continue;
+        snprintf(buf, sizeof(buf), "<g transform=\"translate(%ld %ld)\"><use xlink:href=\"#f\"/><g clip-path=\"url(#c)\">",
+                 g.PadX(p.pad), H - g.PadY(p.pad) - g.padH);
+        o += buf;
+
+        o += "<path class=\"r\" d=\"";
+        const int nRep = (int)(p.replicas.size() / g.nX);
+        for (int k = 0; k < nRep; ++k) o += path_data(g.Steps(p.replicas.data() + (size_t)k * g.nX));
+        o += "\"/><path class=\"e\" d=\"";
+        if ((int)p.lo.size() >= g.nX) o += path_data(g.Steps(p.lo.data()));
+        if ((int)p.hi.size() >= g.nX) o += path_data(g.Steps(p.hi.data()));
+        snprintf(buf, sizeof(buf), "\"/><path class=\"n\" d=\"M%ld %ldH%ld\"/></g>", g.ax, g.padH - g.Y(fig.nominal), g.ax + g.aw);
+        o += buf;
+
+        const long title = lround(fig.titleSize * 10);
+        snprintf(buf, sizeof(buf), "<text x=\"%ld\" y=\"%ld\" font-size=\"%ld\">", g.ax + g.aw / 20, g.padH - g.ay - g.ah + title * 3 / 2, title);
+        o += buf;
+        o += vectorXml(p.title) + "</text></g>\n";
+    }
+
+    if (fig.notePad >= 0 && !fig.note.empty()) {
+        const long size = lround(fig.noteSize * 10);
+        snprintf(buf, sizeof(buf), "<text x=\"%ld\" y=\"%ld\" font-size=\"%ld\" fill=\"#f00\">",
+                 g.PadX(fig.notePad) + g.padW / 20, H - g.PadY(fig.notePad) - g.padH / 2, size);
+        o += buf;
+        o += vectorXml(fig.note) + "</text>\n";
+    }
+    o += "</svg>\n";
+    return writeVectorFile(path, o, error);
+}
+
+// --- PDF ---
+inline std::string vectorPdfText(const std::string& s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '(' || c == ')' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// Helper: Approximate Helvetica width of 'text' at font size 1 (for centring)
+inline double vectorTextWidth(const std::string& text) {
+    double w = 0;
+    for (char c : text) w += (c >= '0' && c <= '9') || c == ' ' || c == '.' || c == '-' || c == '+' ? 0.556 : 0.6;
+    return w;
+}
+
+inline bool writeGridPdf(const VectorFigure& fig, const std::string& path, std::string& error) {
+    const VectorGeometry g(fig);
+    const long W = g.padW * fig.cols, H = g.padH * fig.rows;
+    char buf[256];
+
+    auto color = [&](const VectorRgb& c, const char* op) {
+        snprintf(buf, sizeof(buf), "%.3g %.3g %.3g %s\n", c.r, c.g, c.b, op);
+        return std::string(buf);
+    };
+    auto path_ops = [&](const std::vector<VectorPoint>& pts) {
+        std::string d;
+        for (size_t i = 0; i < pts.size(); ++i) {
+            snprintf(buf, sizeof(buf), "%ld %ld %s\n", pts[i].x, pts[i].y, i == 0 ? "m" : "l");
+            d += buf;
+        }
+        return d;
+    };
+
+    // Frame Form XObject (pad-local 0.1 pt units)
+    std::string frame;
+    const long label = lround(fig.labelSize * 10);
+    snprintf(buf, sizeof(buf), "0 G 5 w %ld %ld %ld %ld re S\n", g.ax, g.ay, g.aw, g.ah);
+    frame += buf;
+    for (double t : g.Ticks()) {
+        snprintf(buf, sizeof(buf), "%ld %ld m %ld %ld l S\n", g.ax, g.Y(t), g.ax + g.aw / 40, g.Y(t));
+        frame += buf;
+    }
+    frame += "BT\n";
+    for (double t : g.Ticks()) {
+        std::string s = vectorLabel(t);
+        snprintf(buf, sizeof(buf), "/F1 %ld Tf 1 0 0 1 %ld %ld Tm (%s) Tj\n", label,
+                 g.ax - label / 2 - lround(vectorTextWidth(s) * label), g.Y(t) - label / 3, vectorPdfText(s).c_str());
+        frame += buf;
+    }
+    for (int i = 0; i < (int)fig.xLabels.size(); ++i) {
+        const std::string& s = fig.xLabels[i];
+        snprintf(buf, sizeof(buf), "/F1 %ld Tf 1 0 0 1 %ld %ld Tm (%s) Tj\n", label,
+                 (g.X(i) + g.X(i + 1)) / 2 - lround(vectorTextWidth(s) * label / 2), g.ay - label - label / 3,
+                 vectorPdfText(s).c_str());
+        frame += buf;
+    }
+    frame += "ET\n";
+
+    // Page content: one 'cm' per pad, then everything in pad-local units
+    std::string content;
+    content.reserve(1 << 20);
+    content += "1 1 1 rg 0 0 " + vectorPt(W) + " " + vectorPt(H) + " re f\n";
+    content += "1 j\n";
+    for (const VectorPanel& p : fig.panels) {
+        if (p.pad < 0 || p.pad >= fig.cols * fig.rows) continue;
+        content += "q 0.1 0 0 0.1 " + vectorPt(g.PadX(p.pad)) + " " + vectorPt(g.PadY(p.pad)) + " cm /Fr Do\n";
+
+        snprintf(buf, sizeof(buf), "q %ld %ld %ld %ld re W n\n", g.ax, g.ay, g.aw, g.ah);
+        content += buf;
+        content += color(fig.replicaColor, "RG") + std::to_string(lround(fig.replicaWidth * 10)) + " w\n";
+        const int nRep = (int)(p.replicas.size() / g.nX);
+        for (int k = 0; k < nRep; ++k) content += path_ops(g.Steps(p.replicas.data() + (size_t)k * g.nX));
+        content += "S\n";
+
+        content += color(fig.envelopeColor, "RG") + std::to_string(lround(fig.envelopeWidth * 10)) + " w\n";
+        if ((int)p.lo.size() >= g.nX) content += path_ops(g.Steps(p.lo.data()));
+        if ((int)p.hi.size() >= g.nX) content += path_ops(g.Steps(p.hi.data()));
+        content += "S\n";
+
+        content += color(fig.nominalColor, "RG") + std::to_string(lround(fig.nominalWidth * 10)) + " w [60 40] 0 d\n";
+        snprintf(buf, sizeof(buf), "%ld %ld m %ld %ld l S\nQ\n", g.ax, g.Y(fig.nominal), g.ax + g.aw, g.Y(fig.nominal));
+        content += buf;
+
+        const long title = lround(fig.titleSize * 10);
+        snprintf(buf, sizeof(buf), "0 g BT /F1 %ld Tf %ld %ld Td (%s) Tj ET\nQ\n", title,
+                 g.ax + g.aw / 20, g.ay + g.ah - title * 3 / 2, vectorPdfText(p.title).c_str());
+        content += buf;
+    }
+    if (fig.notePad >= 0 && !fig.note.empty()) {
+        snprintf(buf, sizeof(buf), "1 0 0 rg BT /F1 %g Tf %s %s Td (%s) Tj ET\n", fig.noteSize,
+                 vectorPt(g.PadX(fig.notePad) + g.padW / 20).c_str(), vectorPt(g.PadY(fig.notePad) + g.padH / 2).c_str(),
+                 vectorPdfText(fig.note).c_str());
+        content += buf;
+    }
+
+    // Objects: 1 catalog, 2 pages, 3 page, 4 font, 5 frame, 6 content
+    std::vector<std::string> objects(6);
+    objects[0] = "<< /Type /Catalog /Pages 2 0 R >>";
+    objects[1] = "<< /Type /Pages /Kids [3 0 R] /Count 1 >>";
+    objects[2] = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 " + vectorPt(W) + " " + vectorPt(H) + "]"
+                 " /Resources << /Font << /F1 4 0 R >> /XObject << /Fr 5 0 R >> >> /Contents 6 0 R >>";
+    objects[3] = "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica /Encoding /WinAnsiEncoding >>";
+    objects[4] = "<< /Type /XObject /Subtype /Form /BBox [0 0 " + std::to_string(g.padW) + " " + std::to_string(g.padH) + "]"
+                 " /Resources << /Font << /F1 4 0 R >> >> /Length " + std::to_string(frame.size()) + " >>\nstream\n" +
+                 frame + "endstream";
+    objects[5] = "<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "endstream";
+
+    std::string o = "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); ++i) {
+        offsets.push_back(o.size());
+        o += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+    size_t xref = o.size();
+    o += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    for (size_t off : offsets) {
+        snprintf(buf, sizeof(buf), "%010zu 00000 n \n", off);
+        o += buf;
+    }
+    o += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R >>\nstartxref\n" +
+         std::to_string(xref) + "\n%%EOF\n";
+    return writeVectorFile(path, o, error);
+}
+
+// --- HTML ---
+// Helper: Base64 of raw bytes
+inline std::string vectorBase64(const void* data, size_t bytes) {
+    static const char* digits = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const unsigned char* p = (const unsigned char*)data;
+    std::string out;
+    out.reserve((bytes + 2) / 3 * 4);
+    for (size_t i = 0; i < bytes; i += 3) {
+        unsigned v = p[i] << 16 | (i + 1 < bytes ? p[i + 1] << 8 : 0) | (i + 2 < bytes ? p[i + 2] : 0);
+        out += digits[v >> 18 & 63];
+        out += digits[v >> 12 & 63];
+        out += i + 1 < bytes ? digits[v >> 6 & 63] : '=';
+        out += i + 2 < bytes ? digits[v & 63] : '=';
+    }
+    return out;
+}
+
+// Helper: JSON / JS string literal
+inline std::string vectorJsString(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c == '<') out += "\\u003c"; // no "</script>" inside the script
+        else if ((unsigned char)c < 0x20) out += ' ';
+        else out += c;
+    }
+    return out + "\"";
+}
+
+// Renderer of writeGridHtml: one <canvas> per pad, drawn from the decoded
+// Float32Array [replicas k * nX + x | lo x | hi x]
+const char* const kVectorHtmlRenderer = R"JS(
+(function () {
+  function dec(s) {
+    const b = atob(s), u = new Uint8Array(b.length);
+    for (let i = 0; i < b.length; i++) u[i] = b.charCodeAt(i);
+    return new Float32Array(u.buffer);
+  }
+  function ticks(y0, y1) {
+    const raw = (y1 - y0) / 5, mag = Math.pow(10, Math.floor(Math.log10(raw))), r = raw / mag;
+    const step = (r < 1.5 ? 1 : r < 3.5 ? 2 : r < 7.5 ? 5 : 10) * mag, out = [];
+    for (let t = Math.ceil(y0 / step - 1e-9) * step; t <= y1 + 1e-9 * step; t += step) out.push(+t.toPrecision(10));
+    return out;
+  }
+  const nX = FIG.xLabels.length, grid = document.getElementById('grid'), tip = document.getElementById('tip');
+  document.getElementById('note').textContent = FIG.note;
+  grid.style.gridTemplateColumns = 'repeat(' + FIG.cols + ',' + FIG.w + 'px)';
+
+  function geom(pad) {
+    const w = pad.cv.width, h = pad.cv.height;
+    const g = {ax: 0.15 * w, aw: 0.80 * w, ay: 0.05 * h, ah: 0.80 * h};
+    g.x = i => g.ax + g.aw * i / nX;
+    g.y = v => g.ay + g.ah - (v - pad.y0) / (pad.y1 - pad.y0) * g.ah;
+    return g;
+  }
+  function steps(ctx, g, v, off) {
+    for (let i = 0; i < nX; i++) {
+      const y = g.y(v[off + i]);
+      if (i == 0) ctx.moveTo(g.x(0), y); else ctx.lineTo(g.x(i), y);
+      ctx.lineTo(g.x(i + 1), y);
+    }
+  }
+  function draw(pad) {
+    const ctx = pad.cv.getContext('2d'), g = geom(pad), v = pad.v, h = pad.cv.height;
+    ctx.setLineDash([]);
+    ctx.fillStyle = '#fff'; ctx.fillRect(0, 0, pad.cv.width, h);
+    ctx.fillStyle = '#000'; ctx.font = FIG.label + 'px Helvetica,Arial,sans-serif';
+    ctx.textAlign = 'right'; ctx.textBaseline = 'middle';
+    for (const t of ticks(pad.y0, pad.y1)) ctx.fillText(String(t), g.ax - 4, g.y(t));
+    ctx.textAlign = 'center'; ctx.textBaseline = 'top';
+    for (let i = 0; i < nX; i++) ctx.fillText(FIG.xLabels[i], (g.x(i) + g.x(i + 1)) / 2, g.ay + g.ah + 4);
+
+    ctx.save();
+    ctx.beginPath(); ctx.rect(g.ax, g.ay, g.aw, g.ah); ctx.clip();
+    ctx.beginPath();
+    for (let k = 0; k < pad.nRep; k++) steps(ctx, g, v, k * nX);
+    ctx.strokeStyle = FIG.colors.replica; ctx.lineWidth = FIG.widths.replica; ctx.stroke();
+    ctx.beginPath(); steps(ctx, g, v, pad.nRep * nX); steps(ctx, g, v, (pad.nRep + 1) * nX);
+    ctx.strokeStyle = FIG.colors.envelope; ctx.lineWidth = FIG.widths.envelope; ctx.stroke();
+    ctx.beginPath(); ctx.moveTo(g.ax, g.y(FIG.nominal)); ctx.lineTo(g.ax + g.aw, g.y(FIG.nominal));
+    ctx.setLineDash([6, 4]); ctx.strokeStyle = FIG.colors.nominal; ctx.lineWidth = FIG.widths.nominal; ctx.stroke();
+    ctx.setLineDash([]);
+    if (pad.hover >= 0) {
+      ctx.beginPath(); steps(ctx, g, v, pad.hover * nX);
+      ctx.strokeStyle = '#f00'; ctx.lineWidth = 2; ctx.stroke();
+    }
+    ctx.restore();
+
+    ctx.strokeStyle = '#000'; ctx.lineWidth = 1; ctx.strokeRect(g.ax, g.ay, g.aw, g.ah);
+    ctx.fillStyle = '#000'; ctx.font = FIG.title + 'px Helvetica,Arial,sans-serif';
+    ctx.textAlign = 'left'; ctx.textBaseline = 'top';
+    ctx.fillText(pad.title, g.ax + 6, g.ay + 4);
+  }
+  function hover(pad, e) {
+    const r = pad.cv.getBoundingClientRect(), mx = e.clientX - r.left, my = e.clientY - r.top, g = geom(pad);
+    const i = Math.floor((mx - g.ax) / g.aw * nX);
+    let best = -1, dist = 6;
+    if (i >= 0 && i < nX) {
+      for (let k = 0; k < pad.nRep; k++) {
+        const d = Math.abs(g.y(pad.v[k * nX + i]) - my);
+        if (d < dist) { dist = d; best = k; }
+      }
+    }
+    if (best != pad.hover) { pad.hover = best; draw(pad); }
+    if (best < 0) { tip.style.display = 'none'; return; }
+    const v = pad.v, lo = v[pad.nRep * nX + i], hi = v[(pad.nRep + 1) * nX + i];
+    tip.textContent = pad.title + ', ' + FIG.xLabels[i] + ': replica ' + best + ' = ' + v[best * nX + i].toFixed(4) +
+                      ' (16th ' + lo.toFixed(4) + ', 84th ' + hi.toFixed(4) + ')';
+    tip.style.left = (e.clientX + 12) + 'px'; tip.style.top = (e.clientY + 12) + 'px'; tip.style.display = 'block';
+  }
+
+  for (const p of FIG.panels) {
+    const v = dec(p.data), cv = document.createElement('canvas');
+    const pad = {title: p.title, v: v, nRep: v.length / nX - 2, cv: cv, y0: FIG.yMin, y1: FIG.yMax, hover: -1, big: false};
+    const col = String(p.pad % FIG.cols + 1), row = String(Math.floor(p.pad / FIG.cols) + 1);
+    cv.width = FIG.w; cv.height = FIG.h; cv.style.gridColumn = col; cv.style.gridRow = row;
+    grid.appendChild(cv);
+    draw(pad);
+    cv.addEventListener('mousemove', e => hover(pad, e));
+    cv.addEventListener('mouseleave', () => { pad.hover = -1; tip.style.display = 'none'; draw(pad); });
+    // Wheel: zoom y around the cursor; double click: reset; click: enlarge / shrink the pad
+    cv.addEventListener('wheel', e => {
+      e.preventDefault();
+      const g = geom(pad), r = cv.getBoundingClientRect();
+      const yc = pad.y0 + (g.ay + g.ah - (e.clientY - r.top)) / g.ah * (pad.y1 - pad.y0), f = e.deltaY > 0 ? 1.25 : 0.8;
+      pad.y0 = yc - (yc - pad.y0) * f; pad.y1 = yc + (pad.y1 - yc) * f;
+      draw(pad);
+    }, {passive: false});
+    cv.addEventListener('dblclick', () => { pad.y0 = FIG.yMin; pad.y1 = FIG.yMax; draw(pad); });
+    cv.addEventListener('click', () => {
+      pad.big = !pad.big;
+      cv.width = pad.big ? FIG.w * FIG.cols : FIG.w; cv.height = pad.big ? FIG.h * 3 : FIG.h;
+      cv.style.gridColumn = pad.big ? '1 / -1' : col;
+      draw(pad);
+    });
+  }
+})();
+)JS";
+
+// Self-contained page: the arrays as base64 Float32 per panel, the
+// renderer inline (no external scripts). Pad size in CSS px = pt.
+inline bool writeGridHtml(const VectorFigure& fig, const std::string& title, const std::string& path, std::string& error) {
+    const int nX = std::max<int>(1, (int)fig.xLabels.size());
+    char buf[256];
+    std::string o;
+    o.reserve(1 << 20);
+    o += "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"><title>" + vectorXml(title) + "</title>\n<style>"
+         "body{font-family:Helvetica,Arial,sans-serif;margin:8px}#grid{display:grid;gap:4px}"
+         "canvas{border:1px solid #ccc;cursor:crosshair}#note{color:#c00;min-height:1em}"
+         "#tip{position:fixed;pointer-events:none;background:#fff;border:1px solid #888;padding:2px 4px;font-size:12px;display:none}"
+         "</style></head>\n<body><div>" + vectorXml(title) + " &mdash; hover: replica value, wheel: zoom y,"
+         " double click: reset, click: enlarge pad</div><div id=\"note\"></div><div id=\"grid\"></div><div id=\"tip\"></div>\n"
+         "<script>\nconst FIG = {";
+    snprintf(buf, sizeof(buf), "cols: %d, rows: %d, w: %ld, h: %ld, yMin: %.17g, yMax: %.17g, nominal: %.17g, label: %.3g, title: %.3g,\n",
+             fig.cols, fig.rows, lround(fig.padW), lround(fig.padH), fig.yMin, fig.yMax, fig.nominal,
+             fig.labelSize, fig.titleSize);
+    o += buf;
+    snprintf(buf, sizeof(buf), "colors: {replica: '%s', envelope: '%s', nominal: '%s'}, widths: {replica: %.3g, envelope: %.3g, nominal: %.3g},\n",
+             vectorSvgColor(fig.replicaColor).c_str(), vectorSvgColor(fig.envelopeColor).c_str(),
+             vectorSvgColor(fig.nominalColor).c_str(), fig.replicaWidth * 2, fig.envelopeWidth * 2, fig.nominalWidth * 2);
+    o += buf;
+    o += "note: " + vectorJsString(fig.note) + ",\nxLabels: [";
+    for (size_t i = 0; i < fig.xLabels.size(); ++i) o += (i ? ", " : "") + vectorJsString(fig.xLabels[i]);
+    o += "],\npanels: [\n";
+
+    std::vector<float> data;
+    for (const VectorPanel& p : fig.panels) {
+        if (p.pad < 0 || p.pad >= fig.cols * fig.rows) continue;
+        const size_t nRep = p.replicas.size() / nX;
+        data.assign(p.replicas.begin(), p.replicas.begin() + nRep * nX);
+        for (int x = 0; x < nX; ++x) data.push_back(x < (int)p.lo.size() ? (float)p.lo[x] : 0.f);
+        for (int x = 0; x < nX; ++x) data.push_back(x < (int)p.hi.size() ? (float)p.hi[x] : 0.f);
+        snprintf(buf, sizeof(buf), "{pad: %d, title: ", p.pad);
+        o += buf;
+        o += vectorJsString(p.title) + ", data: \"" + vectorBase64(data.data(), data.size() * sizeof(float)) + "\"},\n";
+    }
+    o += "]};\n</script>\n<script>";
+    o += kVectorHtmlRenderer;
+    o += "</script>\n</body></html>\n";
+    return writeVectorFile(path, o, error);
+}
+
+#endif // PDF_VECTOR_PLOT_H
@@ -0,0 +1,264 @@
+"""
+PDF Weight Tools - Python access (NumPy, zero-copy)
+File: pdf_weight.py
+
+[Purpose]
+- Prototype prescriptions in Python on the same data the C++ tools use,
+  without re-reading ROOT files through uproot.
+- Skims (*.pdfskim, make_pdf_skim.cpp) are memory-mapped: every cell
+  column and the [event][replica] weight block are NumPy views into the
+  file, nothing is copied (ratio16 skims: the weights are decoded into a
+  new array, see [Codec] in pdf_skim.h).
+- The flat [cell][replica] accumulator is a NumPy array; the C++ loop of
+  libpdfweight.so (pdf_weight_capi.cpp) adds straight into its buffer.
+
+[Usage]
+    import pdf_weight as pw
+    skim = pw.Skim("selected.pdfskim")
+    cell = skim.cell(pw.cell_key(36, 2))        # Bin 36, Mj 1100+
+    cell.weights                                  # (n, nReplicas) float32 view
+    sums = skim.accumulate(cut="njets >= 8")      # (56, nReplicas) float64
+    sums = skim.accumulate(threads=8)             # same, split over 8 threads
+    nominal, lo, hi = pw.envelopes(sums[:, :100])
+
+    # With a ROOT-enabled library build (-DPDFW_WITH_ROOT):
+    sums = pw.accumulate_ntuples(["final_output.root"], n_sum=100)
+
+compile the library first:
+    g++ -O2 -shared -fPIC -pthread -o libpdfweight.so pdf_weight_capi.cpp
+"""
+
+import ctypes
+import os
+from collections import namedtuple
+
+import numpy as np
+
+# --- Binning Definition (Same as the tools) ---
+BIN_NUMBERS = [22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 35, 36]
+MJ_LABELS = ["500-800", "800-1100", "1100+"]
+MJ_CLASSES = 4  # 3 Mj bins + "other" (mj12 < 500)
+N_CELLS = len(BIN_NUMBERS) * MJ_CLASSES
+
+_SKIM_MAGIC = b"PDFWSKIM"
+_HEADER = np.dtype([("magic", "S8"), ("version", "<u4"), ("n_cells", "<u4"),
+                    ("n_replicas", "<u4"), ("flags", "<u4"), ("n_events", "<u8"),
+                    ("cell_table_offset", "<u8"), ("replica_id_offset", "<u8"),
+                    ("cut_offset", "<u8"), ("ratio_min", "<f4"), ("ratio_step", "<f4")])
+_CODEC_FLOAT, _CODEC_RATIO16 = 0, 1
+_CELL_ENTRY = np.dtype([("offset", "<u8"), ("n_events", "<u8"), ("bytes", "<u8")])
+
+SkimCell = namedtuple("SkimCell", ["mj12", "njets", "nbm", "weights"])
+
+
+def cell_key(bin_number, mj_class):
+    """Cell index used by skims and accumulators (bIdx * 4 + mjClass)."""
+    return BIN_NUMBERS.index(bin_number) * MJ_CLASSES + mj_class
+
+
+def wanted_cells(bins=None, mj=None):
+    """64-bit cell mask for a --bins / --mj style restriction."""
+    if bins is None and mj is None:
+        return (1 << 64) - 1
+    b_list = [BIN_NUMBERS.index(b) for b in (bins or BIN_NUMBERS)]
+    m_list = [MJ_LABELS.index(m) if isinstance(m, str) else m
+              for m in (mj if mj is not None else range(MJ_CLASSES))]
+    mask = 0
+    for b in b_list:
+        for m in m_list:
+            mask |= 1 << (b * MJ_CLASSES + m)
+    return mask
+
+
+# --- Library ---
+_lib = None
+
+
+def load_library(path=None):
+    """Load libpdfweight.so (default: next to this file or $PDFW_LIB)."""
+    global _lib
+    if _lib is not None and path is None:
+        return _lib
+    path = path or os.environ.get("PDFW_LIB") or os.path.join(
+        os.path.dirname(os.path.abspath(__file__)), "libpdfweight.so")
+    lib = ctypes.CDLL(path)
+
+    dbl_p = np.ctypeslib.ndpointer(dtype=np.float64, flags="C_CONTIGUOUS")
+    lib.pdfw_skim_open.restype = ctypes.c_void_p
+    lib.pdfw_skim_open.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int]
+    lib.pdfw_skim_close.argtypes = [ctypes.c_void_p]
+    lib.pdfw_skim_accumulate.restype = ctypes.c_longlong
+    lib.pdfw_skim_accumulate.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64,
+                                         dbl_p, ctypes.c_int, ctypes.c_int,
+                                         ctypes.c_char_p, ctypes.c_int]
+    lib.pdfw_skim_accumulate_mt.restype = ctypes.c_longlong
+    lib.pdfw_skim_accumulate_mt.argtypes = [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_uint64,
+                                            dbl_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                            ctypes.c_char_p, ctypes.c_int]
+    lib.pdfw_envelopes.restype = ctypes.c_int
+    lib.pdfw_envelopes.argtypes = [dbl_p, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                   ctypes.c_int, ctypes.c_int, dbl_p, dbl_p, dbl_p]
+    if hasattr(lib, "pdfw_root_accumulate"):
+        lib.pdfw_root_accumulate.restype = ctypes.c_longlong
+        lib.pdfw_root_accumulate.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_int,
+                                             ctypes.c_char_p, ctypes.c_uint64, dbl_p,
+                                             ctypes.c_int, ctypes.c_int,
+                                             ctypes.c_char_p, ctypes.c_int]
+    _lib = lib
+    return lib
+
+
+def _check_accumulator(out, n_cells, n_sum):
+    if out is None:
+        return np.zeros((n_cells, n_sum), dtype=np.float64)
+    if out.dtype != np.float64 or not out.flags.c_contiguous or out.shape != (n_cells, n_sum):
+        raise ValueError("accumulator must be a C-contiguous float64 array of shape %s"
+                         % ((n_cells, n_sum),))
+    return out
+
+
+# --- Skims ---
+class Skim:
+    """Memory-mapped bin-partitioned skim; all arrays are views into the file."""
+
+    def __init__(self, path):
+        self.path = path
+        self._map = np.memmap(path, dtype=np.uint8, mode="r")
+        self.header = self._map[:_HEADER.itemsize].view(_HEADER)[0]
+        if self.header["magic"] != _SKIM_MAGIC or self.header["version"] != 1:
+            raise ValueError("%s is not a version 1 skim" % path)
+        self.codec = int(self.header["flags"])
+        if self.codec not in (_CODEC_FLOAT, _CODEC_RATIO16):
+            raise ValueError("%s uses an unknown weight codec" % path)
+
+        self.n_cells = int(self.header["n_cells"])
+        self.n_replicas = int(self.header["n_replicas"])
+        self.n_events = int(self.header["n_events"])
+
+        start = int(self.header["cell_table_offset"])
+        self.cells = self._map[start:start + self.n_cells * _CELL_ENTRY.itemsize].view(_CELL_ENTRY)
+
+        start = int(self.header["replica_id_offset"])
+        self.replica_ids = self._map[start:start + 2 * self.n_replicas].view("<u2")
+
+        start = int(self.header["cut_offset"])
+        cut_len = int(self._map[start:start + 4].view("<u4")[0])
+        self.cut = bytes(self._map[start + 4:start + 4 + cut_len]).decode()
+        self._handle = None
+
+    def cell(self, c):
+        """Views of one cell: mj12, njets, nbm, weights[n, nReplicas].
+
+        ratio16 skims: weights is decoded (float32 copy); the raw columns are
+        available from ratio_columns().
+        """
+        entry = self.cells[c]
+        base, n = int(entry["offset"]), int(entry["n_events"])
+        w_off = -(-(12 * n) // 64) * 64  # weights block aligned to 64 bytes
+        buf = self._map[base:base + int(entry["bytes"])]
+        if self.codec == _CODEC_RATIO16:
+            nominal, q = self.ratio_columns(c)
+            weights = np.empty((n, self.n_replicas), dtype=np.float32)
+            weights[:, 0] = nominal
+            weights[:, 1:] = nominal[:, None] * (self.header["ratio_min"] + q * self.header["ratio_step"])
+        else:
+            weights = buf[w_off:w_off + 4 * n * self.n_replicas].view("<f4").reshape(n, self.n_replicas)
+        return SkimCell(
+            mj12=buf[0:4 * n].view("<f4"),
+            njets=buf[4 * n:8 * n].view("<i4"),
+            nbm=buf[8 * n:12 * n].view("<i4"),
+            weights=weights,
+        )
+
+    def ratio_columns(self, c):
+        """ratio16 skims: zero-copy nominal[n] and uint16 ratios[n, nReplicas - 1]."""
+        if self.codec != _CODEC_RATIO16:
+            raise ValueError("%s stores float weights" % self.path)
+        entry = self.cells[c]
+        base, n = int(entry["offset"]), int(entry["n_events"])
+        w_off = -(-(12 * n) // 64) * 64
+        r_off = -(-(w_off + 4 * n) // 64) * 64
+        buf = self._map[base:base + int(entry["bytes"])]
+        nominal = buf[w_off:w_off + 4 * n].view("<f4")
+        q = buf[r_off:r_off + 2 * n * (self.n_replicas - 1)].view("<u2").reshape(n, self.n_replicas - 1)
+        return nominal, q
+
+    def accumulate(self, cut="", bins=None, mj=None, n_sum=None, out=None, threads=1):
+        """Run the C++ skim loop; returns the [cell][replica] sums (out is added to).
+
+        The sums are exact doubles; $PDFW_SKIM_SUM=float-block selects the faster
+        float-block kernel (pdf_skim.h), valid for weights of one sign only.
+        """
+        lib = load_library()
+        if self._handle is None:
+            err = ctypes.create_string_buffer(512)
+            self._handle = lib.pdfw_skim_open(self.path.encode(), err, len(err))
+            if not self._handle:
+                raise IOError(err.value.decode())
+
+        n_sum = n_sum or self.n_replicas
+        out = _check_accumulator(out, self.n_cells, n_sum)
+        err = ctypes.create_string_buffer(512)
+        n = lib.pdfw_skim_accumulate_mt(self._handle, cut.encode(), wanted_cells(bins, mj),
+                                        out, self.n_cells, n_sum, threads, err, len(err))
+        if n < 0:
+            raise ValueError(err.value.decode())
+        self.last_events = n
+        return out
+
+    def close(self):
+        if self._handle is not None:
+            load_library().pdfw_skim_close(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        try:
+            self.close()
+        except Exception:
+            pass
+
+
+# --- Ntuples (ROOT-enabled library only) ---
+def accumulate_ntuples(files, cut="nleps == 1", bins=None, mj=None, n_sum=100, out=None):
+    """Run the C++ block-wise ROOT event loop into a [56][n_sum] NumPy accumulator."""
+    lib = load_library()
+    if not hasattr(lib, "pdfw_root_accumulate"):
+        raise RuntimeError("libpdfweight.so was built without -DPDFW_WITH_ROOT")
+    out = _check_accumulator(out, N_CELLS, n_sum)
+    names = (ctypes.c_char_p * len(files))(*[f.encode() for f in files])
+    err = ctypes.create_string_buffer(512)
+    n = lib.pdfw_root_accumulate(names, len(files), cut.encode(), wanted_cells(bins, mj),
+                                 out, N_CELLS, n_sum, err, len(err))
+    if n < 0:
+        raise ValueError(err.value.decode())
+    if err.value:
+        print("[Warning] " + err.value.decode())
+    return out
+
+
+# --- Envelopes ---
+def envelope_ranks(n):
+    """0-based 16th / 84th percentile ranks for n replicas (100 -> 15, 83).
+
+    Same as envelopeRanks() in pdf_compress.h; use it for compressed skims
+    (compress_pdf_replicas.cpp), e.g. envelopes(sums, 1, *envelope_ranks(30)).
+    """
+    lo = max(0, 16 * n // 100 - 1)
+    hi = min(n - 1, max(0, (84 * n + 99) // 100 - 1))
+    return lo, hi
+
+
+def envelopes(sums, first=0, lo=15, hi=83):
+    """Per cell: nominal sum and the lo/hi ranked replica sums as ratios to it.
+
+    Defaults follow CG_mj_bin_v3 (100 weights incl. nominal, ranks 15 / 83).
+    """
+    sums = np.ascontiguousarray(sums, dtype=np.float64)
+    n_cells, n_rep = sums.shape
+    nominal = np.empty(n_cells)
+    ratio_lo = np.empty(n_cells)
+    ratio_hi = np.empty(n_cells)
+    if load_library().pdfw_envelopes(sums, n_cells, n_rep, first, lo, hi,
+                                     nominal, ratio_lo, ratio_hi) != 0:
+        raise ValueError("invalid envelope ranks for %d replicas" % (n_rep - first))
+    return nominal, ratio_lo, ratio_hi
@@ -0,0 +1,354 @@
+// -------------------------------------------------------------------------
+// PDF Weight Tools - C API for Python (libpdfweight.so)
+// File: pdf_weight_capi.cpp
+//
+// [Purpose]
+// - Lets Python (pdf_weight.py, ctypes + NumPy) drive the C++ loops and
+//   get the results without copies:
+//   - Skims are opened here and mapped by NumPy (np.memmap) on the
+//     Python side, so cell columns/weights are views into the file.
+//   - The flat [cell][replica] accumulator is a NumPy array owned by
+//     Python; the C++ loop adds directly into its buffer.
+//   - Envelopes (nominal, 16th/84th replica ratios) are written into
+//     NumPy arrays as well; the ranks of all cells are selected in one
+//     batched pass (pdf_percentile.h).
+// - pdfw_skim_accumulate_mt() splits the skim into chunks of events over
+//   several threads; the per-thread / shared atomic accumulator is chosen
+//   by size (pdf_accumulator.h). With $PDFW_SKIM_IO=uring|pread the cells
+//   are read by the queued reader and summed by the threads as they
+//   arrive (pdf_skim_io.h).
+// - Skim sums are exact (double); $PDFW_SKIM_SUM=float-block opts into
+//   the float-block kernel (pdf_skim.h, [Accumulation]), valid for
+//   weights of one sign.
+//
+// [Layout of the accumulator]
+//   sums[cell * nSum + k], cell = bIdx * 4 + mjClass (see pdf_region.h),
+//   k = index in the stored weight vector (0 = nominal).
+//
+// [ROOT Ntuples]
+// - Built with -DPDFW_WITH_ROOT, pdfw_root_accumulate() runs the same
+//   block-wise event loop as the plot tools (cut, lazy weight read,
+//   corrupted clusters skipped) straight into the NumPy accumulator;
+//   the next files are opened in the background (pdf_input_opener.h).
+//
+// compile (skims only): g++ -O2 -shared -fPIC -pthread -o libpdfweight.so pdf_weight_capi.cpp
+// compile (with ROOT):  g++ -O2 -shared -fPIC -pthread -DPDFW_WITH_ROOT -o libpdfweight.so pdf_weight_capi.cpp $(root-config --cflags --glibs)
+// -------------------------------------------------------------------------
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+#include "pdf_skim.h"
+#include "pdf_skim_io.h"
+#include "pdf_accumulator.h"
+#include "pdf_percentile.h"
+
+#ifdef PDFW_WITH_ROOT
+#include "pdf_event_loop.h"
+#include "pdf_input_opener.h"
+#endif
+
+using namespace std;
+
+// --- Binning Definition (Same as the plot tools) ---
+const int nBins = 14;
+const int binNumbers[nBins] = {
+    22, 23, 24, // Nb=0
+    25, 26, 27, // Nb=1
+    28, 29, 30, // Nb=2
+    31, 32, 33, // Nb=3
+    35, 36      // Nb>=4 (Bin 34 skipped)
+};
+
+// Helper: Get Array Index (0~13) from Bin Number
+static int getIdx(int binNum) {
+    for(int i=0; i<nBins; ++i) {
+        if(binNumbers[i] == binNum) return i;
+    }
+    return -1;
+}
+
+// Helper: Determine Bin Number
+static int getBinNumber(int njets, int nbm) {
+    int j_cat = -1;
+    if (njets >= 4 && njets <= 5) j_cat = 0;
+    else if (njets >= 6 && njets <= 7) j_cat = 1;
+    else if (njets >= 8) j_cat = 2;
+
+    if (j_cat == -1) return -1;
+
+    if (nbm == 0) return (22 + j_cat);
+    if (nbm == 1) return (25 + j_cat);
+    if (nbm == 2) return (28 + j_cat);
+    if (nbm == 3) return (31 + j_cat);
+    if (nbm >= 4) {
+        if (j_cat == 0) return 31; // Merged
+        if (j_cat == 1) return 35;
+        if (j_cat == 2) return 36;
+    }
+    return -1;
+}
+
+// Helper: Copy an error message into the caller's buffer
+static void setError(char* err, int errlen, const string& msg) {
+    if (!err || errlen <= 0) return;
+    size_t n = std::min<size_t>(msg.size(), (size_t)errlen - 1);
+    std::memcpy(err, msg.data(), n);
+    err[n] = '\0';
+}
+
+extern "C" {
+
+// --- Binning ---
+int pdfw_n_bins() { return nBins; }
+int pdfw_bin_number(int bIdx) { return (bIdx >= 0 && bIdx < nBins) ? binNumbers[bIdx] : -1; }
+int pdfw_bin_index(int njets, int nbm) { return getIdx(getBinNumber(njets, nbm)); }
+
+// --- Skims ---
+void* pdfw_skim_open(const char* path, char* err, int errlen) {
+    SkimReader* skim = new SkimReader;
+    string error;
+    if (!skim->Open(path, error)) {
+        setError(err, errlen, error);
+        delete skim;
+        return nullptr;
+    }
+    return skim;
+}
+
+void pdfw_skim_close(void* handle) {
+    delete static_cast<SkimReader*>(handle);
+}
+
+// Accumulate the first nSum weights of the selected events into
+// sums[nCells][nSum]. Returns the number of events added, -1 on error.
+long long pdfw_skim_accumulate(void* handle, const char* cut, uint64_t wantedCells,
+                               double* sums, int nCells, int nSum, char* err, int errlen) {
+    const SkimReader* skim = static_cast<SkimReader*>(handle);
+    if (!skim || !skim->IsOpen()) { setError(err, errlen, "skim not open"); return -1; }
+    if (nCells < skim->NCells() || nSum > skim->NReplicas()) {
+        setError(err, errlen, "accumulator shape does not match the skim");
+        return -1;
+    }
+
+    Selection sel;
+    string error;
+    if (!sel.Compile(cut ? cut : "", error)) { setError(err, errlen, "invalid cut: " + error); return -1; }
+
+    const int floatBlock = skimFloatBlockFromEnv();
+    long long added = 0;
+    bool ok = forEachSkimCell(*skim, wantedCells, sel, kSkimBlockSize, error,
+        [&](int c, const SkimCell& cell, const unsigned char* mask) {
+            accumulateSkimCell(cell, mask, nSum, sums + (size_t)c * nSum, floatBlock);
+            if (!mask) { added += cell.n; return; }
+            for (uint64_t e = 0; e < cell.n; ++e) added += mask[e];
+        });
+    if (!ok) { setError(err, errlen, error); return -1; }
+    return added;
+}
+
+// Same as pdfw_skim_accumulate with nThreads threads (events of a cell are
+// split into chunks of kSkimThreadChunk). Returns the number of events added.
+const uint64_t kSkimThreadChunk = 16384;
+
+long long pdfw_skim_accumulate_mt(void* handle, const char* cut, uint64_t wantedCells,
+                                  double* sums, int nCells, int nSum, int nThreads, char* err, int errlen) {
+    SkimIoOptions io;
+    io.backend = skimIoBackendFromEnv();
+    if (nThreads <= 1 && io.backend == SkimIoBackend::Mmap)
+        return pdfw_skim_accumulate(handle, cut, wantedCells, sums, nCells, nSum, err, errlen);
+
+    const SkimReader* skim = static_cast<SkimReader*>(handle);
+    if (!skim || !skim->IsOpen()) { setError(err, errlen, "skim not open"); return -1; }
+    if (nCells < skim->NCells() || nSum > skim->NReplicas()) {
+        setError(err, errlen, "accumulator shape does not match the skim");
+        return -1;
+    }
+
+    Selection sel;
+    string error;
+    if (!sel.Compile(cut ? cut : "", error)) { setError(err, errlen, "invalid cut: " + error); return -1; }
+
+    const int floatBlock = skimFloatBlockFromEnv();
+
+    // Queued reader: the threads sum the parts of the cells as their reads complete
+    if (io.backend != SkimIoBackend::Mmap) {
+        const int nWorkers = std::max(1, nThreads);
+        ParallelAccumulator acc(skim->NCells(), nSum, nWorkers);
+        vector<vector<double>> partial(nWorkers, vector<double>(nSum));
+        vector<long long> added(nWorkers, 0);
+        bool ok = streamSkimCells(*skim, wantedCells, sel, kSkimBlockSize, io, nWorkers, error,
+            [&](int w, int c, const SkimCell& part, const unsigned char* mask) {
+                std::fill(partial[w].begin(), partial[w].end(), 0.0);
+                accumulateSkimCell(part, mask, nSum, partial[w].data(), floatBlock);
+                acc.Add(w, c, partial[w].data());
+                if (!mask) { added[w] += part.n; return; }
+                for (uint64_t e = 0; e < part.n; ++e) added[w] += mask[e];
+            });
+        if (!ok) { setError(err, errlen, error); return -1; }
+        acc.MergeInto(sums);
+        long long total = 0;
+        for (long long a : added) total += a;
+        return total;
+    }
+
+    // Work items: (cell, first event); pass masks are evaluated up front
+    struct Chunk { int cell; uint64_t first; uint64_t n; };
+    vector<Chunk> chunks;
+    vector<vector<unsigned char>> masks(skim->NCells());
+    bool ok = forEachSkimCell(*skim, wantedCells, sel, kSkimBlockSize, error,
+        [&](int c, const SkimCell& cell, const unsigned char* mask) {
+            if (mask) masks[c].assign(mask, mask + cell.n);
+            for (uint64_t first = 0; first < cell.n; first += kSkimThreadChunk)
+                chunks.push_back({c, first, std::min(kSkimThreadChunk, cell.n - first)});
+        });
+    if (!ok) { setError(err, errlen, error); return -1; }
+
+    ParallelAccumulator acc(skim->NCells(), nSum, nThreads);
+    std::atomic<size_t> next(0);
+    std::atomic<long long> added(0);
+    vector<std::thread> workers;
+    for (int t = 0; t < nThreads; ++t) {
+        workers.emplace_back([&, t]() {
+            vector<double> partial(nSum);
+            long long n_added = 0;
+            for (size_t i = next++; i < chunks.size(); i = next++) {
+                const Chunk& ch = chunks[i];
+                SkimCell cell = skim->Cell(ch.cell).Events(ch.first, ch.n);
+                const unsigned char* mask = masks[ch.cell].empty() ? nullptr : masks[ch.cell].data() + ch.first;
+
+                std::fill(partial.begin(), partial.end(), 0.0);
+                accumulateSkimCell(cell, mask, nSum, partial.data(), floatBlock);
+                acc.Add(t, ch.cell, partial.data());
+                if (!mask) n_added += ch.n;
+                else for (uint64_t e = 0; e < ch.n; ++e) n_added += mask[e];
+            }
+            added += n_added;
+        });
+    }
+    for (auto& w : workers) w.join();
+
+    acc.MergeInto(sums);
+    return added;
+}
+
+// --- Envelopes ---
+// For every cell: nominal = sums[c][0]; replicas [first, nRep) are sorted
+// and the values at ranks lo / hi are returned as ratios to the nominal
+// (CG_mj_bin_v3: first = 0, lo = 15, hi = 83).
+int pdfw_envelopes(const double* sums, int nCells, int nRep, int first, int lo, int hi,
+                   double* nominal, double* ratio_lo, double* ratio_hi) {
+    int nSorted = nRep - first;
+    if (first < 0 || lo < 0 || hi < lo || hi >= nSorted) return -1;
+
+    // All cells through one batched rank network (pdf_percentile.h)
+    PercentileNetwork network(nSorted, {lo, hi});
+    vector<double> ranked((size_t)nCells * 2);
+    network.Select(sums + first, nCells, nRep, ranked.data());
+
+    for (int c = 0; c < nCells; ++c) {
+        double nom_sum = sums[(size_t)c * nRep];
+        nominal[c] = nom_sum;
+        if (nom_sum == 0) nom_sum = 1.0; // Safety
+
+        ratio_lo[c] = ranked[(size_t)c * 2] / nom_sum;
+        ratio_hi[c] = ranked[(size_t)c * 2 + 1] / nom_sum;
+    }
+    return 0;
+}
+
+// --- ROOT Ntuples ---
+#ifdef PDFW_WITH_ROOT
+// Run the block-wise event loop over ntuple files into sums[nCells][nSum].
+// Returns the number of events read cleanly, -1 on a setup error.
+long long pdfw_root_accumulate(const char** files, int nFiles, const char* cut, uint64_t wantedCells,
+                               double* sums, int nCells, int nSum, char* err, int errlen) {
+    if (nCells < nBins * kMjClasses) { setError(err, errlen, "accumulator needs 56 cells"); return -1; }
+
+    Selection sel;
+    string error;
+    if (!sel.Compile(cut ? cut : "", error)) { setError(err, errlen, "invalid cut: " + error); return -1; }
+
+    vector<string> columns = {"njets", "nbm", "mj12"};
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+    sel.Bind(columns, error);
+
+    RegionFilter region;
+    region.wanted = wantedCells;
+
+    // Per-cluster staging, added to the NumPy buffer once a cluster was read cleanly
+    vector<double> cluster_sums((size_t)nCells * nSum, 0.0);
+    auto resetCluster = [&]() { std::fill(cluster_sums.begin(), cluster_sums.end(), 0.0); };
+
+    SkipLog skip_log;
+    string first_reason; // first setup error, passed on in err (the rest is printed)
+    InputOpener opener(vector<string>(files, files + nFiles), kDefaultOpenAhead); // see pdf_input_opener.h
+    for (int f = 0; f < nFiles; ++f) {
+        string filename = files[f];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
+        }
+
+        BlockReader reader;
+        string read_error;
+        TBranch* payload = tree->GetBranch("weight");
+        if (!payload) read_error = "'weight' branch is required!";
+        if (!payload || !reader.Setup(tree, columns, kDefaultBlockSize, read_error)) {
+            cout << "[Error] " << read_error << " (" << filename << " skipped)" << endl;
+            if (first_reason.empty()) first_reason = filename + ": " + read_error;
+            skip_log.bad_files.push_back(filename);
+            file->Close();
+            delete file;
+            continue;
+        }
+        vector<float>* weight_vec = nullptr;
+        tree->SetBranchAddress("weight", &weight_vec);
+
+        resetCluster();
+        processSelectedBlocks(tree, filename, skip_log, reader, sel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(0, row), (int)reader.Get(1, row)));
+                return bIdx != -1 && region.WantCell(bIdx, cellMjClass(reader.Get(2, row)));
+            },
+            [&](Long64_t, int row) {
+                if (!weight_vec || (int)weight_vec->size() < nSum) return;
+                int bIdx = getIdx(getBinNumber((int)reader.Get(0, row), (int)reader.Get(1, row)));
+                if (bIdx == -1) return;
+                double* s = cluster_sums.data() + (size_t)cellKey(bIdx, cellMjClass(reader.Get(2, row))) * nSum;
+                const float* w = weight_vec->data();
+                for (int k = 0; k < nSum; ++k) s[k] += w[k];
+            },
+            [&]() {
+                for (size_t i = 0; i < cluster_sums.size(); ++i) sums[i] += cluster_sums[i];
+                resetCluster();
+            },
+            resetCluster);
+
+        tree->ResetBranchAddresses();
+        delete weight_vec;
+        file->Close();
+        delete file;
+    }
+
+    skip_log.Print();
+    if (skip_log.HasSkips())
+        setError(err, errlen, skip_log.Summary() + (first_reason.empty() ? "" : " (" + first_reason + ")"));
+    return skip_log.nReadEvents;
+}
+#endif
+
+} // extern "C"
@@ -12,16 +12,43 @@
 // 3. Bin Loop (Filling):
 //    - Fill the dynamically created Heatmap.
 //
+// [Input]
+// - Several input files may be given. Unreadable files and corrupted
+//   clusters are skipped, recorded and summarized (stdout + plot note).
+// - Cuts are a compiled --cut expression (default "nleps == 1"),
+//   evaluated per block of --block entries before the weights are read.
+// - --bins restrict the run to the given cells; a per-cluster
+//   index (<input>.cellidx) lets whole clusters be skipped unread.
+// - --autotune times short probes over the first clusters to pick the read
+//   settings (threads, block size, TTreeCache, prefetch) and stores them
+//   per host and storage class for later runs (pdf_autotune.h).
+// - --weights-file a_w.root,... reads 'sys_pdf' from separate files, one
+//   per ROOT input, aligned entry by entry with it (pdf_event_loop.h).
+// - --open-ahead N opens the next N ROOT inputs in the background while
+//   one is read (pdf_input_opener.h).
+// - --mem-budget 2G bounds the collected values: a bin that outgrows its
+//   share (budget / 14) continues in a bounded-error quantile sketch and
+//   is filled with the weighted sketch values (pdf_quantile_sketch.h).
+// - --threads N reads each input in N cluster-aligned entry ranges, one
+//   worker per range with its own file handles; a cleanly read cluster is
+//   spliced into the shared bins under a lock (chunk lists, no copies).
+//   The heatmap is filled chunk by chunk into per-thread partial TH2Ds
+//   that are added at the end (pdf_event_loop.h, [Threads]).
+//
 // compile: g++ -o plot_pdf_variations_BJ_v3.exe plot_pdf_variations_BJ_v3.cpp $(root-config --cflags --glibs)
-// run: ./plot_pdf_variations_BJ_v3.exe final_output.root
+// run: ./plot_pdf_variations_BJ_v3.exe final_output.root [more_files.root ...]
 // -------------------------------------------------------------------------
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm> // for min/max
+#include <thread>
+#include <mutex>
 
+#include "TROOT.h"
 #include "TFile.h"
 #include "TTree.h"
 #include "TH2D.h"
@@ -30,6 +57,12 @@
 #include "TStyle.h"
 #include "TString.h"
 #include "TLine.h"
+#include "TLatex.h"
+
+#include "pdf_event_loop.h"
+#include "pdf_autotune.h"
+#include "pdf_input_opener.h"
+#include "pdf_quantile_sketch.h"
 
 using namespace std;
 
@@ -81,76 +114,290 @@ int main(int argc, char* argv[]) {
     gStyle->SetPalette(kBird);
     gStyle->SetNumberContours(255);
 
-    if (argc < 2) {
-        cout << "Usage: ./plot_pdf_variations_BJ_v3.exe [root_file]" << endl;
-        return 1;
+    // --- Options ---
+    string cut = "nleps == 1";
+    int blockSize = kDefaultBlockSize;
+    bool block_given = false, autotune = false;
+    int open_ahead = kDefaultOpenAhead;
+    string bins_arg;
+    string weights_arg;
+    size_t mem_budget = 0; // bytes, 0 = unlimited
+    int nThreads = 1;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cut" && i + 1 < argc) cut = argv[++i];
+        else if (arg == "--block" && i + 1 < argc) { blockSize = atoi(argv[++i]); block_given = true; }
+        else if (arg == "--autotune") autotune = true;
+        else if (arg == "--open-ahead" && i + 1 < argc) open_ahead = atoi(argv[++i]);
+        else if (arg == "--weights-file" && i + 1 < argc) weights_arg = argv[++i];
+        else if (arg == "--bins" && i + 1 < argc) bins_arg = argv[++i];
+        else if (arg == "--mem-budget" && i + 1 < argc) {
+            mem_budget = parseByteSize(argv[++i]);
+            if (mem_budget == 0) { cout << "[Error] Invalid --mem-budget: " << argv[i] << endl; return 1; }
+        }
+        else if (arg == "--threads" && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else inputs.push_back(arg);
     }
+    if (blockSize < 1) blockSize = kDefaultBlockSize;
+    if (nThreads < 1) nThreads = 1;
 
-    TString filename = argv[1];
-    TFile* file = TFile::Open(filename, "READ");
-    if (!file || file->IsZombie()) {
-        cout << "Error opening file: " << filename << endl;
+    if (inputs.empty()) {
+        cout << "Usage: ./plot_pdf_variations_BJ_v3.exe [--cut \"nleps == 1\"] [--block N] [--autotune] [--open-ahead N] [--weights-file w.root,...] [--bins 35,36] [--mem-budget 2G] [--threads N] [root_file ...]" << endl;
         return 1;
     }
 
-    TTree* tree = (TTree*)file->Get("tree");
-    if (!tree) {
-        cout << "Tree 'tree' not found!" << endl;
+    // --- Weights Friend Files (--weights-file, one per ROOT input, in order) ---
+    vector<string> weight_files = splitList(weights_arg);
+    const size_t n_root_inputs = inputs.size();
+    if (!weight_files.empty() && weight_files.size() != n_root_inputs) {
+        cout << "[Error] --weights-file needs one file per ROOT input (" << n_root_inputs << "), got "
+             << weight_files.size() << endl;
         return 1;
     }
 
-    // --- Branch Setup ---
-    vector<float> *sys_pdf = nullptr;
-    int nleps, njets, nbm;
+    // --- Selection (compiled once, evaluated per block of entries) ---
+    Selection sel;
+    string sel_error;
+    if (!sel.Compile(cut, sel_error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << sel_error << endl;
+        return 1;
+    }
+    cout << "Selection: " << (sel.IsTrivial() ? "(none)" : cut) << endl;
 
-    tree->SetBranchAddress("nleps", &nleps);
-    tree->SetBranchAddress("njets", &njets);
-    tree->SetBranchAddress("nbm", &nbm);
+    // Block columns: binning variables first, then whatever the cut uses
+    vector<string> columns = {"njets", "nbm"};
+    const int cNjets = 0, cNbm = 1;
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+    sel.Bind(columns, sel_error);
+
+    // --- Region Restriction (--bins) ---
+    RegionFilter region;
+    if (!bins_arg.empty()) {
+        vector<int> wanted_bins;
+        for (const string& item : splitList(bins_arg)) {
+            int bIdx = getIdx(atoi(item.c_str()));
+            if (bIdx == -1) {
+                cout << "[Error] Unknown bin in --bins: " << item << endl;
+                return 1;
+            }
+            wanted_bins.push_back(bIdx);
+        }
+        if (wanted_bins.empty()) for (int b = 0; b < nBins; ++b) wanted_bins.push_back(b);
 
-    if (tree->GetBranch("sys_pdf")) {
-        tree->SetBranchAddress("sys_pdf", &sys_pdf);
-    } else {
-        cout << "[Error] 'sys_pdf' branch is required!" << endl;
-        return 1;
+        region.wanted = 0;
+        for (int b : wanted_bins)
+            for (int m = 0; m < kMjClasses; ++m) region.wanted |= cellBit(b, m);
+        cout << "Region: " << wanted_bins.size() << " bins" << endl;
     }
 
     // --- Data Storage ---
     // [BinIndex] -> List of sys_pdf values
-    vector<vector<double>> bin_data(nBins);
+    // (a quantile sketch once a bin outgrows its share of --mem-budget)
+    // (values live in 64 KiB arena chunks, pdf_value_arena.h)
+    ValueArena arena;
+    vector<BinValues> bin_data(nBins);
+    for (auto& values : bin_data) values.SetStorage(&arena, mem_budget / nBins);
 
     // Variables for Dynamic Range
     double y_min = 1.0e9;  // Initialize with large number
     double y_max = -1.0e9; // Initialize with small number
 
-    // --- Step 1: Event Loop (Collect & Find Min/Max) ---
-    Long64_t nentries = tree->GetEntries();
-    cout << "Step 1: Collecting events from " << nentries << " entries..." << endl;
+    SkipLog skip_log;
+    std::mutex merge_mutex; // guards bin_data and y_min / y_max across workers
+
+    // Read settings per storage class (--autotune / stored, see pdf_autotune.h)
+    ReadTuner tuner("BJ_v3", autotune, blockSize, block_given);
+    if (nThreads > 1) ROOT::EnableThreadSafety();
+
+    // --- Step 1 Worker: Collect the clusters in [first, last) of one input ---
+    // Own reader, 'sys_pdf' buffer and per-cluster staging; tree == nullptr
+    // opens its own handles. Returns false (read_error set) if the branches
+    // cannot be set up.
+    auto collectRange = [&](TTree* tree, const string& filename, const string& weights_name,
+                            const ReadConfig& read_cfg, Long64_t first, Long64_t last,
+                            SkipLog& log, string& read_error) {
+        TFile* file = nullptr;
+        string payload_name = weights_name.empty() ? "sys_pdf" : "";
+        if (!tree) {
+            SkipLog open_log; // recorded as a skipped range by the caller
+            tree = openInputTree(filename, file, open_log);
+            if (!tree) { read_error = "cannot reopen " + filename; return false; }
+            applyReadConfig(tree, read_cfg, columns, payload_name);
+        }
 
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-        if (!sys_pdf || sys_pdf->size() < 2) continue;
+        // --- Branch Setup ---
+        // Scalars are read block-wise by the reader, 'sys_pdf' only for passing events
+        BlockReader reader;
+        TFile* weights_file = nullptr;
+        TTree* weights_tree = weights_name.empty() ? tree : openWeightsFriend(weights_name, tree, weights_file, read_error);
+        TBranch* payload = weights_tree ? weights_tree->GetBranch("sys_pdf") : nullptr;
+        if (!payload && read_error.empty()) read_error = "'sys_pdf' branch is required!";
+        if (!payload || !reader.Setup(tree, columns, read_cfg.blockSize, read_error)) {
+            closeInput(weights_file);
+            closeInput(file);
+            return false;
+        }
+        vector<float> *sys_pdf = nullptr;
+        if (weights_file) applyReadConfig(weights_tree, read_cfg, {}, "sys_pdf");
+        weights_tree->SetBranchAddress("sys_pdf", &sys_pdf);
+
+        // Per-cluster staging: only appended to bin_data once a cluster was read cleanly
+        // (spliced into bin_data chunk by chunk, no copies)
+        vector<ChunkedValues> cluster_data(nBins);
+        for (auto& v : cluster_data) v.SetArena(&arena);
+        double cluster_min = 1.0e9, cluster_max = -1.0e9;
+        auto resetCluster = [&]() {
+            for (auto& v : cluster_data) v.Clear();
+            cluster_min = 1.0e9; cluster_max = -1.0e9;
+        };
+
+        // Own copy of the selection: Evaluate() writes its scratch masks
+        Selection wsel = sel;
+        processSelectedBlocks(tree, filename, log, reader, wsel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(cNjets, row), (int)reader.Get(cNbm, row)));
+                return bIdx != -1 && region.WantBin(bIdx);
+            },
+            [&](Long64_t, int row) {
+                if (!sys_pdf || sys_pdf->size() < 2) return;
+
+                int njets = (int)reader.Get(cNjets, row);
+                int nbm   = (int)reader.Get(cNbm, row);
+                int binNum = getBinNumber(njets, nbm);
+                if (binNum == -1) return;
+                int bIdx = getIdx(binNum);
+                if (bIdx == -1) return;
+
+                double val_up   = sys_pdf->at(0);
+                double val_down = sys_pdf->at(1);
+
+                // Store data
+                cluster_data[bIdx].push_back(val_up);
+                cluster_data[bIdx].push_back(val_down);
+
+                // Check Min/Max
+                if (val_up < cluster_min) cluster_min = val_up;
+                if (val_up > cluster_max) cluster_max = val_up;
+
+                if (val_down < cluster_min) cluster_min = val_down;
+                if (val_down > cluster_max) cluster_max = val_down;
+            },
+            [&]() {
+                std::lock_guard<std::mutex> lock(merge_mutex);
+                for (int b = 0; b < nBins; ++b) bin_data[b].Append(cluster_data[b]);
+                if (cluster_min < y_min) y_min = cluster_min;
+                if (cluster_max > y_max) y_max = cluster_max;
+                resetCluster();
+            },
+            resetCluster, first, last);
+
+        weights_tree->ResetBranchAddresses();
+        delete sys_pdf;
+        closeInput(weights_file);
+        closeInput(file);
+        return true;
+    };
+
+    // Inputs opened ahead of the loop (--open-ahead, see pdf_input_opener.h)
+    InputOpener opener(inputs, open_ahead);
+
+    size_t root_index = 0;
+    for (const string& filename : inputs) {
+        string weights_name = weight_files.empty() ? "" : weight_files[root_index++];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+
+        // Cluster index: only needed to skip clusters in a restricted run
+        // (built before any branch address is set)
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
+        }
 
-        if (nleps != 1) continue;
+        // --- Read Settings ---
+        // (with a weights file, the payload is read from the friend tree)
+        string payload_name = weights_name.empty() ? "sys_pdf" : "";
+        ReadConfig read_cfg = tuner.Get(filename, tree, columns, sel, payload_name);
+        applyReadConfig(tree, read_cfg, columns, payload_name);
+
+        // --- Step 1: Event Loop (Collect & Find Min/Max, Cluster by Cluster) ---
+        // --threads N: worker t reads the t-th cluster-aligned entry range,
+        // worker 0 through the handles opened here, the others through their own
+        Long64_t nentries = tree->GetEntries();
+        auto ranges = clusterRanges(tree, nThreads);
+        if (ranges.empty()) ranges.push_back({0, nentries});
+        cout << "Step 1: Collecting events from " << nentries << " entries (" << filename << ", "
+             << ranges.size() << (ranges.size() > 1 ? " threads" : " thread") << ")..." << endl;
+
+        vector<SkipLog> logs(ranges.size());
+        vector<string> errors(ranges.size());
+        vector<char> setup_ok(ranges.size(), 0);
+        vector<std::thread> workers;
+        for (size_t t = 1; t < ranges.size(); ++t) {
+            workers.emplace_back([&, t]() {
+                setup_ok[t] = collectRange(nullptr, filename, weights_name, read_cfg,
+                                           ranges[t].first, ranges[t].second, logs[t], errors[t]);
+            });
+        }
+        setup_ok[0] = collectRange(tree, filename, weights_name, read_cfg,
+                                   ranges[0].first, ranges[0].second, logs[0], errors[0]);
+        for (auto& w : workers) w.join();
+
+        // The values of every range that was read are already in bin_data, so
+        // the file only counts as skipped when no range could be set up
+        if (std::count(setup_ok.begin(), setup_ok.end(), 0) == (long)ranges.size()) {
+            cout << "[Error] " << errors[0] << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+        } else {
+            for (size_t t = 0; t < ranges.size(); ++t) {
+                // A range whose handles could not be set up counts as skipped
+                if (!setup_ok[t]) {
+                    logs[t].bad_ranges.push_back({filename, ranges[t].first, ranges[t].second, errors[t]});
+                    logs[t].nSkippedEvents += ranges[t].second - ranges[t].first;
+                }
+                skip_log.Merge(logs[t]);
+            }
+        }
 
-        int binNum = getBinNumber(njets, nbm);
-        if (binNum == -1) continue;
-        int bIdx = getIdx(binNum);
-        if (bIdx == -1) continue;
+        file->Close();
+        delete file;
+    }
 
-        double val_up   = sys_pdf->at(0);
-        double val_down = sys_pdf->at(1);
+    skip_log.Print();
 
-        // Store data
-        bin_data[bIdx].push_back(val_up);
-        bin_data[bIdx].push_back(val_down);
+    uint64_t n_values = 0;
+    for (const auto& values : bin_data) n_values += values.Count();
+    cout << Form("Collected %llu values: %.1f MiB arena, peak RSS %.1f MiB", (unsigned long long)n_values,
+                 arena.Bytes() / 1048576.0, peakRssBytes() / 1048576.0) << endl;
 
-        // Check Min/Max
-        if (val_up < y_min) y_min = val_up;
-        if (val_up > y_max) y_max = val_up;
+    // Sketched bins: sorted sketch values, one bin per task (--threads)
+    parallelFor(nBins, nThreads, [&](size_t b, int) { bin_data[b].Finalize(); });
 
-        if (val_down < y_min) y_min = val_down;
-        if (val_down > y_max) y_max = val_down;
+    // --- Memory Budget Report (--mem-budget) ---
+    string sketch_note;
+    if (mem_budget > 0) {
+        cout << Form("Memory budget: %.1f MiB (%.1f MiB per bin)", mem_budget / 1048576.0,
+                     mem_budget / 1048576.0 / nBins) << endl;
+    }
+    for (int b = 0; b < nBins; ++b) {
+        const BinValues& values = bin_data[b];
+        if (!values.Sketched()) continue;
+
+        // A heatmap cell counts the values in a range: off by at most 2 x rank error
+        double N = (double)values.Count();
+        cout << Form("  Bin %d approximated: %.0f values in a sketch (k = %zu, %.1f MiB), rank error <= %.0f (%.3g%%),"
+                     " heatmap cells within +-%.0f entries",
+                     binNumbers[b], N, values.Sketch()->K(), values.Bytes() / 1048576.0,
+                     values.RankError(), 100.0 * values.RankError() / N, 2 * values.RankError()) << endl;
+        sketch_note += Form("%s%d", sketch_note.empty() ? "" : ", ", binNumbers[b]);
     }
+    if (mem_budget > 0 && sketch_note.empty()) cout << "  All bins exact" << endl;
 
     // Safety check if no data found
     if (y_min > y_max) {
@@ -172,14 +419,38 @@ int main(int argc, char* argv[]) {
     TH2D* h_map = new TH2D("h_map", "", nBins, 0, nBins, nYbins, y_min, y_max);
 
     // --- Step 2: Bin Loop (Fill) ---
+    // One task per arena chunk of an exact bin, one per sketched bin; each
+    // thread fills its own partial heatmap, added into h_map at the end
     cout << "Step 2: Filling Heatmap..." << endl;
 
+    vector<pair<int, size_t>> fill_tasks; // (bin, chunk)
     for (int b = 0; b < nBins; ++b) {
-        vector<double>& values = bin_data[b];
+        if (bin_data[b].Sketched()) { fill_tasks.push_back({b, 0}); continue; }
+        for (size_t c = 0; c < bin_data[b].Exact().Chunks(); ++c) fill_tasks.push_back({b, c});
+    }
 
-        for (double val : values) {
-            h_map->Fill(b + 0.5, val);
+    vector<TH2D*> h_parts(nThreads);
+    for (int t = 0; t < nThreads; ++t) {
+        h_parts[t] = (TH2D*)h_map->Clone(Form("h_map_part%d", t));
+        h_parts[t]->SetDirectory(nullptr);
+    }
+    parallelFor(fill_tasks.size(), nThreads, [&](size_t i, int t) {
+        int b = fill_tasks[i].first;
+        const BinValues& bin_values = bin_data[b];
+        if (bin_values.Sketched()) {
+            // Sketch values stand for 2^level values each
+            vector<pair<double, double>> items;
+            bin_values.Items(items);
+            for (const auto& it : items) h_parts[t]->Fill(b + 0.5, it.first, it.second);
+            return;
         }
+        const double* values = bin_values.Exact().ChunkData(fill_tasks[i].second);
+        size_t n = bin_values.Exact().ChunkSize(fill_tasks[i].second);
+        for (size_t k = 0; k < n; ++k) h_parts[t]->Fill(b + 0.5, values[k]);
+    });
+    for (TH2D* h : h_parts) {
+        h_map->Add(h);
+        delete h;
     }
 
     // --- Drawing ---
@@ -213,6 +484,18 @@ int main(int argc, char* argv[]) {
     leg->AddEntry(line, "Nominal (1.0)", "l");
     leg->Draw();
 
+    // Note skipped input on the plot itself
+    if (skip_log.HasSkips()) {
+        TLatex note;
+        note.SetNDC(); note.SetTextSize(0.03); note.SetTextColor(kRed);
+        note.DrawLatex(0.10, 0.92, skip_log.Summary().c_str());
+    }
+    if (!sketch_note.empty()) {
+        TLatex note;
+        note.SetNDC(); note.SetTextSize(0.03); note.SetTextColor(kRed);
+        note.DrawLatex(0.10, 0.955, ("Quantile sketch (--mem-budget): Bin " + sketch_note).c_str());
+    }
+
     c1->SaveAs("pdf_variations_BJ_v3.png");
     c1->SaveAs("pdf_variations_BJ_v3.pdf");
 
@@ -221,6 +504,5 @@ int main(int argc, char* argv[]) {
     delete h_map;
     delete line;
     delete c1;
-    file->Close();
     return 0;
 }
@@ -6,16 +6,51 @@
 // - Replaced TH1D with TLine for drawing events.
 // - Removes unwanted vertical lines connecting to y=0.
 //
+// [Input]
+// - Several input files may be given. Unreadable files and corrupted
+//   clusters are skipped, recorded and summarized (stdout + plot note).
+// - Cuts are a compiled --cut expression (default "nleps == 1"),
+//   evaluated per block of --block entries before the weights are read.
+// - --bins restrict the run to the given cells; a per-cluster
+//   index (<input>.cellidx) lets whole clusters be skipped unread.
+// - Bin-partitioned skims (*.pdfskim, make_pdf_skim.cpp) are accepted as
+//   input; only the requested cells are touched. $PDFW_SKIM_IO=uring reads
+//   them with deep queues of large reads instead of mmap (pdf_skim_io.h).
+// - --autotune times short probes over the first clusters to pick the read
+//   settings (threads, block size, TTreeCache, prefetch) and stores them
+//   per host and storage class for later runs (pdf_autotune.h).
+// - --weights-file a_w.root,... reads 'weight' from separate files, one
+//   per ROOT input, aligned entry by entry with it (pdf_event_loop.h).
+// - --open-ahead N opens the next N ROOT inputs in the background while
+//   one is read (pdf_input_opener.h).
+// - --mem-budget 2G bounds the collected values: a bin that outgrows its
+//   share (budget / 14) continues in a bounded-error quantile sketch; its
+//   lines are the sketch values and the 16th/84th lines carry the reported
+//   rank error (pdf_quantile_sketch.h).
+// - --threads N reads each input in N cluster-aligned entry ranges, one
+//   worker per range with its own file handles; a cleanly read cluster is
+//   spliced into the shared bins under a lock (chunk lists, no copies).
+//   The 16th/84th selection then runs one bin per thread. Skims are read
+//   serially (pdf_event_loop.h, [Threads]).
+// - --max-lines K draws at most K cyan lines per bin, at evenly spaced
+//   quantiles including the extremes, instead of one per event; the
+//   16th/84th lines stay exact. Render time and file size no longer
+//   grow with the event count.
+//
 // compile: g++ -o plot_pdf_variations_BJ_v4.exe plot_pdf_variations_BJ_v4.cpp $(root-config --cflags --glibs)
-// run: ./plot_pdf_variations_BJ_v4.exe output_nominal_newnt_UL2018.root
+// run: ./plot_pdf_variations_BJ_v4.exe output_nominal_newnt_UL2018.root [more_files.root ...]
 // -------------------------------------------------------------------------
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#include <thread>
+#include <mutex>
 
+#include "TROOT.h"
 #include "TFile.h"
 #include "TTree.h"
 #include "TH1D.h"
@@ -24,6 +59,14 @@
 #include "TStyle.h"
 #include "TString.h"
 #include "TLine.h"
+#include "TLatex.h"
+
+#include "pdf_event_loop.h"
+#include "pdf_autotune.h"
+#include "pdf_input_opener.h"
+#include "pdf_skim.h"
+#include "pdf_skim_io.h"
+#include "pdf_quantile_sketch.h"
 
 using namespace std;
 
@@ -72,62 +115,365 @@ int main(int argc, char* argv[]) {
     gStyle->SetPadTickX(1);
     gStyle->SetPadTickY(1);
 
-    if (argc < 2) {
-        cout << "Usage: ./plot_pdf_variations_BJ_v4.exe [root_file]" << endl;
+    // --- Options ---
+    string cut = "nleps == 1";
+    bool cut_given = false;
+    int blockSize = kDefaultBlockSize;
+    bool block_given = false, autotune = false;
+    int open_ahead = kDefaultOpenAhead;
+    string bins_arg;
+    string weights_arg;
+    size_t mem_budget = 0; // bytes, 0 = unlimited
+    size_t max_lines = 0;  // lines per bin, 0 = one per event
+    int nThreads = 1;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cut" && i + 1 < argc) { cut = argv[++i]; cut_given = true; }
+        else if (arg == "--block" && i + 1 < argc) { blockSize = atoi(argv[++i]); block_given = true; }
+        else if (arg == "--autotune") autotune = true;
+        else if (arg == "--open-ahead" && i + 1 < argc) open_ahead = atoi(argv[++i]);
+        else if (arg == "--weights-file" && i + 1 < argc) weights_arg = argv[++i];
+        else if (arg == "--bins" && i + 1 < argc) bins_arg = argv[++i];
+        else if (arg == "--mem-budget" && i + 1 < argc) {
+            mem_budget = parseByteSize(argv[++i]);
+            if (mem_budget == 0) { cout << "[Error] Invalid --mem-budget: " << argv[i] << endl; return 1; }
+        }
+        else if (arg == "--threads" && i + 1 < argc) nThreads = atoi(argv[++i]);
+        else if (arg == "--max-lines" && i + 1 < argc) max_lines = (size_t)std::max(0, atoi(argv[++i]));
+        else inputs.push_back(arg);
+    }
+    if (blockSize < 1) blockSize = kDefaultBlockSize;
+    if (nThreads < 1) nThreads = 1;
+
+    if (inputs.empty()) {
+        cout << "Usage: ./plot_pdf_variations_BJ_v4.exe [--cut \"nleps == 1\"] [--block N] [--autotune] [--open-ahead N] [--weights-file w.root,...] [--bins 35,36] [--mem-budget 2G] [--threads N] [--max-lines K] [root_file|skim.pdfskim ...]" << endl;
         return 1;
     }
 
-    TString filename = argv[1];
-    TFile* file = TFile::Open(filename, "READ");
-    if (!file || file->IsZombie()) {
-        cout << "Error opening file: " << filename << endl;
+    // --- Weights Friend Files (--weights-file, one per ROOT input, in order) ---
+    vector<string> weight_files = splitList(weights_arg);
+    const size_t n_root_inputs = std::count_if(inputs.begin(), inputs.end(), [](const string& f) { return !isSkimFile(f); });
+    if (!weight_files.empty() && weight_files.size() != n_root_inputs) {
+        cout << "[Error] --weights-file needs one file per ROOT input (" << n_root_inputs << "), got "
+             << weight_files.size() << endl;
         return 1;
     }
 
-    TTree* tree = (TTree*)file->Get("tree");
-    if (!tree) {
-        cout << "Tree 'tree' not found!" << endl;
+    // --- Selection (compiled once, evaluated per block of entries) ---
+    Selection sel;
+    string sel_error;
+    if (!sel.Compile(cut, sel_error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << sel_error << endl;
         return 1;
     }
+    cout << "Selection: " << (sel.IsTrivial() ? "(none)" : cut) << endl;
 
-    // --- Branch Setup ---
-    vector<float> *weight_vec = nullptr;
-    int nleps, njets, nbm;
+    // Block columns: binning variables first, then whatever the cut uses
+    vector<string> columns = {"njets", "nbm"};
+    const int cNjets = 0, cNbm = 1;
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+    sel.Bind(columns, sel_error);
+
+    // --- Region Restriction (--bins) ---
+    RegionFilter region;
+    if (!bins_arg.empty()) {
+        vector<int> wanted_bins;
+        for (const string& item : splitList(bins_arg)) {
+            int bIdx = getIdx(atoi(item.c_str()));
+            if (bIdx == -1) {
+                cout << "[Error] Unknown bin in --bins: " << item << endl;
+                return 1;
+            }
+            wanted_bins.push_back(bIdx);
+        }
+        if (wanted_bins.empty()) for (int b = 0; b < nBins; ++b) wanted_bins.push_back(b);
 
-    tree->SetBranchAddress("weight", &weight_vec);
-    tree->SetBranchAddress("nleps", &nleps);
-    tree->SetBranchAddress("njets", &njets);
-    tree->SetBranchAddress("nbm", &nbm);
+        region.wanted = 0;
+        for (int b : wanted_bins)
+            for (int m = 0; m < kMjClasses; ++m) region.wanted |= cellBit(b, m);
+        cout << "Region: " << wanted_bins.size() << " bins" << endl;
+    }
 
     // --- Data Storage ---
-    vector<vector<double>> bin_data(nBins);
+    // Exact per bin, or a quantile sketch once a bin outgrows its share of --mem-budget
+    // (values live in 64 KiB arena chunks, pdf_value_arena.h)
+    ValueArena arena;
+    vector<BinValues> bin_data(nBins);
+    for (auto& values : bin_data) values.SetStorage(&arena, mem_budget / nBins);
     double y_min = 1.0e9;
     double y_max = -1.0e9;
 
-    // --- Step 1: Event Loop (Collect) ---
-    Long64_t nentries = tree->GetEntries();
-    cout << "Processing " << nentries << " events..." << endl;
+    SkipLog skip_log;
+    std::mutex merge_mutex; // guards bin_data and y_min / y_max across workers
+
+    // Skims already carry their selection; only an explicit --cut is applied on top
+    Selection skim_sel;
+    if (cut_given) skim_sel = sel;
+
+    // Read settings per storage class (--autotune / stored, see pdf_autotune.h)
+    ReadTuner tuner("BJ_v4", autotune, blockSize, block_given);
+    if (nThreads > 1) ROOT::EnableThreadSafety();
+
+    // --- Step 1 Worker: Collect the clusters in [first, last) of one input ---
+    // Own reader, 'weight' buffer and per-cluster staging; tree == nullptr
+    // opens its own handles. Returns false (read_error set) if the branches
+    // cannot be set up.
+    auto collectRange = [&](TTree* tree, const string& filename, const string& weights_name,
+                            const ReadConfig& read_cfg, Long64_t first, Long64_t last,
+                            SkipLog& log, string& read_error) {
+        TFile* file = nullptr;
+        string payload_name = weights_name.empty() ? "weight" : "";
+        if (!tree) {
+            SkipLog open_log; // recorded as a skipped range by the caller
+            tree = openInputTree(filename, file, open_log);
+            if (!tree) { read_error = "cannot reopen " + filename; return false; }
+            applyReadConfig(tree, read_cfg, columns, payload_name);
+        }
 
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-        if (!weight_vec || weight_vec->empty()) continue;
-        if (nleps != 1) continue;
+        // --- Branch Setup ---
+        // Scalars are read block-wise by the reader, 'weight' only for passing events
+        BlockReader reader;
+        TFile* weights_file = nullptr;
+        TTree* weights_tree = weights_name.empty() ? tree : openWeightsFriend(weights_name, tree, weights_file, read_error);
+        TBranch* payload = weights_tree ? weights_tree->GetBranch("weight") : nullptr;
+        if (!payload && read_error.empty()) read_error = "'weight' branch is required!";
+        if (!payload || !reader.Setup(tree, columns, read_cfg.blockSize, read_error)) {
+            closeInput(weights_file);
+            closeInput(file);
+            return false;
+        }
+        vector<float> *weight_vec = nullptr;
+        if (weights_file) applyReadConfig(weights_tree, read_cfg, {}, "weight");
+        weights_tree->SetBranchAddress("weight", &weight_vec);
+
+        // Per-cluster staging: only appended to bin_data once a cluster was read cleanly
+        // (spliced into bin_data chunk by chunk, no copies)
+        vector<ChunkedValues> cluster_data(nBins);
+        for (auto& v : cluster_data) v.SetArena(&arena);
+        double cluster_min = 1.0e9, cluster_max = -1.0e9;
+        auto resetCluster = [&]() {
+            for (auto& v : cluster_data) v.Clear();
+            cluster_min = 1.0e9; cluster_max = -1.0e9;
+        };
+
+        // Own copy of the selection: Evaluate() writes its scratch masks
+        Selection wsel = sel;
+        processSelectedBlocks(tree, filename, log, reader, wsel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(cNjets, row), (int)reader.Get(cNbm, row)));
+                return bIdx != -1 && region.WantBin(bIdx);
+            },
+            [&](Long64_t, int row) {
+                if (!weight_vec || weight_vec->empty()) return;
+                int njets = (int)reader.Get(cNjets, row);
+                int nbm   = (int)reader.Get(cNbm, row);
+                int binNum = getBinNumber(njets, nbm);
+                if (binNum == -1) return;
+                int bIdx = getIdx(binNum);
+                if (bIdx == -1) return;
+
+                double sum = 0.0;
+                int limit = (weight_vec->size() < 100) ? weight_vec->size() : 100;
+                for(int k=0; k<limit; ++k) sum += weight_vec->at(k);
+
+                double avg_val = sum / 100.0;
+                cluster_data[bIdx].push_back(avg_val);
+
+                if (avg_val < cluster_min) cluster_min = avg_val;
+                if (avg_val > cluster_max) cluster_max = avg_val;
+            },
+            [&]() {
+                std::lock_guard<std::mutex> lock(merge_mutex);
+                for (int b = 0; b < nBins; ++b) bin_data[b].Append(cluster_data[b]);
+                if (cluster_min < y_min) y_min = cluster_min;
+                if (cluster_max > y_max) y_max = cluster_max;
+                resetCluster();
+            },
+            resetCluster, first, last);
+
+        weights_tree->ResetBranchAddresses();
+        delete weight_vec;
+        closeInput(weights_file);
+        closeInput(file);
+        return true;
+    };
+
+
+    // ROOT inputs opened ahead of the loop (--open-ahead, see pdf_input_opener.h)
+    vector<string> root_inputs;
+    for (const string& f : inputs) if (!isSkimFile(f)) root_inputs.push_back(f);
+    InputOpener opener(root_inputs, open_ahead);
+
+    size_t root_index = 0;
+    for (const string& filename : inputs) {
+        // --- Skim Input (bin-partitioned, see make_pdf_skim.cpp) ---
+        if (isSkimFile(filename)) {
+            SkimReader skim;
+            string skim_error;
+            if (skim.Open(filename, skim_error) && skim.NReplicas() < 1)
+                skim_error = Form("%s stores %d weights per event, 1 needed", filename.c_str(), skim.NReplicas());
+            if (!skim_error.empty()) {
+                cout << "[Error] " << skim_error << " (skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            cout << "Reading skim " << filename << " (" << skim.NEvents() << " events, skim cut: "
+                 << skim.Cut() << ")..." << endl;
+
+            // Staged like a cluster: streamed parts arrive before a later read can fail,
+            // so the values only reach bin_data once the whole skim was read
+            vector<ChunkedValues> skim_data(nBins);
+            for (auto& v : skim_data) v.SetArena(&arena);
+            double skim_min = 1.0e9, skim_max = -1.0e9;
+            vector<float> w(skim.NReplicas());
+            bool ok = forEachSkimPart(skim, region.wanted, skim_sel, blockSize, skim_error,
+                [&](int c, const SkimCell& cell, const unsigned char* mask) {
+                    int b = c / kMjClasses;
+                    int limit = (cell.nReplicas < 100) ? cell.nReplicas : 100;
+                    for (uint64_t e = 0; e < cell.n; ++e) {
+                        if (mask && !mask[e]) continue;
+                        cell.Decode(e, w.data());
+                        double sum = 0.0;
+                        for(int k=0; k<limit; ++k) sum += w[k];
+
+                        double avg_val = sum / 100.0;
+                        skim_data[b].push_back(avg_val);
+
+                        if (avg_val < skim_min) skim_min = avg_val;
+                        if (avg_val > skim_max) skim_max = avg_val;
+                    }
+                });
+            if (!ok) {
+                cout << "[Error] " << skim_error << " (" << filename << " skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            for (int b = 0; b < nBins; ++b) bin_data[b].Append(skim_data[b]);
+            if (skim_min < y_min) y_min = skim_min;
+            if (skim_max > y_max) y_max = skim_max;
+            skip_log.nReadEvents += skim.WantedEvents(region.wanted);
+            continue;
+        }
 
-        int binNum = getBinNumber(njets, nbm);
-        if (binNum == -1) continue;
-        int bIdx = getIdx(binNum);
-        if (bIdx == -1) continue;
+        string weights_name = weight_files.empty() ? "" : weight_files[root_index++];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+
+        // Cluster index: only needed to skip clusters in a restricted run
+        // (built before any branch address is set)
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
+        }
 
-        double sum = 0.0;
-        int limit = (weight_vec->size() < 100) ? weight_vec->size() : 100;
-        for(int k=0; k<limit; ++k) sum += weight_vec->at(k);
+        // --- Read Settings ---
+        // (with a weights file, the payload is read from the friend tree)
+        string payload_name = weights_name.empty() ? "weight" : "";
+        ReadConfig read_cfg = tuner.Get(filename, tree, columns, sel, payload_name);
+        applyReadConfig(tree, read_cfg, columns, payload_name);
+
+        // --- Step 1: Event Loop (Collect, Cluster by Cluster) ---
+        // --threads N: worker t reads the t-th cluster-aligned entry range,
+        // worker 0 through the handles opened here, the others through their own
+        Long64_t nentries = tree->GetEntries();
+        auto ranges = clusterRanges(tree, nThreads);
+        if (ranges.empty()) ranges.push_back({0, nentries});
+        cout << "Processing " << nentries << " events (" << filename << ", "
+             << ranges.size() << (ranges.size() > 1 ? " threads" : " thread") << ")..." << endl;
+
+        vector<SkipLog> logs(ranges.size());
+        vector<string> errors(ranges.size());
+        vector<char> setup_ok(ranges.size(), 0);
+        vector<std::thread> workers;
+        for (size_t t = 1; t < ranges.size(); ++t) {
+            workers.emplace_back([&, t]() {
+                setup_ok[t] = collectRange(nullptr, filename, weights_name, read_cfg,
+                                           ranges[t].first, ranges[t].second, logs[t], errors[t]);
+            });
+        }
+        setup_ok[0] = collectRange(tree, filename, weights_name, read_cfg,
+                                   ranges[0].first, ranges[0].second, logs[0], errors[0]);
+        for (auto& w : workers) w.join();
+
+        // The values of every range that was read are already in bin_data, so
+        // the file only counts as skipped when no range could be set up
+        if (std::count(setup_ok.begin(), setup_ok.end(), 0) == (long)ranges.size()) {
+            cout << "[Error] " << errors[0] << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+        } else {
+            for (size_t t = 0; t < ranges.size(); ++t) {
+                // A range whose handles could not be set up counts as skipped
+                if (!setup_ok[t]) {
+                    logs[t].bad_ranges.push_back({filename, ranges[t].first, ranges[t].second, errors[t]});
+                    logs[t].nSkippedEvents += ranges[t].second - ranges[t].first;
+                }
+                skip_log.Merge(logs[t]);
+            }
+        }
 
-        double avg_val = sum / 100.0;
-        bin_data[bIdx].push_back(avg_val);
+        file->Close();
+        delete file;
+    }
 
-        if (avg_val < y_min) y_min = avg_val;
-        if (avg_val > y_max) y_max = avg_val;
+    skip_log.Print();
+
+    uint64_t n_values = 0;
+    for (const auto& values : bin_data) n_values += values.Count();
+    cout << Form("Collected %llu values: %.1f MiB arena, peak RSS %.1f MiB", (unsigned long long)n_values,
+                 arena.Bytes() / 1048576.0, peakRssBytes() / 1048576.0) << endl;
+
+    // --- Per-Bin Selection (one bin per task, --threads) ---
+    // Exact bins: the 16th/84th values (and with --max-lines the K line
+    // ranks) at their sorted positions (nth_element in place over the
+    // chunks, no full sort)
+    vector<vector<double>> line_values(nBins); // --max-lines: values to draw, ascending
+    parallelFor(nBins, nThreads, [&](size_t b, int) {
+        BinValues& values = bin_data[b];
+        values.Finalize();
+        size_t N = values.Count();
+        if (N == 0) return;
+        size_t idx_16 = (size_t)(N * 0.16);
+        size_t idx_84 = std::min((size_t)(N * 0.84), N - 1);
+
+        vector<size_t> ranks;
+        if (max_lines > 0) ranks = quantileRanks(N, max_lines);
+        if (!values.Sketched()) {
+            vector<size_t> selected(ranks);
+            selected.push_back(idx_16);
+            selected.push_back(idx_84);
+            values.SelectExact(selected);
+        }
+        if (max_lines > 0) values.ValuesAtRanks(ranks, line_values[b]);
+    });
+
+    // --- Memory Budget Report (--mem-budget) ---
+    string sketch_note;
+    if (mem_budget > 0) {
+        cout << Form("Memory budget: %.1f MiB (%.1f MiB per bin)", mem_budget / 1048576.0,
+                     mem_budget / 1048576.0 / nBins) << endl;
     }
+    for (int b = 0; b < nBins; ++b) {
+        const BinValues& values = bin_data[b];
+        if (!values.Sketched()) continue;
+
+        uint64_t count = values.Count();
+        double N = (double)count;
+        auto q16 = values.RankBracket((uint64_t)(N * 0.16));
+        auto q84 = values.RankBracket(std::min((uint64_t)(N * 0.84), count - 1));
+        cout << Form("  Bin %d approximated: %.0f values in a sketch (k = %zu, %.1f MiB), rank error <= %.0f (%.3g%%)",
+                     binNumbers[b], N, values.Sketch()->K(), values.Bytes() / 1048576.0,
+                     values.RankError(), 100.0 * values.RankError() / N) << endl;
+        cout << Form("    16th percentile in [%.6g, %.6g], 84th in [%.6g, %.6g]",
+                     q16.first, q16.second, q84.first, q84.second) << endl;
+        sketch_note += Form("%s%d", sketch_note.empty() ? "" : ", ", binNumbers[b]);
+    }
+    if (mem_budget > 0 && sketch_note.empty()) cout << "  All bins exact" << endl;
 
     if (y_min > y_max) { y_min = 0; y_max = 1; }
 
@@ -148,23 +494,50 @@ int main(int argc, char* argv[]) {
     vector<TLine*> lines_cyan;
     vector<TLine*> lines_blue;
 
-    cout << "Creating lines..." << endl;
+    cout << "Creating lines..." << (max_lines > 0 ? Form(" (at most %zu per bin, --max-lines)", max_lines) : "") << endl;
 
     for (int b = 0; b < nBins; ++b) {
-        vector<double>& values = bin_data[b];
-        int N = values.size();
+        const BinValues& bin_values = bin_data[b];
+        Long64_t N = bin_values.Count();
         if (N == 0) continue;
 
-        // 1. Sort
-        std::sort(values.begin(), values.end());
+        // 1. Values
+        // A sketched bin draws its sketch values and the 16th/84th values
+        // at the estimated ranks; an exact bin every value. With
+        // --max-lines, either draws the K quantile lines instead.
+        const ChunkedValues& values = bin_values.Exact();
+        vector<pair<double, double>> items;
+        if (bin_values.Sketched() && max_lines == 0) bin_values.Items(items);
 
         // 2. Identify Indices
-        int idx_16 = (int)(N * 0.16);
-        int idx_84 = (int)(N * 0.84);
+        Long64_t idx_16 = (Long64_t)(N * 0.16);
+        Long64_t idx_84 = (Long64_t)(N * 0.84);
         if (idx_84 >= N) idx_84 = N - 1;
 
-        // 3. Create Lines
-        for (int i = 0; i < N; ++i) {
+        // 3. Exact: the 16th/84th values are already at their sorted
+        // positions (Per-Bin Selection above)
+        if (max_lines > 0 || bin_values.Sketched()) {
+            vector<double> cyan_values;
+            if (max_lines > 0) cyan_values = line_values[b];
+            else for (const auto& it : items) cyan_values.push_back(it.first);
+            for (double val : cyan_values) {
+                TLine* line = new TLine(b, val, b+1, val);
+                line->SetLineColor(kCyan);
+                line->SetLineWidth(1);
+                lines_cyan.push_back(line);
+            }
+            for (Long64_t idx : {idx_16, idx_84}) {
+                double val = bin_values.ValueAtRank((double)idx);
+                TLine* line = new TLine(b, val, b+1, val);
+                line->SetLineColor(kBlue);
+                line->SetLineWidth(2);
+                lines_blue.push_back(line);
+            }
+            continue;
+        }
+
+        // 4. Create Lines
+        for (Long64_t i = 0; i < N; ++i) {
             double val = values[i];
 
             // Line from x=b to x=b+1
@@ -197,10 +570,22 @@ int main(int argc, char* argv[]) {
 
     TLegend* leg = new TLegend(0.65, 0.78, 0.88, 0.88);
     leg->SetBorderSize(0);
-    leg->AddEntry(dummy_cyan, "Individual Events", "l");
+    leg->AddEntry(dummy_cyan, max_lines > 0 ? Form("Event Quantiles (<= %zu per bin)", max_lines) : "Individual Events", "l");
     leg->AddEntry(dummy_blue, "16th/84th Percentile", "l");
     leg->Draw();
 
+    // Note skipped input on the plot itself
+    if (skip_log.HasSkips()) {
+        TLatex note;
+        note.SetNDC(); note.SetTextSize(0.03); note.SetTextColor(kRed);
+        note.DrawLatex(0.10, 0.92, skip_log.Summary().c_str());
+    }
+    if (!sketch_note.empty()) {
+        TLatex note;
+        note.SetNDC(); note.SetTextSize(0.03); note.SetTextColor(kRed);
+        note.DrawLatex(0.10, 0.955, ("Quantile sketch (--mem-budget): Bin " + sketch_note).c_str());
+    }
+
     c1->SaveAs("pdf_variations_BJ_v4.png");
     c1->SaveAs("pdf_variations_BJ_v4.pdf");
 
@@ -212,6 +597,5 @@ int main(int argc, char* argv[]) {
     delete dummy_cyan; delete dummy_blue;
     delete h_frame;
     delete c1;
-    file->Close();
     return 0;
 }
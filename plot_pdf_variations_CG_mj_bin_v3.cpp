@@ -13,30 +13,91 @@
 //    - Calculate Nominal Sum (k=0).
 //    - Calculate Ratios for all k: Ratio[k] = Sum[k] / Sum[0].
 //    - Fill Cyan Lines (All 100 Ratios).
-//    - Sort Ratios.
-//    - Identify 16th/84th percentile Ratios.
+//    - Identify 16th/84th percentile Ratios (all cells in one batched
+//      rank selection, pdf_percentile.h).
 //    - Fill Blue Lines (Envelope).
 //
+// [Input]
+// - Several input files may be given. Unreadable files and corrupted
+//   clusters are skipped, recorded and summarized (stdout + plot note).
+// - Cuts are a compiled --cut expression (default "nleps == 1"),
+//   evaluated per block of --block entries before the weights are read.
+// - --bins / --mj restrict the run to the given cells; a per-cluster
+//   index (<input>.cellidx) lets whole clusters be skipped unread.
+// - Bin-partitioned skims (*.pdfskim, make_pdf_skim.cpp) are accepted as
+//   input; only the requested cells are touched. $PDFW_SKIM_IO=uring reads
+//   them with deep queues of large reads instead of mmap (pdf_skim_io.h).
+//   Replica subsets written by compress_pdf_replicas.cpp are summed as
+//   stored (nominal + kept replicas), with the envelope ranks of their
+//   replica count.
+// - --pdf-set NAME computes members 0~99 of an LHAPDF set per event from
+//   the parton kinematics (--pdf-kin x1,x2,q,id1,id2 branches, optional
+//   --pdf-base event weight) instead of reading 'weight' (pdf_reweight.h,
+//   needs -DPDFW_WITH_LHAPDF $(lhapdf-config --cflags --ldflags)).
+// - --autotune times short probes over the first clusters to pick the read
+//   settings (threads, block size, TTreeCache, prefetch) and stores them
+//   per host and storage class for later runs (pdf_autotune.h).
+// - --weights-file a_w.root,... reads 'weight' from separate files, one
+//   per ROOT input, aligned entry by entry with it (pdf_event_loop.h).
+// - --open-ahead N opens the next N ROOT inputs in the background while
+//   one is read (pdf_input_opener.h).
+// - Skim weights are summed in float blocks (pdf_skim.h, [Accumulation]);
+//   --exact-sum keeps every addition in double (needed for negative weights).
+// - The drawing is skipped when the envelopes, replica sums and style hash
+//   to the value stored with the existing PNG/PDF (pdf_render_cache.h);
+//   --force-render always redraws.
+// - --view heatmap draws the whole [cell][replica] ratio matrix as one
+//   TH2D instead of the grid: (Bin, Mj) cells on x, the replica index
+//   (--heatmap-y replica) or its rank among the cell's replicas
+//   (--heatmap-y rank, 16th/84th marked) on y, colour = Sum[k] / Sum[0].
+//   Filled straight from the flat cell_sums array, so the drawing cost
+//   does not grow with the number of cells
+//   (plot_pdf_variations_CG_mj_bin_v3_heatmap.png / .pdf).
+// - --direct-vector writes the grid's PDF (and an SVG) with the compact
+//   writer of pdf_vector_plot.h straight from the ratio and envelope
+//   arrays: one path per pad for the 100 replicas, the shared frame
+//   written once. ROOT still renders the PNG.
+// - --html adds a self-contained <base>.html for reviews: the ratio and
+//   envelope arrays as base64 Float32 with a small inline renderer (hover
+//   a replica, zoom a pad); opens without ROOT or a network connection.
+//
 // compile: g++ -o plot_pdf_variations_CG_mj_bin_v3.exe plot_pdf_variations_CG_mj_bin_v3.cpp $(root-config --cflags --glibs)
-// run: ./plot_pdf_variations_CG_mj_bin_v3.exe final_output.root
+// run: ./plot_pdf_variations_CG_mj_bin_v3.exe final_output.root [more_files.root ...]
 // -------------------------------------------------------------------------
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#include <chrono>
 
 #include "TFile.h"
 #include "TTree.h"
 #include "TH1D.h"
+#include "TH2D.h"
 #include "TCanvas.h"
 #include "TLegend.h"
 #include "TStyle.h"
 #include "TString.h"
 #include "TLatex.h"
+#include "TLine.h"
+#include "TColor.h"
+#include "TROOT.h"
 #include "TPad.h"
 
+#include "pdf_event_loop.h"
+#include "pdf_autotune.h"
+#include "pdf_input_opener.h"
+#include "pdf_skim.h"
+#include "pdf_skim_io.h"
+#include "pdf_reweight.h"
+#include "pdf_percentile.h"
+#include "pdf_compress.h"
+#include "pdf_render_cache.h"
+#include "pdf_vector_plot.h"
+
 using namespace std;
 
 // --- Physical Binning Definition ---
@@ -57,6 +118,23 @@ const string mjLabels[nMjBins] = {
     "1100+"
 };
 
+// --- Plot Style (part of the render hash) ---
+// Bump kRenderVersion when the drawing code changes in a way the
+// settings below do not capture.
+const int kRenderVersion = 1;
+struct GridStyle {
+    int canvasW = 1200, canvasH = 1600;
+    double yMin = 0.85, yMax = 1.15;
+    double labelSize = 0.08;
+    int replicaColor = kCyan, replicaWidth = 1;
+    int envelopeColor = kBlue, envelopeWidth = 2;
+    int nominalColor = kBlack, nominalWidth = 2, nominalStyle = 2;
+    // --view heatmap
+    int heatmapW = 1400, heatmapH = 800;
+    int heatmapPalette = kLightTemperature;
+    int maxCellLabels = 60; // more cells: numbered axis instead of labels
+};
+
 // Helper: Get Array Index (0~13) from Bin Number
 int getIdx(int binNum) {
     for(int i=0; i<nBins; ++i) {
@@ -111,74 +189,462 @@ int main(int argc, char* argv[]) {
     gStyle->SetPadTickX(1);
     gStyle->SetPadTickY(1);
 
-    if (argc < 2) {
-        cout << "Usage: ./plot_pdf_variations_CG_mj_bin_v3.exe [root_file]" << endl;
+    // --- Options ---
+    string cut = "nleps == 1";
+    bool cut_given = false;
+    int blockSize = kDefaultBlockSize;
+    bool block_given = false, autotune = false, force_render = false, direct_vector = false, html = false;
+    int open_ahead = kDefaultOpenAhead;
+    int floatBlock = kSkimFloatBlock;
+    string pdf_set, pdf_kin = kPdfKinematicsDefault, pdf_base;
+    string bins_arg, mj_arg;
+    string weights_arg;
+    string view = "grid", heatmap_y = "replica";
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cut" && i + 1 < argc) { cut = argv[++i]; cut_given = true; }
+        else if (arg == "--block" && i + 1 < argc) { blockSize = atoi(argv[++i]); block_given = true; }
+        else if (arg == "--autotune") autotune = true;
+        else if (arg == "--open-ahead" && i + 1 < argc) open_ahead = atoi(argv[++i]);
+        else if (arg == "--exact-sum") floatBlock = 0;
+        else if (arg == "--force-render") force_render = true;
+        else if (arg == "--direct-vector") direct_vector = true;
+        else if (arg == "--html") html = true;
+        else if (arg == "--view" && i + 1 < argc) view = argv[++i];
+        else if (arg == "--heatmap-y" && i + 1 < argc) heatmap_y = argv[++i];
+        else if (arg == "--weights-file" && i + 1 < argc) weights_arg = argv[++i];
+        else if (arg == "--bins" && i + 1 < argc) bins_arg = argv[++i];
+        else if (arg == "--mj" && i + 1 < argc) mj_arg = argv[++i];
+        else if (arg == "--pdf-set" && i + 1 < argc) pdf_set = argv[++i];
+        else if (arg == "--pdf-kin" && i + 1 < argc) pdf_kin = argv[++i];
+        else if (arg == "--pdf-base" && i + 1 < argc) pdf_base = argv[++i];
+        else inputs.push_back(arg);
+    }
+    if (blockSize < 1) blockSize = kDefaultBlockSize;
+    if ((view != "grid" && view != "heatmap") || (heatmap_y != "replica" && heatmap_y != "rank")) {
+        cout << "[Error] --view grid|heatmap, --heatmap-y replica|rank" << endl;
         return 1;
     }
 
-    TString filename = argv[1];
-    TFile* file = TFile::Open(filename, "READ");
-    if (!file || file->IsZombie()) {
-        cout << "Error opening file: " << filename << endl;
+    if (inputs.empty()) {
+        cout << "Usage: ./plot_pdf_variations_CG_mj_bin_v3.exe [--cut \"nleps == 1\"] [--block N] [--autotune] [--open-ahead N] [--exact-sum] [--weights-file w.root,...] [--bins 35,36] [--mj 1100+] [--pdf-set NNPDF31_nnlo_as_0118] [--force-render] [--direct-vector] [--html] [--view grid|heatmap] [--heatmap-y replica|rank] [root_file|skim.pdfskim ...]" << endl;
         return 1;
     }
 
-    TTree* tree = (TTree*)file->Get("tree");
-    if (!tree) {
-        cout << "Tree 'tree' not found!" << endl;
+    // --- Weights Friend Files (--weights-file, one per ROOT input, in order) ---
+    vector<string> weight_files = splitList(weights_arg);
+    const size_t n_root_inputs = std::count_if(inputs.begin(), inputs.end(), [](const string& f) { return !isSkimFile(f); });
+    if (!weight_files.empty() && weight_files.size() != n_root_inputs) {
+        cout << "[Error] --weights-file needs one file per ROOT input (" << n_root_inputs << "), got "
+             << weight_files.size() << endl;
         return 1;
     }
 
-    // --- Branch Setup ---
-    vector<float> *weight_vec = nullptr;
-    int nleps, njets, nbm;
-    float mj12;
+    // --- Selection (compiled once, evaluated per block of entries) ---
+    Selection sel;
+    string sel_error;
+    if (!sel.Compile(cut, sel_error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << sel_error << endl;
+        return 1;
+    }
+    cout << "Selection: " << (sel.IsTrivial() ? "(none)" : cut) << endl;
+
+    // Block columns: binning variables first, then whatever the cut uses
+    vector<string> columns = {"njets", "nbm", "mj12"};
+    const int cNjets = 0, cNbm = 1, cMj12 = 2;
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+
+    // --- On-the-fly PDF Reweighting (--pdf-set, see pdf_reweight.h) ---
+    // Weights come from the parton kinematics instead of the 'weight' branch
+    PdfReweighter reweighter;
+    vector<int> cKin;
+    int cBase = -1;
+    if (!pdf_set.empty()) {
+        string pdf_error;
+        vector<string> kin = splitList(pdf_kin);
+        if (kin.size() != 5) {
+            cout << "[Error] --pdf-kin needs 5 branches (x1,x2,q,id1,id2): " << pdf_kin << endl;
+            return 1;
+        }
+        if (!reweighter.Setup(pdf_set, 100, pdf_error)) {
+            cout << "[Error] --pdf-set: " << pdf_error << endl;
+            return 1;
+        }
+        if (!pdf_base.empty()) kin.push_back(pdf_base);
+        for (const auto& v : kin) {
+            auto it = std::find(columns.begin(), columns.end(), v);
+            if (it == columns.end()) it = columns.insert(columns.end(), v);
+            cKin.push_back((int)(it - columns.begin()));
+        }
+        if (!pdf_base.empty()) cBase = cKin.back();
+        cout << "PDF reweighting: " << pdf_set << " members 0~99 from " << pdf_kin
+             << (pdf_base.empty() ? "" : " x " + pdf_base) << endl;
+    }
+    vector<float> pdf_weights(100, 0.f);
+
+    sel.Bind(columns, sel_error);
+
+    // --- Region Restriction (--bins / --mj) ---
+    RegionFilter region;
+    if (!bins_arg.empty() || !mj_arg.empty()) {
+        vector<int> wanted_bins;
+        for (const string& item : splitList(bins_arg)) {
+            int bIdx = getIdx(atoi(item.c_str()));
+            if (bIdx == -1) {
+                cout << "[Error] Unknown bin in --bins: " << item << endl;
+                return 1;
+            }
+            wanted_bins.push_back(bIdx);
+        }
+        if (wanted_bins.empty()) for (int b = 0; b < nBins; ++b) wanted_bins.push_back(b);
+
+        vector<int> wanted_mj;
+        for (const string& item : splitList(mj_arg)) {
+            int mIdx = -1;
+            for (int m = 0; m < nMjBins; ++m) if (item == mjLabels[m]) mIdx = m;
+            if (mIdx == -1 && item.size() == 1 && item[0] >= '0' && item[0] < '0' + nMjBins) mIdx = item[0] - '0';
+            if (mIdx == -1) {
+                cout << "[Error] Unknown Mj bin in --mj: " << item << " (use 500-800, 800-1100, 1100+ or 0~2)" << endl;
+                return 1;
+            }
+            wanted_mj.push_back(mIdx);
+        }
+        if (wanted_mj.empty()) for (int m = 0; m < nMjBins; ++m) wanted_mj.push_back(m);
 
-    tree->SetBranchAddress("weight", &weight_vec);
-    tree->SetBranchAddress("nleps", &nleps);
-    tree->SetBranchAddress("njets", &njets);
-    tree->SetBranchAddress("nbm", &nbm);
-    tree->SetBranchAddress("mj12", &mj12);
+        region.wanted = 0;
+        for (int b : wanted_bins)
+            for (int m : wanted_mj) region.wanted |= cellBit(b, m);
+        cout << "Region: " << wanted_bins.size() << " bins x " << wanted_mj.size() << " Mj bins" << endl;
+    }
 
     // --- Data Storage (Accumulator) ---
     // [PhysicalBin][MjBin][Replica]
-    // 14 Bins, 3 Mj Bins, 100 Replicas
+    // 14 Bins, 3 Mj Bins, 100 Replicas (sized by the first input, see useWeights)
     vector<vector<vector<double>>> bin_mj_replica_sums(nBins,
-        vector<vector<double>>(nMjBins,
-            vector<double>(100, 0.0)
-        )
+        vector<vector<double>>(nMjBins)
     );
 
-    // --- Step 1: Event Loop (Accumulate Sums) ---
-    Long64_t nentries = tree->GetEntries();
-    cout << "Step 1: Accumulating weights from " << nentries << " events..." << endl;
+    // Per-cluster staging: only added to the totals once a cluster was read cleanly
+    vector<vector<vector<double>>> cluster_sums = bin_mj_replica_sums;
+    auto resetCluster = [&]() {
+        for (auto& bin : cluster_sums)
+            for (auto& v : bin) std::fill(v.begin(), v.end(), 0.0);
+    };
+
+    // Weights summed per event (original 'weight' indices): 0~99 for ROOT
+    // inputs and full skims, nominal + the kept replicas for a skim written by
+    // compress_pdf_replicas. Fixed by the first input; the others must match.
+    vector<uint16_t> weight_ids;
+    vector<uint16_t> full_ids(100);
+    for (int k = 0; k < 100; ++k) full_ids[k] = (uint16_t)k;
+    auto useWeights = [&](const vector<uint16_t>& ids, string& error) {
+        if (weight_ids.empty()) {
+            weight_ids = ids;
+            for (auto* sums : {&bin_mj_replica_sums, &cluster_sums})
+                for (auto& bin : *sums)
+                    for (auto& v : bin) v.assign(ids.size(), 0.0);
+            return true;
+        }
+        if (ids == weight_ids) return true;
+        error = Form("%zu weights per event that differ from the first input's %zu", ids.size(), weight_ids.size());
+        return false;
+    };
 
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-        if (!weight_vec || weight_vec->empty()) continue;
-        if (nleps != 1) continue;
+    SkipLog skip_log;
+    vector<float> *weight_vec = nullptr;
 
-        // 1. Identify Bins
-        int binNum = getBinNumber(njets, nbm);
-        if (binNum == -1) continue;
-        int bIdx = getIdx(binNum);
-        if (bIdx == -1) continue;
+    // Skims already carry their selection; only an explicit --cut is applied on top
+    Selection skim_sel;
+    if (cut_given) skim_sel = sel;
+
+    // Read settings per storage class (--autotune / stored, see pdf_autotune.h)
+    ReadTuner tuner("CG_mj_bin_v3", autotune, blockSize, block_given);
+
+    // ROOT inputs opened ahead of the loop (--open-ahead, see pdf_input_opener.h)
+    vector<string> root_inputs;
+    for (const string& f : inputs) if (!isSkimFile(f)) root_inputs.push_back(f);
+    InputOpener opener(root_inputs, open_ahead);
+
+    size_t root_index = 0;
+    for (const string& filename : inputs) {
+        // --- Skim Input (bin-partitioned, see make_pdf_skim.cpp) ---
+        if (isSkimFile(filename)) {
+            SkimReader skim;
+            string skim_error;
+            if (skim.Open(filename, skim_error) && skim.NReplicas() < 2)
+                skim_error = Form("%s stores %d weights per event, nominal + replicas needed", filename.c_str(), skim.NReplicas());
+            if (skim_error.empty() && !useWeights(skimToolWeightIds(skim, 100), skim_error))
+                skim_error = filename + ": " + skim_error;
+            if (!skim_error.empty()) {
+                cout << "[Error] " << skim_error << " (skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            cout << "Reading skim " << filename << " (" << skim.NEvents() << " events, skim cut: "
+                 << skim.Cut() << ")..." << endl;
+
+            // Staged like a cluster: streamed parts arrive before a later read can fail,
+            // so the yields only reach the totals once the whole skim was read
+            resetCluster();
+            bool ok = forEachSkimPart(skim, region.wanted, skim_sel, blockSize, skim_error,
+                [&](int c, const SkimCell& cell, const unsigned char* mask) {
+                    int b = c / kMjClasses, m = c % kMjClasses;
+                    if (m >= nMjBins) return; // mj12 < 500
+                    accumulateSkimCell(cell, mask, (int)weight_ids.size(), cluster_sums[b][m].data(), floatBlock);
+                });
+            if (!ok) {
+                cout << "[Error] " << skim_error << " (" << filename << " skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            for (int b = 0; b < nBins; ++b)
+                for (int m = 0; m < nMjBins; ++m)
+                    for (size_t k = 0; k < weight_ids.size(); ++k)
+                        bin_mj_replica_sums[b][m][k] += cluster_sums[b][m][k];
+            skip_log.nReadEvents += skim.WantedEvents(region.wanted);
+            continue;
+        }
 
-        int mIdx = getMjBinIndex(mj12);
-        if (mIdx == -1) continue;
+        string weights_name = weight_files.empty() ? "" : weight_files[root_index++];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+        string weights_error;
+        if (!useWeights(full_ids, weights_error)) {
+            cout << "[Error] ROOT input with " << weights_error << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+            closeInput(file);
+            continue;
+        }
 
-        // 2. Accumulate Weights (Summing w_pdf[evt][k])
-        if (weight_vec->size() >= 100) {
-            for(int k=0; k<100; ++k) {
-                bin_mj_replica_sums[bIdx][mIdx][k] += weight_vec->at(k);
-            }
+        // Cluster index: only needed to skip clusters in a restricted run
+        // (built before the branch addresses below are set)
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
         }
+
+        // --- Read Settings ---
+        // (with a weights file, the payload is read from the friend tree)
+        string payload_name = (pdf_set.empty() && weights_name.empty()) ? "weight" : "";
+        ReadConfig read_cfg = tuner.Get(filename, tree, columns, sel, payload_name);
+        applyReadConfig(tree, read_cfg, columns, payload_name);
+
+        // --- Branch Setup ---
+        // Scalars are read block-wise by the reader, 'weight' only for passing events
+        BlockReader reader;
+        string read_error;
+        TFile* weights_file = nullptr;
+        TTree* weights_tree = tree;
+        if (pdf_set.empty() && !weights_name.empty())
+            weights_tree = openWeightsFriend(weights_name, tree, weights_file, read_error);
+        TBranch* payload = (pdf_set.empty() && weights_tree) ? weights_tree->GetBranch("weight") : nullptr;
+        if (!payload && pdf_set.empty() && read_error.empty()) read_error = "'weight' branch is required!";
+        if ((!payload && pdf_set.empty()) || !reader.Setup(tree, columns, read_cfg.blockSize, read_error)) {
+            cout << "[Error] " << read_error << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+            closeInput(weights_file);
+            file->Close();
+            delete file;
+            continue;
+        }
+        if (weights_file) applyReadConfig(weights_tree, read_cfg, {}, "weight");
+        if (payload) weights_tree->SetBranchAddress("weight", &weight_vec);
+
+        // --- Step 1: Event Loop (Accumulate Sums, Cluster by Cluster) ---
+        Long64_t nentries = tree->GetEntries();
+        cout << "Step 1: Accumulating weights from " << nentries << " events (" << filename << ")..." << endl;
+
+        resetCluster();
+        processSelectedBlocks(tree, filename, skip_log, reader, sel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(cNjets, row), (int)reader.Get(cNbm, row)));
+                return bIdx != -1 && region.WantCell(bIdx, cellMjClass(reader.Get(cMj12, row)));
+            },
+            [&](Long64_t, int row) {
+                const vector<float>* weights = weight_vec;
+                if (!pdf_set.empty()) {
+                    reweighter.Weights(reader.Get(cKin[0], row), reader.Get(cKin[1], row), reader.Get(cKin[2], row),
+                                       (int)reader.Get(cKin[3], row), (int)reader.Get(cKin[4], row),
+                                       cBase < 0 ? 1.0 : reader.Get(cBase, row), pdf_weights.data());
+                    weights = &pdf_weights;
+                }
+                if (!weights || weights->empty()) return;
+                int njets = (int)reader.Get(cNjets, row);
+                int nbm   = (int)reader.Get(cNbm, row);
+                // 1. Identify Bins
+                int binNum = getBinNumber(njets, nbm);
+                if (binNum == -1) return;
+                int bIdx = getIdx(binNum);
+                if (bIdx == -1) return;
+
+                float mj12 = reader.Get(cMj12, row);
+                int mIdx = getMjBinIndex(mj12);
+                if (mIdx == -1) return;
+
+                // 2. Accumulate Weights (Summing w_pdf[evt][k])
+                if (weights->size() >= 100) {
+                    for(int k=0; k<100; ++k) {
+                        cluster_sums[bIdx][mIdx][k] += weights->at(k);
+                    }
+                }
+            },
+            [&]() {
+                for (int b = 0; b < nBins; ++b)
+                    for (int m = 0; m < nMjBins; ++m)
+                        for (int k = 0; k < 100; ++k)
+                            bin_mj_replica_sums[b][m][k] += cluster_sums[b][m][k];
+                resetCluster();
+            },
+            resetCluster);
+
+        closeInput(weights_file);
+        file->Close();
+        delete file;
+    }
+
+    skip_log.Print();
+    if (!pdf_set.empty()) {
+        cout << "PDF reweighting: " << reweighter.CacheNodes() << " cache nodes, "
+             << reweighter.Misses() << " / " << reweighter.Lookups() << " node lookups evaluated, "
+             << reweighter.Direct() << " direct evaluations, "
+             << reweighter.Invalid() << " points with a vanishing central PDF" << endl;
+    }
+    if (skip_log.nReadEvents == 0) {
+        cout << "No readable events in any input file!" << endl;
+        return 1;
     }
 
     // --- Step 2: Drawing on Grid Canvas ---
     cout << "Step 2: Processing and Drawing..." << endl;
 
-    TCanvas* c1 = new TCanvas("c1", "PDF Variations Grid v3", 1200, 1600);
+    // Replica columns of a cell: all 100 sums (k = 0~99) for ROOT inputs and
+    // full skims, as before; 1~n of a replica subset (0 is its nominal)
+    const int nW = (int)weight_ids.size();
+    const int rep0 = weight_ids == full_ids ? 0 : 1;
+    const int nRep = nW - rep0;
+    int rank_lo, rank_hi;
+    envelopeRanks(nRep, rank_lo, rank_hi); // 15 / 83 for 100 (pdf_compress.h)
+    if (rep0 != 0)
+        cout << "Replica subset: " << nRep << " replicas, envelope ranks " << rank_lo << " / " << rank_hi << endl;
+
+    // 16th / 84th sums of all (Bin, Mj) cells in one batched pass (pdf_percentile.h)
+    vector<double> cell_sums((size_t)nBins * nMjBins * nW);
+    vector<double> rep_sums((size_t)nBins * nMjBins * nRep);
+    for (int b = 0; b < nBins; ++b)
+        for (int m = 0; m < nMjBins; ++m) {
+            const size_t c = (size_t)b * nMjBins + m;
+            const vector<double>& sums = bin_mj_replica_sums[b][m];
+            std::copy(sums.begin(), sums.end(), cell_sums.begin() + c * nW);
+            std::copy(sums.begin() + rep0, sums.end(), rep_sums.begin() + c * nRep);
+        }
+    vector<double> envelope((size_t)nBins * nMjBins * 2);
+    PercentileNetwork(nRep, {rank_lo, rank_hi}).Select(rep_sums.data(), nBins * nMjBins, nRep, envelope.data());
+
+    // Skip drawing if the same picture was already saved (pdf_render_cache.h)
+    const GridStyle style;
+    const string out_base = view == "heatmap" ? "plot_pdf_variations_CG_mj_bin_v3_heatmap"
+                                              : "plot_pdf_variations_CG_mj_bin_v3";
+    const bool write_vector = direct_vector && view == "grid";
+    const bool write_html = html && view == "grid";
+    vector<string> outputs = {out_base + ".png", out_base + ".pdf"};
+    if (write_vector) outputs.push_back(out_base + ".svg");
+    if (write_html) outputs.push_back(out_base + ".html");
+    const string note = skip_log.HasSkips() ? skip_log.Summary() : "";
+    RenderHash render_hash;
+    render_hash.Add(cell_sums);
+    render_hash.Add(envelope);
+    render_hash.Add(note);
+    render_hash.Add(view);
+    render_hash.Add(heatmap_y);
+    render_hash.Add((int)write_vector);
+    render_hash.Add((int)write_html);
+    for (int v : {kRenderVersion, (int)gROOT->GetVersionInt(), style.canvasW, style.canvasH,
+                  style.replicaColor, style.replicaWidth, style.envelopeColor, style.envelopeWidth,
+                  style.nominalColor, style.nominalWidth, style.nominalStyle,
+                  style.heatmapW, style.heatmapH, style.heatmapPalette, style.maxCellLabels})
+        render_hash.Add(v);
+    for (double v : {style.yMin, style.yMax, style.labelSize}) render_hash.Add(v);
+    for (int m = 0; m < nMjBins; ++m) render_hash.Add(mjLabels[m]);
+    const string hash = render_hash.Hex();
+    if (!force_render && renderUpToDate(out_base, outputs, hash)) {
+        cout << "Envelopes and style unchanged (render hash " << hash << "), keeping "
+             << outputs[0] << " / " << outputs[1] << endl;
+        return 0;
+    }
+
+    // --- Heatmap View (--view heatmap) ---
+    // One TH2D over the flat [cell][replica] array: x = cell, y = replica
+    // index or rank, colour = ratio to the nominal sum of the cell
+    if (view == "heatmap") {
+        const int nCells = nBins * nMjBins;
+        const bool by_rank = heatmap_y == "rank";
+        gStyle->SetPalette(style.heatmapPalette);
+        gStyle->SetNumberContours(255);
+
+        TCanvas* c1 = new TCanvas("c1", "PDF Variations Cell x Replica v3", style.heatmapW, style.heatmapH);
+        c1->SetRightMargin(0.12);
+        c1->SetBottomMargin(0.18);
+        TH2D* h_cells = new TH2D("h_cells", "", nCells, 0, nCells, nRep, 0, nRep);
+
+        vector<double> ratios(nRep);
+        for (int c = 0; c < nCells; ++c) {
+            const double* sums = cell_sums.data() + (size_t)c * nW;
+            double nom_sum = sums[0];
+            if (nom_sum == 0) nom_sum = 1.0; // Safety
+            for (int k = 0; k < nRep; ++k) ratios[k] = sums[rep0 + k] / nom_sum;
+            if (by_rank) std::sort(ratios.begin(), ratios.end());
+            for (int k = 0; k < nRep; ++k) h_cells->SetBinContent(c + 1, k + 1, ratios[k]);
+        }
+        h_cells->SetMinimum(style.yMin);
+        h_cells->SetMaximum(style.yMax);
+
+        if (nCells <= style.maxCellLabels) {
+            for (int c = 0; c < nCells; ++c)
+                h_cells->GetXaxis()->SetBinLabel(c + 1, Form("%d / %s", binNumbers[c / nMjBins], mjLabels[c % nMjBins].c_str()));
+            h_cells->GetXaxis()->LabelsOption("v");
+            h_cells->GetXaxis()->SetLabelSize(0.025);
+        } else {
+            h_cells->GetXaxis()->SetTitle("Cell (Bin x Mj)");
+        }
+        h_cells->GetYaxis()->SetTitle(by_rank ? "Replica rank (sorted sum)" : "Replica index k");
+        h_cells->GetZaxis()->SetTitle("Sum[k] / Sum[0]");
+        h_cells->Draw("COLZ");
+
+        // Rank view: the 16th / 84th rows are the envelope
+        TLine envelope_line(0, 0, 1, 1);
+        envelope_line.SetLineColor(style.envelopeColor);
+        envelope_line.SetLineWidth(style.envelopeWidth);
+        envelope_line.SetLineStyle(2);
+        if (by_rank) {
+            for (double y : {rank_lo + 0.5, rank_hi + 0.5}) envelope_line.DrawLine(0, y, nCells, y);
+        }
+
+        if (skip_log.HasSkips()) {
+            TLatex info; info.SetNDC(); info.SetTextSize(0.03); info.SetTextColor(kRed);
+            info.DrawLatex(0.10, 0.95, note.c_str());
+        }
+
+        for (const auto& out : outputs) {
+            std::remove(out.c_str()); // a failed SaveAs must not leave a stale file behind
+            c1->SaveAs(out.c_str());
+        }
+        if (!saveRenderStamp(out_base, outputs, hash)) {
+            cout << "[Warning] Not all outputs were written, render hash not stored" << endl;
+        }
+        cout << "Saved cell x replica heatmap to " << outputs[0] << endl;
+
+        delete h_cells;
+        delete c1;
+        return 0;
+    }
+
+    TCanvas* c1 = new TCanvas("c1", "PDF Variations Grid v3", style.canvasW, style.canvasH);
     c1->Divide(3, 5, 0.01, 0.01);
 
     vector<TH1D*> trash_bin; // To keep histograms alive
@@ -199,38 +665,36 @@ int main(int argc, char* argv[]) {
         TH1D* h_down = new TH1D(Form("h_down_%d", b), "", nMjBins, 0, nMjBins);
         trash_bin.push_back(h_nom); trash_bin.push_back(h_up); trash_bin.push_back(h_down);
 
-        // 100 Histograms for Cyan Lines
-        vector<TH1D*> h_reps(100);
-        for(int k=0; k<100; ++k) {
+        // One Histogram per Replica for Cyan Lines
+        vector<TH1D*> h_reps(nRep);
+        for(int k=0; k<nRep; ++k) {
             h_reps[k] = new TH1D(Form("h_rep_%d_%d", b, k), "", nMjBins, 0, nMjBins);
             trash_bin.push_back(h_reps[k]);
         }
 
         // --- Inner Loop: Mj Bins (X-axis) ---
-        // For each Mj bin, calculate ratios, sort, and fill histograms
+        // For each Mj bin, calculate ratios and fill histograms
         for (int m = 0; m < nMjBins; ++m) {
 
             // 1. Get the accumulated sums for this (Bin, Mj)
             // This vector contains [Sum_k0, Sum_k1, ..., Sum_k99]
-            vector<double> current_sums = bin_mj_replica_sums[b][m];
+            const vector<double>& current_sums = bin_mj_replica_sums[b][m];
 
             // 2. Get Nominal Sum (Index 0)
             double nom_sum = current_sums[0];
             if (nom_sum == 0) nom_sum = 1.0; // Safety
 
-            // 3. Calculate Ratios & Fill Cyan Lines (Before Sorting)
+            // 3. Calculate Ratios & Fill Cyan Lines
             // We fill h_reps[k] with the ratio of the k-th universe
-            for(int k=0; k<100; ++k) {
-                double ratio = current_sums[k] / nom_sum;
+            for(int k=0; k<nRep; ++k) {
+                double ratio = current_sums[rep0 + k] / nom_sum;
                 h_reps[k]->SetBinContent(m+1, ratio);
             }
 
-            // 4. Sort to find Envelope (CG Method Logic)
-            // We sort the raw sums (or ratios) to find 16th/84th percentiles
-            std::sort(current_sums.begin(), current_sums.end());
-
-            double val_16 = current_sums[15]; // 16th value
-            double val_84 = current_sums[83]; // 84th value
+            // 4. Envelope (CG Method Logic)
+            // 16th/84th values of the sorted raw sums, selected above
+            double val_16 = envelope[((size_t)b * nMjBins + m) * 2];     // 16th value
+            double val_84 = envelope[((size_t)b * nMjBins + m) * 2 + 1]; // 84th value
 
             // 5. Fill Envelope Lines (Blue)
             h_nom->SetBinContent(m+1, 1.0);
@@ -239,9 +703,9 @@ int main(int argc, char* argv[]) {
         }
 
         // --- Drawing ---
-        h_nom->GetYaxis()->SetRangeUser(0.85, 1.15);
-        h_nom->GetXaxis()->SetLabelSize(0.08);
-        h_nom->GetYaxis()->SetLabelSize(0.08);
+        h_nom->GetYaxis()->SetRangeUser(style.yMin, style.yMax);
+        h_nom->GetXaxis()->SetLabelSize(style.labelSize);
+        h_nom->GetYaxis()->SetLabelSize(style.labelSize);
         h_nom->GetYaxis()->SetNdivisions(505);
         for(int m=0; m<nMjBins; ++m) h_nom->GetXaxis()->SetBinLabel(m+1, mjLabels[m].c_str());
 
@@ -249,17 +713,17 @@ int main(int argc, char* argv[]) {
 
         // Draw all 100 Replicas (Cyan)
         for(auto h : h_reps) {
-            h->SetLineColor(kCyan);
-            h->SetLineWidth(1);
+            h->SetLineColor(style.replicaColor);
+            h->SetLineWidth(style.replicaWidth);
             h->Draw("HIST SAME");
         }
 
         // Draw Envelope (Blue)
-        h_up->SetLineColor(kBlue); h_up->SetLineWidth(2); h_up->Draw("HIST SAME");
-        h_down->SetLineColor(kBlue); h_down->SetLineWidth(2); h_down->Draw("HIST SAME");
+        h_up->SetLineColor(style.envelopeColor); h_up->SetLineWidth(style.envelopeWidth); h_up->Draw("HIST SAME");
+        h_down->SetLineColor(style.envelopeColor); h_down->SetLineWidth(style.envelopeWidth); h_down->Draw("HIST SAME");
 
         // Draw Nominal (Black Dashed)
-        h_nom->SetLineColor(kBlack); h_nom->SetLineWidth(2); h_nom->SetLineStyle(2);
+        h_nom->SetLineColor(style.nominalColor); h_nom->SetLineWidth(style.nominalWidth); h_nom->SetLineStyle(style.nominalStyle);
         h_nom->Draw("HIST SAME");
 
         // Label
@@ -272,14 +736,71 @@ int main(int argc, char* argv[]) {
     c1->cd(13);
     TLatex info; info.SetNDC(); info.SetTextSize(0.08);
 //    info.DrawLatex(0.1, 0.5, "Bin 31 Merged");
+    if (skip_log.HasSkips()) {
+        info.SetTextColor(kRed); info.SetTextSize(0.05);
+        info.DrawLatex(0.05, 0.5, note.c_str());
+    }
+
+    for (const auto& out : outputs) {
+        std::remove(out.c_str()); // a failed SaveAs must not leave a stale file behind
+        if (out != outputs[0] && (write_vector || out == out_base + ".html")) continue; // written below
+        c1->SaveAs(out.c_str());
+    }
+
+    // --- Direct PDF / SVG / HTML (--direct-vector, --html, pdf_vector_plot.h) ---
+    if (write_vector || write_html) {
+        auto t0 = std::chrono::steady_clock::now();
+        auto rgb = [](int color) {
+            VectorRgb c;
+            if (TColor* tc = gROOT->GetColor(color)) { c.r = tc->GetRed(); c.g = tc->GetGreen(); c.b = tc->GetBlue(); }
+            return c;
+        };
+        VectorFigure fig;
+        fig.padW = style.canvasW / 3 * 0.6; // px -> pt, as ROOT's PDF page
+        fig.padH = style.canvasH / 5 * 0.6;
+        fig.yMin = style.yMin; fig.yMax = style.yMax;
+        fig.replicaColor = rgb(style.replicaColor); fig.replicaWidth = 0.5 * style.replicaWidth;
+        fig.envelopeColor = rgb(style.envelopeColor); fig.envelopeWidth = 0.5 * style.envelopeWidth;
+        fig.nominalColor = rgb(style.nominalColor); fig.nominalWidth = 0.5 * style.nominalWidth;
+        fig.labelSize = style.labelSize * fig.padH * 0.6;
+        fig.titleSize = 0.12 * fig.padH * 0.6;
+        for (int m = 0; m < nMjBins; ++m) fig.xLabels.push_back(mjLabels[m]);
+        if (skip_log.HasSkips()) { fig.notePad = 12; fig.note = note; }
+
+        for (int b = 0; b < nBins; ++b) {
+            int padNum = getPadNumber(binNumbers[b]);
+            if (padNum < 1 || padNum > 15) continue;
+            VectorPanel panel;
+            panel.pad = padNum - 1;
+            panel.title = Form("Bin %d", binNumbers[b]);
+            panel.replicas.resize((size_t)nRep * nMjBins);
+            for (int m = 0; m < nMjBins; ++m) {
+                const size_t c = (size_t)b * nMjBins + m;
+                double nom_sum = cell_sums[c * nW];
+                if (nom_sum == 0) nom_sum = 1.0; // Safety
+                for (int k = 0; k < nRep; ++k) panel.replicas[k * nMjBins + m] = cell_sums[c * nW + rep0 + k] / nom_sum;
+                panel.lo.push_back(envelope[c * 2] / nom_sum);
+                panel.hi.push_back(envelope[c * 2 + 1] / nom_sum);
+            }
+            fig.panels.push_back(panel);
+        }
 
-    c1->SaveAs("plot_pdf_variations_CG_mj_bin_v3.png");
-    c1->SaveAs("plot_pdf_variations_CG_mj_bin_v3.pdf");
+        string vector_error;
+        bool ok = true;
+        if (write_vector) ok = writeGridPdf(fig, out_base + ".pdf", vector_error) && writeGridSvg(fig, out_base + ".svg", vector_error);
+        if (ok && write_html) ok = writeGridHtml(fig, "PDF Variations Grid v3", out_base + ".html", vector_error);
+        if (!ok) cout << "[Error] " << vector_error << endl;
+        cout << Form("Direct %s output in %.1f ms", write_vector ? (write_html ? "PDF / SVG / HTML" : "PDF / SVG") : "HTML",
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count()) << endl;
+    }
+
+    if (!saveRenderStamp(out_base, outputs, hash)) {
+        cout << "[Warning] Not all outputs were written, render hash not stored" << endl;
+    }
 
     cout << "Saved grid plots to plot_pdf_variations_CG_mj_bin_v3.png" << endl;
 
     for(auto h : trash_bin) delete h;
     delete c1;
-    file->Close();
     return 0;
 }
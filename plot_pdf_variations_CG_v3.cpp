@@ -6,15 +6,40 @@
 // - Adopts the efficient "Single Event Loop" structure from v4.
 // - Uses the correct Physical Binning logic from v4.
 // - Maintains the "CG Method" logic (Summing Yields per Replica).
+// - Accepts several input files; unreadable files and corrupted clusters
+//   are skipped and summarized instead of aborting the run.
+// - Cuts are a compiled --cut expression (default "nleps == 1"),
+//   evaluated per block of --block entries before the weights are read.
+// - --bins restrict the run to the given cells; a per-cluster
+//   index (<input>.cellidx) lets whole clusters be skipped unread.
+// - Bin-partitioned skims (*.pdfskim, make_pdf_skim.cpp) are accepted as
+//   input; only the requested cells are touched. $PDFW_SKIM_IO=uring reads
+//   them with deep queues of large reads instead of mmap (pdf_skim_io.h).
+//   Replica subsets written by compress_pdf_replicas.cpp are summed as
+//   stored, with the envelope ranks of their replica count.
+// - --pdf-set NAME computes members 0~100 of an LHAPDF set per event from
+//   the parton kinematics (--pdf-kin x1,x2,q,id1,id2 branches, optional
+//   --pdf-base event weight) instead of reading 'weight' (pdf_reweight.h,
+//   needs -DPDFW_WITH_LHAPDF $(lhapdf-config --cflags --ldflags)).
+// - --autotune times short probes over the first clusters to pick the read
+//   settings (threads, block size, TTreeCache, prefetch) and stores them
+//   per host and storage class for later runs (pdf_autotune.h).
+// - --weights-file a_w.root,... reads 'weight' from separate files, one
+//   per ROOT input, aligned entry by entry with it (pdf_event_loop.h).
+// - --open-ahead N opens the next N ROOT inputs in the background while
+//   one is read (pdf_input_opener.h).
+// - Skim weights are summed in float blocks (pdf_skim.h, [Accumulation]);
+//   --exact-sum keeps every addition in double (needed for negative weights).
 //
 //  compile: g++ -o plot_pdf_variations_CG_v3.exe plot_pdf_variations_CG_v3.cpp $(root-config --cflags --glibs)
-//  run: ./plot_pdf_variations_CG_v3.exe final_output.root
+//  run: ./plot_pdf_variations_CG_v3.exe final_output.root [more_files.root ...]
 // -------------------------------------------------------------------------
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm> // for sort
 
 #include "TFile.h"
@@ -24,6 +49,16 @@
 #include "TLegend.h"
 #include "TStyle.h"
 #include "TString.h"
+#include "TLatex.h"
+
+#include "pdf_event_loop.h"
+#include "pdf_autotune.h"
+#include "pdf_input_opener.h"
+#include "pdf_skim.h"
+#include "pdf_skim_io.h"
+#include "pdf_reweight.h"
+#include "pdf_percentile.h"
+#include "pdf_compress.h"
 
 using namespace std;
 
@@ -72,65 +107,304 @@ int main(int argc, char* argv[]) {
     gStyle->SetPadTickX(1);
     gStyle->SetPadTickY(1);
 
-    if (argc < 2) {
-        cout << "Usage: ./plot_pdf_variations_CG_v3.exe [root_file]" << endl;
+    // --- Options ---
+    string cut = "nleps == 1";
+    bool cut_given = false;
+    int blockSize = kDefaultBlockSize;
+    bool block_given = false, autotune = false;
+    int open_ahead = kDefaultOpenAhead;
+    int floatBlock = kSkimFloatBlock;
+    string pdf_set, pdf_kin = kPdfKinematicsDefault, pdf_base;
+    string bins_arg;
+    string weights_arg;
+    vector<string> inputs;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--cut" && i + 1 < argc) { cut = argv[++i]; cut_given = true; }
+        else if (arg == "--block" && i + 1 < argc) { blockSize = atoi(argv[++i]); block_given = true; }
+        else if (arg == "--autotune") autotune = true;
+        else if (arg == "--open-ahead" && i + 1 < argc) open_ahead = atoi(argv[++i]);
+        else if (arg == "--exact-sum") floatBlock = 0;
+        else if (arg == "--weights-file" && i + 1 < argc) weights_arg = argv[++i];
+        else if (arg == "--bins" && i + 1 < argc) bins_arg = argv[++i];
+        else if (arg == "--pdf-set" && i + 1 < argc) pdf_set = argv[++i];
+        else if (arg == "--pdf-kin" && i + 1 < argc) pdf_kin = argv[++i];
+        else if (arg == "--pdf-base" && i + 1 < argc) pdf_base = argv[++i];
+        else inputs.push_back(arg);
+    }
+    if (blockSize < 1) blockSize = kDefaultBlockSize;
+
+    if (inputs.empty()) {
+        cout << "Usage: ./plot_pdf_variations_CG_v3.exe [--cut \"nleps == 1\"] [--block N] [--autotune] [--open-ahead N] [--exact-sum] [--weights-file w.root,...] [--bins 35,36] [--pdf-set NNPDF31_nnlo_as_0118] [root_file|skim.pdfskim ...]" << endl;
         return 1;
     }
 
-    TString filename = argv[1];
-    TFile* file = TFile::Open(filename, "READ");
-    if (!file || file->IsZombie()) {
-        cout << "Error opening file: " << filename << endl;
+    // --- Weights Friend Files (--weights-file, one per ROOT input, in order) ---
+    vector<string> weight_files = splitList(weights_arg);
+    const size_t n_root_inputs = std::count_if(inputs.begin(), inputs.end(), [](const string& f) { return !isSkimFile(f); });
+    if (!weight_files.empty() && weight_files.size() != n_root_inputs) {
+        cout << "[Error] --weights-file needs one file per ROOT input (" << n_root_inputs << "), got "
+             << weight_files.size() << endl;
         return 1;
     }
 
-    TTree* tree = (TTree*)file->Get("tree");
-    if (!tree) {
-        cout << "Tree 'tree' not found!" << endl;
+    // --- Selection (compiled once, evaluated per block of entries) ---
+    Selection sel;
+    string sel_error;
+    if (!sel.Compile(cut, sel_error)) {
+        cout << "[Error] Invalid --cut \"" << cut << "\": " << sel_error << endl;
         return 1;
     }
+    cout << "Selection: " << (sel.IsTrivial() ? "(none)" : cut) << endl;
 
-    // --- Branch Setup ---
-    vector<float> *weight_vec = nullptr;
-    int nleps, njets, nbm;
+    // Block columns: binning variables first, then whatever the cut uses
+    vector<string> columns = {"njets", "nbm"};
+    const int cNjets = 0, cNbm = 1;
+    for (const auto& v : sel.Variables()) {
+        if (std::find(columns.begin(), columns.end(), v) == columns.end()) columns.push_back(v);
+    }
+
+    // --- On-the-fly PDF Reweighting (--pdf-set, see pdf_reweight.h) ---
+    // Weights come from the parton kinematics instead of the 'weight' branch
+    PdfReweighter reweighter;
+    vector<int> cKin;
+    int cBase = -1;
+    if (!pdf_set.empty()) {
+        string pdf_error;
+        vector<string> kin = splitList(pdf_kin);
+        if (kin.size() != 5) {
+            cout << "[Error] --pdf-kin needs 5 branches (x1,x2,q,id1,id2): " << pdf_kin << endl;
+            return 1;
+        }
+        if (!reweighter.Setup(pdf_set, 101, pdf_error)) {
+            cout << "[Error] --pdf-set: " << pdf_error << endl;
+            return 1;
+        }
+        if (!pdf_base.empty()) kin.push_back(pdf_base);
+        for (const auto& v : kin) {
+            auto it = std::find(columns.begin(), columns.end(), v);
+            if (it == columns.end()) it = columns.insert(columns.end(), v);
+            cKin.push_back((int)(it - columns.begin()));
+        }
+        if (!pdf_base.empty()) cBase = cKin.back();
+        cout << "PDF reweighting: " << pdf_set << " members 0~100 from " << pdf_kin
+             << (pdf_base.empty() ? "" : " x " + pdf_base) << endl;
+    }
+    vector<float> pdf_weights(101, 0.f);
+
+    sel.Bind(columns, sel_error);
+
+    // --- Region Restriction (--bins) ---
+    RegionFilter region;
+    if (!bins_arg.empty()) {
+        vector<int> wanted_bins;
+        for (const string& item : splitList(bins_arg)) {
+            int bIdx = getIdx(atoi(item.c_str()));
+            if (bIdx == -1) {
+                cout << "[Error] Unknown bin in --bins: " << item << endl;
+                return 1;
+            }
+            wanted_bins.push_back(bIdx);
+        }
+        if (wanted_bins.empty()) for (int b = 0; b < nBins; ++b) wanted_bins.push_back(b);
 
-    tree->SetBranchAddress("weight", &weight_vec);
-    tree->SetBranchAddress("nleps", &nleps);
-    tree->SetBranchAddress("njets", &njets);
-    tree->SetBranchAddress("nbm", &nbm);
+        region.wanted = 0;
+        for (int b : wanted_bins)
+            for (int m = 0; m < kMjClasses; ++m) region.wanted |= cellBit(b, m);
+        cout << "Region: " << wanted_bins.size() << " bins" << endl;
+    }
 
     // --- Data Storage for CG Method ---
     // Instead of looping bins, we store sums for ALL bins at once.
     // bin_replica_sums[binIdx][replicaIdx]
     // replicaIdx 0: Nominal Sum
-    // replicaIdx 1~99: Replica Sums
-    vector<vector<double>> bin_replica_sums(nBins, vector<double>(100, 0.0));
-
-    // --- Step 1: Single Event Loop (Efficient) ---
-    Long64_t nentries = tree->GetEntries();
-    cout << "Processing " << nentries << " events (Single Loop)..." << endl;
+    // replicaIdx 1~: Replica Sums (100 for ROOT inputs and full skims)
+    vector<vector<double>> bin_replica_sums(nBins);
+
+    // Per-cluster staging: only added to the totals once a cluster was read cleanly
+    vector<vector<double>> cluster_sums(nBins);
+    auto resetCluster = [&]() {
+        for (auto& v : cluster_sums) std::fill(v.begin(), v.end(), 0.0);
+    };
+
+    // Weights summed per event (original 'weight' indices): 0~100 for ROOT
+    // inputs and full skims, nominal + the kept replicas for a skim written by
+    // compress_pdf_replicas. Fixed by the first input; the others must match.
+    vector<uint16_t> weight_ids;
+    vector<uint16_t> full_ids(101);
+    for (int k = 0; k <= 100; ++k) full_ids[k] = (uint16_t)k;
+    auto useWeights = [&](const vector<uint16_t>& ids, string& error) {
+        if (weight_ids.empty()) {
+            weight_ids = ids;
+            for (auto& v : bin_replica_sums) v.assign(ids.size(), 0.0);
+            for (auto& v : cluster_sums) v.assign(ids.size(), 0.0);
+            return true;
+        }
+        if (ids == weight_ids) return true;
+        error = Form("%zu weights per event that differ from the first input's %zu", ids.size(), weight_ids.size());
+        return false;
+    };
 
-    for (Long64_t i = 0; i < nentries; ++i) {
-        tree->GetEntry(i);
-        if (!weight_vec || weight_vec->empty()) continue;
+    SkipLog skip_log;
+    vector<float> *weight_vec = nullptr;
 
-        // Cuts
-        if (nleps != 1) continue;
+    // Skims already carry their selection; only an explicit --cut is applied on top
+    Selection skim_sel;
+    if (cut_given) skim_sel = sel;
+
+    // Read settings per storage class (--autotune / stored, see pdf_autotune.h)
+    ReadTuner tuner("CG_v3", autotune, blockSize, block_given);
+
+    // ROOT inputs opened ahead of the loop (--open-ahead, see pdf_input_opener.h)
+    vector<string> root_inputs;
+    for (const string& f : inputs) if (!isSkimFile(f)) root_inputs.push_back(f);
+    InputOpener opener(root_inputs, open_ahead);
+
+    size_t root_index = 0;
+    for (const string& filename : inputs) {
+        // --- Skim Input (bin-partitioned, see make_pdf_skim.cpp) ---
+        if (isSkimFile(filename)) {
+            SkimReader skim;
+            string skim_error;
+            if (skim.Open(filename, skim_error) && skim.NReplicas() < 2)
+                skim_error = Form("%s stores %d weights per event, nominal + replicas needed", filename.c_str(), skim.NReplicas());
+            if (skim_error.empty() && !useWeights(skimToolWeightIds(skim, 101), skim_error))
+                skim_error = filename + ": " + skim_error;
+            if (!skim_error.empty()) {
+                cout << "[Error] " << skim_error << " (skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            cout << "Reading skim " << filename << " (" << skim.NEvents() << " events, skim cut: "
+                 << skim.Cut() << ")..." << endl;
+
+            // Staged like a cluster: streamed parts arrive before a later read can fail,
+            // so the yields only reach the totals once the whole skim was read
+            resetCluster();
+            bool ok = forEachSkimPart(skim, region.wanted, skim_sel, blockSize, skim_error,
+                [&](int c, const SkimCell& cell, const unsigned char* mask) {
+                    // All Mj classes of a physical bin go into the same yield
+                    accumulateSkimCell(cell, mask, (int)weight_ids.size(), cluster_sums[c / kMjClasses].data(), floatBlock);
+                });
+            if (!ok) {
+                cout << "[Error] " << skim_error << " (" << filename << " skipped)" << endl;
+                skip_log.bad_files.push_back(filename);
+                continue;
+            }
+            for (int b = 0; b < nBins; ++b)
+                for (size_t k = 0; k < weight_ids.size(); ++k) bin_replica_sums[b][k] += cluster_sums[b][k];
+            skip_log.nReadEvents += skim.WantedEvents(region.wanted);
+            continue;
+        }
 
-        // Determine Bin
-        int binNum = getBinNumber(njets, nbm);
-        if (binNum == -1) continue;
+        string weights_name = weight_files.empty() ? "" : weight_files[root_index++];
+        TFile* file = nullptr;
+        TTree* tree = opener.Take(filename, file, skip_log);
+        if (!tree) continue;
+        string weights_error;
+        if (!useWeights(full_ids, weights_error)) {
+            cout << "[Error] ROOT input with " << weights_error << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+            closeInput(file);
+            continue;
+        }
 
-        int bIdx = getIdx(binNum); // Map to 0~13
-        if (bIdx == -1) continue;
+        // Cluster index: only needed to skip clusters in a restricted run
+        // (built before the branch addresses below are set)
+        ClusterIndex cluster_index;
+        if (region.Active()) {
+            cluster_index = getClusterIndex(file, tree, filename,
+                [](int nj, int nb) { return getIdx(getBinNumber(nj, nb)); });
+            region.index = &cluster_index;
+        }
 
-        // [CG Method Logic] Accumulate Weights Directly
-        // weight_vec index k corresponds to Replica k (0 is Nominal)
-        if (weight_vec->size() >= 100) {
-            for(int k=0; k<=100; ++k) {
-                bin_replica_sums[bIdx][k] += weight_vec->at(k);
-            }
+        // --- Read Settings ---
+        // (with a weights file, the payload is read from the friend tree)
+        string payload_name = (pdf_set.empty() && weights_name.empty()) ? "weight" : "";
+        ReadConfig read_cfg = tuner.Get(filename, tree, columns, sel, payload_name);
+        applyReadConfig(tree, read_cfg, columns, payload_name);
+
+        // --- Branch Setup ---
+        // Scalars are read block-wise by the reader, 'weight' only for passing events
+        BlockReader reader;
+        string read_error;
+        TFile* weights_file = nullptr;
+        TTree* weights_tree = tree;
+        if (pdf_set.empty() && !weights_name.empty())
+            weights_tree = openWeightsFriend(weights_name, tree, weights_file, read_error);
+        TBranch* payload = (pdf_set.empty() && weights_tree) ? weights_tree->GetBranch("weight") : nullptr;
+        if (!payload && pdf_set.empty() && read_error.empty()) read_error = "'weight' branch is required!";
+        if ((!payload && pdf_set.empty()) || !reader.Setup(tree, columns, read_cfg.blockSize, read_error)) {
+            cout << "[Error] " << read_error << " (" << filename << " skipped)" << endl;
+            skip_log.bad_files.push_back(filename);
+            closeInput(weights_file);
+            file->Close();
+            delete file;
+            continue;
         }
+        if (weights_file) applyReadConfig(weights_tree, read_cfg, {}, "weight");
+        if (payload) weights_tree->SetBranchAddress("weight", &weight_vec);
+
+        // --- Step 1: Single Event Loop (Efficient, Cluster by Cluster) ---
+        Long64_t nentries = tree->GetEntries();
+        cout << "Processing " << nentries << " events from " << filename << " (Single Loop)..." << endl;
+
+        resetCluster();
+        processSelectedBlocks(tree, filename, skip_log, reader, sel, payload,
+            region, [&](int row) {
+                int bIdx = getIdx(getBinNumber((int)reader.Get(cNjets, row), (int)reader.Get(cNbm, row)));
+                return bIdx != -1 && region.WantBin(bIdx);
+            },
+            [&](Long64_t, int row) {
+                const vector<float>* weights = weight_vec;
+                if (!pdf_set.empty()) {
+                    reweighter.Weights(reader.Get(cKin[0], row), reader.Get(cKin[1], row), reader.Get(cKin[2], row),
+                                       (int)reader.Get(cKin[3], row), (int)reader.Get(cKin[4], row),
+                                       cBase < 0 ? 1.0 : reader.Get(cBase, row), pdf_weights.data());
+                    weights = &pdf_weights;
+                }
+                if (!weights || weights->empty()) return;
+
+                // Cuts (already applied block-wise by the compiled selection)
+                int njets = (int)reader.Get(cNjets, row);
+                int nbm   = (int)reader.Get(cNbm, row);
+                // Determine Bin
+                int binNum = getBinNumber(njets, nbm);
+                if (binNum == -1) return;
+
+                int bIdx = getIdx(binNum); // Map to 0~13
+                if (bIdx == -1) return;
+
+                // [CG Method Logic] Accumulate Weights Directly
+                // weight_vec index k corresponds to Replica k (0 is Nominal)
+                if (weights->size() >= 101) {
+                    for(int k=0; k<=100; ++k) {
+                        cluster_sums[bIdx][k] += weights->at(k);
+                    }
+                }
+            },
+            [&]() {
+                for (int b = 0; b < nBins; ++b)
+                    for (int k = 0; k <= 100; ++k) bin_replica_sums[b][k] += cluster_sums[b][k];
+                resetCluster();
+            },
+            resetCluster);
+
+        closeInput(weights_file);
+        file->Close();
+        delete file;
+    }
+
+    skip_log.Print();
+    if (!pdf_set.empty()) {
+        cout << "PDF reweighting: " << reweighter.CacheNodes() << " cache nodes, "
+             << reweighter.Misses() << " / " << reweighter.Lookups() << " node lookups evaluated, "
+             << reweighter.Direct() << " direct evaluations, "
+             << reweighter.Invalid() << " points with a vanishing central PDF" << endl;
+    }
+    if (skip_log.nReadEvents == 0) {
+        cout << "No readable events in any input file!" << endl;
+        return 1;
     }
 
     // --- Prepare Histograms ---
@@ -138,32 +412,39 @@ int main(int argc, char* argv[]) {
     TH1D* h_up  = new TH1D("h_up", "", nBins, 0, nBins);
     TH1D* h_down = new TH1D("h_down", "", nBins, 0, nBins);
 
+    // Replicas 1~nRep; envelope ranks of that count (15 / 83 for 100, pdf_compress.h)
+    const int nRep = (int)weight_ids.size() - 1;
+    int rank_lo, rank_hi;
+    envelopeRanks(nRep, rank_lo, rank_hi);
+    if (nRep != 100)
+        cout << "Replica subset: " << nRep << " replicas, envelope ranks " << rank_lo << " / " << rank_hi << endl;
+
     vector<TH1D*> h_reps_plot;
-    for(int k=0; k<100; ++k) {
+    for(int k=0; k<nRep; ++k) {
         h_reps_plot.push_back(new TH1D(Form("h_rep_%d", k), "", nBins, 0, nBins));
     }
 
     // --- Step 2: Process Accumulated Data per Bin ---
     cout << "Calculating systematic uncertainties per bin..." << endl;
 
+    // 16th / 84th of replicas 1~nRep for all bins in one batched pass (pdf_percentile.h)
+    vector<double> replica_yields((size_t)nBins * nRep);
+    for (int b = 0; b < nBins; ++b)
+        std::copy(bin_replica_sums[b].begin() + 1, bin_replica_sums[b].end(), replica_yields.begin() + (size_t)b * nRep);
+    vector<double> envelope((size_t)nBins * 2);
+    PercentileNetwork(nRep, {rank_lo, rank_hi}).Select(replica_yields.data(), nBins, nRep, envelope.data());
+
     for (int b = 0; b < nBins; ++b) {
         double nom_sum = bin_replica_sums[b][0];
 
-        // 1. Collect sums for the 100 replicas
-        vector<double> replica_yields;
-        for(int k=1; k<=100; ++k) {
-            double rep_sum = bin_replica_sums[b][k];
-            replica_yields.push_back(rep_sum);
-
-            // Fill Cyan Lines (Raw Yield)
-            h_reps_plot[k-1]->SetBinContent(b+1, rep_sum);
+        // 1. Fill Cyan Lines (Raw Yield) for the replicas
+        for(int k=1; k<=nRep; ++k) {
+            h_reps_plot[k-1]->SetBinContent(b+1, bin_replica_sums[b][k]);
         }
 
-        // 2. Sort to find Envelope (CG Method)
-        std::sort(replica_yields.begin(), replica_yields.end());
-
-        double val_16 = replica_yields[15]; // 16th percentile
-        double val_84 = replica_yields[83]; // 84th percentile
+        // 2. Envelope (CG Method): sorted ranks rank_lo / rank_hi
+        double val_16 = envelope[b * 2];     // 16th percentile
+        double val_84 = envelope[b * 2 + 1]; // 84th percentile
 
         // 3. Fill Result Histograms (Yields)
         h_nom->SetBinContent(b+1, nom_sum);
@@ -180,7 +461,7 @@ int main(int argc, char* argv[]) {
         h_up->SetBinContent(b, h_up->GetBinContent(b) / nom_val);
         h_down->SetBinContent(b, h_down->GetBinContent(b) / nom_val);
 
-        for(int k=0; k<100; ++k) {
+        for(int k=0; k<nRep; ++k) {
             h_reps_plot[k]->SetBinContent(b, h_reps_plot[k]->GetBinContent(b) / nom_val);
         }
     }
@@ -196,7 +477,7 @@ int main(int argc, char* argv[]) {
     h_nom->Draw("HIST");
 
     // Draw Replicas (Cyan)
-    for(int k=0; k<100; ++k) {
+    for(int k=0; k<nRep; ++k) {
         h_reps_plot[k]->SetLineColor(kCyan);
         h_reps_plot[k]->SetLineWidth(1);
         h_reps_plot[k]->Draw("HIST SAME");
@@ -224,12 +505,18 @@ int main(int argc, char* argv[]) {
     leg->AddEntry(h_reps_plot[0], "Replica Yields", "l");
     leg->Draw();
 
+    // Note skipped input on the plot itself
+    if (skip_log.HasSkips()) {
+        TLatex note;
+        note.SetNDC(); note.SetTextSize(0.03); note.SetTextColor(kRed);
+        note.DrawLatex(0.12, 0.92, skip_log.Summary().c_str());
+    }
+
     c1->SaveAs("pdf_variations_CG_v3.png");
     c1->SaveAs("pdf_variations_CG_v3.pdf");
 
     cout << "Plot saved as pdf_variations_CG_v3.png" << endl;
     cout << "Used optimized single-loop structure with correct binning." << endl;
 
-    file->Close();
     return 0;
 }